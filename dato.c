@@ -3,37 +3,197 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <elf.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define max(x, y) x > y ? x : y
 #define min(x, y) x < y ? x : y
+#define align(x, a) (((x) + (a) - 1) & ~((a) - 1))
 
-typedef struct token {
-	enum {
-		TKN_SEGMENT,
-		TKN_TYPE,
-		TKN_IDENTIFIER,
-		TKN_SEMICOLON,
-		TKN_LPARAN,
-		TKN_RPARAN,
-		TKN_COMMA,
-		TKN_OPERATOR,
-		TKN_KEYWORD,
-		TKN_INTEGER,
-		TKN_UNKNOWN,
-		TKN_COUNT,
-	}  type;
-	char *str;
-	int siz;
-	unsigned int precedence;
-	struct token *nxt;
+/*
+ * --stats, where the time and the memory go. every allocation goes through stats_malloc and the
+ * others, which keep its size in the 16 bytes before it, so the bytes in use are known when it's freed.
+ * the header is always there, an allocation can be made before the options are read, but it's only
+ * counted with --stats.
+ */
+enum {
+	PHASE_SOURCE,
+	PHASE_PARSE,
+	PHASE_LOWER,
+	PHASE_SSA,
+	PHASE_OPTIMIZE,
+	PHASE_PRINT,
+	PHASE_BACK_END,
+	PHASE_RUN, /* the program running with --run or --jit */
+	PHASE_COUNT,
+	PHASE_NONE = PHASE_COUNT,
+};
+
+static const char *const phase_str[] = {
+	"source",
+	"parse",
+	"lower",
+	"ssa",
+	"optimize",
+	"print",
+	"back_end",
+	"run",
+};
+
+typedef struct {
+	unsigned long long ns;
+	unsigned long long peak; /* the most bytes in use at once while in the phase */
+	unsigned long long allocated;
+} phase_t;
+
+static struct {
+	unsigned long long live;
+	unsigned long long peak;
+	unsigned long long allocated;
+	unsigned long long allocations;
+	unsigned int arena_blocks;
+	unsigned int phase;
+	unsigned long long phase_start;
+	unsigned long long phase_allocated;
+	phase_t phases[PHASE_COUNT];
+	unsigned int tokens;
+	unsigned int statements;
+	unsigned int ast_nodes;
+	unsigned int doil_before;
+	unsigned int doil_after;
+} stats = { .phase = PHASE_NONE };
+static int stats_report;
+static char *stats_path; /* NULL for stderr */
+
+#define STATS_HEADER 16
+
+void *
+stats_track(char *block, size_t siz) {
+	if (!block) return NULL;
+	/* what isn't counted is kept as 0 bytes, so freeing it once --stats is read takes nothing off */
+	if (!stats_report) siz = 0;
+	memcpy(block, &siz, sizeof(siz));
+	if (!stats_report) return block + STATS_HEADER;
+	stats.live += siz;
+	stats.allocated += siz;
+	stats.allocations++;
+	if (stats.live > stats.peak) stats.peak = stats.live;
+	return block + STATS_HEADER;
+}
+
+void *
+stats_malloc(size_t siz) {
+	if (siz > SIZE_MAX - STATS_HEADER) return NULL;
+	return stats_track(malloc(STATS_HEADER + siz), siz);
+}
+
+void *
+stats_calloc(size_t count, size_t siz) {
+	if (siz && count > (SIZE_MAX - STATS_HEADER) / siz) return NULL;
+	return stats_track(calloc(1, STATS_HEADER + count * siz), count * siz);
+}
+
+void
+stats_free(void *ptr) {
+	if (!ptr) return;
+	if (stats_report) {
+		size_t siz;
+		memcpy(&siz, (char *)ptr - STATS_HEADER, sizeof(siz));
+		stats.live -= siz;
+	}
+	free((char *)ptr - STATS_HEADER);
+}
+
+void *
+stats_realloc(void *ptr, size_t siz) {
+	if (!ptr) return stats_malloc(siz);
+	if (siz > SIZE_MAX - STATS_HEADER) return NULL;
+	char *block = realloc((char *)ptr - STATS_HEADER, STATS_HEADER + siz);
+	if (!block) return NULL;
+	if (stats_report) {
+		size_t old;
+		memcpy(&old, block, sizeof(old));
+		stats.live -= old;
+	}
+	return stats_track(block, siz);
+}
+
+#define malloc(siz) stats_malloc(siz)
+#define calloc(count, siz) stats_calloc(count, siz)
+#define realloc(ptr, siz) stats_realloc(ptr, siz)
+#define free(ptr) stats_free(ptr)
+
+unsigned long long
+stats_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* the phases can be entered many times, each system is optimized and printed in turn */
+void
+stats_phase(unsigned int phase) {
+	unsigned long long now = stats_now();
+	if (stats.phase != PHASE_NONE) {
+		phase_t *prv = &stats.phases[stats.phase];
+		prv->ns += now - stats.phase_start;
+		prv->allocated += stats.allocated - stats.phase_allocated;
+		if (stats.peak > prv->peak) prv->peak = stats.peak;
+	}
+	stats.phase = phase;
+	stats.phase_start = now;
+	stats.phase_allocated = stats.allocated;
+	stats.peak = stats.live;
+}
+
+enum {
+	TKN_SEGMENT,
+	TKN_TYPE,
+	TKN_IDENTIFIER,
+	TKN_SEMICOLON,
+	TKN_LPARAN,
+	TKN_RPARAN,
+	TKN_LBRACKET,
+	TKN_RBRACKET,
+	TKN_COMMA,
+	TKN_OPERATOR,
+	TKN_KEYWORD,
+	TKN_INTEGER,
+	TKN_UNKNOWN,
+	TKN_COUNT,
+};
+
+typedef struct {
+	unsigned char type;
+	unsigned char precedence;
+	unsigned int off; /* offset of the token in src */
+	unsigned int siz;
+	unsigned int id; /* interned name of a TKN_IDENTIFIER */
 } token_t;
 
-typedef struct statement {
-	token_t *tkn;
-	token_t *htkn;
-	struct statement *nxt;
+/* the tokens of a statement are followed by a TKN_SEMICOLON in the token array */
+typedef struct {
+	unsigned int start;
+	unsigned int count;
 } statement_t;
 
+static token_t *tkns;
+static unsigned int tkns_count;
+static unsigned int tkns_cap;
+static statement_t *stts;
+static unsigned int stts_count;
+static unsigned int stts_cap;
+
 static char *token_type_str[] = {
 	"TKN_SEGMENT",
 	"TKN_TYPE",
@@ -41,6 +201,8 @@ static char *token_type_str[] = {
 	"TKN_SEMICOLON",
 	"TKN_LPARAN",
 	"TKN_RPARAN",
+	"TKN_LBRACKET",
+	"TKN_RBRACKET",
 	"TKN_COMMA",
 	"TKN_OPERATOR",
 	"TKN_KEYWORD",
@@ -48,34 +210,55 @@ static char *token_type_str[] = {
 	"TKN_UNKNOWN",
 };
 
-typedef struct ast {
-	// NOTE: only support signed integers and binary operators for now
-	enum {
-		AST_PROGRAM,
-		AST_VARDEF,
-		AST_TYPE,
-		AST_IDENTIFIER,
-		AST_INTEGER,
-		AST_ASSIGN,
-		AST_ADD,
-		AST_SUB,
-		AST_MUL,
-		AST_DIV,
-		AST_RETURN,
-		AST_COUNT,
-	} type;
+// NOTE: only support signed integers and binary operators for now
+enum {
+	AST_PROGRAM,
+	AST_VARDEF,
+	AST_TYPE,
+	AST_IDENTIFIER,
+	AST_INTEGER,
+	AST_ASSIGN,
+	AST_ADD,
+	AST_SUB,
+	AST_MUL,
+	AST_DIV,
+	AST_RETURN,
+	AST_INDEX, /* element of the array or slice of its token, indexed by its child */
+	AST_SLICE, /* length of a slice declaration */
+	AST_SYSTEM, /* return type, parameters and then the statements of the system of its token */
+	AST_EXTERN, /* a system declared without a body, written in C */
+	AST_PARAM, /* type and name, like a variable definition */
+	AST_CALL, /* of the system of its token, with the arguments as children */
+	AST_LT,
+	AST_GT,
+	AST_LE,
+	AST_GE,
+	AST_EQ,
+	AST_NE,
+	AST_IF, /* condition, the statements to run when it isn't 0 and the ones of 'else' if there are any */
+	AST_WHILE, /* condition and the statements to run while it isn't 0 */
+	AST_COUNT,
+};
 
-	struct ast *branch;
-	struct ast *hbranch;
-	struct ast *nxt;
-	struct ast *prv;
-	struct ast *root;
+/* the ast is a structure of arrays and a node is an index in all of them */
+typedef struct {
+	unsigned char *type;
+	unsigned int *tkn; /* index in tkns, or AST_NO_TOKEN */
+	unsigned int *child; /* first child */
+	unsigned int *sibling; /* next sibling */
+	/* only used while parsing */
+	unsigned int *last; /* last child */
+	unsigned int *prv; /* previous sibling */
+	unsigned int *root;
+	unsigned int count;
+	unsigned int cap;
+} ast_t;
 
-	token_t *tkn;
+/* node 0 is the program, which is never a child or a sibling */
+#define AST_NONE 0
+#define AST_NO_TOKEN 0xffffffffu
 
-	statement_t *stt;
-	statement_t *hstt;
-} ast_t;
+static ast_t ast;
 
 static const char *const ast_type_str[] = {
 	"AST_PROGRAM",
@@ -89,11 +272,29 @@ static const char *const ast_type_str[] = {
 	"AST_MUL",
 	"AST_DIV",
 	"AST_RETURN",
+	"AST_INDEX",
+	"AST_SLICE",
+	"AST_SYSTEM",
+	"AST_EXTERN",
+	"AST_PARAM",
+	"AST_CALL",
+	"AST_LT",
+	"AST_GT",
+	"AST_LE",
+	"AST_GE",
+	"AST_EQ",
+	"AST_NE",
+	"AST_IF",
+	"AST_WHILE",
 };
 
+#define LEX_PADDING 64 /* zeroed bytes after the source, see skip_empty */
+
 static char *src;
+static char *cur;
 unsigned int f_siz;
-static const char *const empty  = " \t\n";
+static unsigned int src_map_siz; /* 0 when the source was read into the heap */
+static const char *const empty  = " \t\n\r";
 static const char *const number = "0123456789";
 static const char *const letter = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
 
@@ -109,455 +310,51 @@ typedef struct {
 	unsigned int siz;
 } string_t;
 
-void
-get_source(int argc, char **argv) {
-	if (argc < 2) {
-		fprintf(stderr, "ERROR: file path not provided\n");
-		fprintf(stderr, "Usage: %s <file-path>\n", argv[0]);
-		exit(1);
-	}
-	FILE *f = fopen(argv[1], "r");
-	if (!f) {
-		fprintf(stderr, "ERROR: could not open file %s: %s\n", argv[1], strerror(errno));
-	}
-	fseek(f, 0, SEEK_END);
-	f_siz = ftell(f);
-	fseek(f, 0, SEEK_SET);
-	src = malloc(f_siz + 1);
-	src[f_siz] = '\0';
-	fread(src, f_siz, 1, f);
-	fclose(f);
-}
-
-void
-print_token(token_t *tkn) {
-	printf("%s %.*s", token_type_str[tkn->type], tkn->siz, tkn->str);
-}
-
-void
-next_token(token_t **prv) {
-	while (strchr(empty, src[0])) {
-		if (src[0] == '\0') { *prv = NULL; return; }
-		src++;
-	}
-	if (*prv && (*prv)->type == TKN_SEGMENT) { *prv = NULL; return; }
-	char *str = src;
-	int siz, type;
-	unsigned int precedence;
-
-	if (strchr(letter, src[0])) {
-		while (strchr(letter, src[0]) || strchr(number, src[0])) src++;
-		siz = src - str;
-		if (src[0] == ':') {
-			src++;
-			type = TKN_SEGMENT;
-		} else if (strncmp(str, "i1", 	max(siz, 2)) == 0 ||
-							 strncmp(str, "i2", 	max(siz, 2)) == 0 ||
-							 strncmp(str, "i4", 	max(siz, 2)) == 0 ||
-							 strncmp(str, "i8", 	max(siz, 2)) == 0 ||
-							 strncmp(str, "u1", 	max(siz, 2)) == 0 ||
-							 strncmp(str, "u2", 	max(siz, 2)) == 0 ||
-							 strncmp(str, "u4", 	max(siz, 2)) == 0 ||
-							 strncmp(str, "u8", 	max(siz, 2)) == 0 ||
-							 strncmp(str, "ptr", max(siz, 2)) == 0) {
-			type = TKN_TYPE;
-		} else if (strncmp(str, "ret", max(siz, 3)) == 0 ||
-						   strncmp(str, "end", max(siz, 3)) == 0) {
-			type = TKN_KEYWORD;
-		} else {
-			type = TKN_IDENTIFIER;
-		}
-	} else if (strchr(number, src[0])) {
-		while (strchr(number, src[0])) src++;
-		siz = src - str;
-		type = TKN_INTEGER;
-	} else {
-		src++;
-		siz = src - str;
-		if (strncmp(str, ";", siz) == 0) {
-			type = TKN_SEMICOLON;
-		} else if (strncmp(str, "(", siz) == 0) {
-			type = TKN_LPARAN;
-		} else if (strncmp(str, ")", siz) == 0) {
-			type = TKN_RPARAN;
-		} else if (strncmp(str, ",", siz) == 0) {
-			type = TKN_COMMA;
-		} else if (strncmp(str, "+", siz) == 0) {
-			type = TKN_OPERATOR;
-			precedence = 1;
-		} else if (strncmp(str, "-", siz) == 0) { 
-			type = TKN_OPERATOR;
-			precedence = 1;
-		} else if (strncmp(str, "*", siz) == 0) { 
-			type = TKN_OPERATOR;
-			precedence = 2;
-		} else if (strncmp(str, "/", siz) == 0) { 
-			type = TKN_OPERATOR;
-			precedence = 2;
-		} else if (strncmp(str, "=", siz) == 0) {
-			type = TKN_OPERATOR;
-			precedence = 0;
-		} else {
-			type = TKN_UNKNOWN;
-		}
-	}
-	if (type == TKN_SEMICOLON) { *prv = NULL; return; }
-	token_t *tkn = malloc(sizeof(token_t));
-	tkn->siz = siz;
-	tkn->str = str;
-	tkn->type = type;
-	tkn->nxt = NULL;
-	tkn->precedence = precedence;
-	
-	if (*prv) (*prv)->nxt = tkn;
-	*prv = tkn;
-}
-
-void
-lex(statement_t **prv) {
-	if (src[0] == '\0') { *prv = NULL; return; }
-	token_t *tkn = NULL;
-	token_t *htkn = NULL;
-
-	do {
-		next_token(&tkn);
-		if (!htkn) htkn = tkn;
-	} while (tkn);
-
-	if (htkn == NULL) { *prv = NULL; return; }
-
-	statement_t *stt = malloc(sizeof(statement_t));
-	stt->tkn = tkn;
-	stt->htkn = htkn;
-	stt->nxt = NULL;
-	//print_statement(stt);
-
-	if (*prv) (*prv)->nxt = stt;
-	*prv = stt;
-}
-
-void
-print_statement(statement_t *stt) {
-	printf("{ ");
-	stt->tkn = stt->htkn;
-	while(stt->tkn) {
-		print_token(stt->tkn);
-		if (stt->tkn->nxt) {
-			printf(", ");
-		}
-		stt->tkn = stt->tkn->nxt;
-	}
-	printf(" }\n");
-}
-
-void
-change_segment(token_t *tkn) {
-	if (tkn->type != TKN_SEGMENT) return;
-	if (strncmp(tkn->str, "data", max(tkn->siz, 4)) == 0) {
-		segment = SEG_DATA;
-	} else if (strncmp(tkn->str, "logic", max(tkn->siz, 5)) == 0) {
-		segment = SEG_LOGIC;
-	} else if (strncmp(tkn->str, "system", max(tkn->siz, 6)) == 0) {
-		segment = SEG_SYSTEM;
-	} else if (strncmp(tkn->str, "layout", max(tkn->siz, 6)) == 0) {
-		segment = SEG_LAYOUT;
-	} else {
-		// TODO: add position
-		fprintf(stderr, "ERROR: '%.*s' is not a segment\n", tkn->siz, tkn->str);
-		exit(1); 
-	}
-}
+/* bump allocator, everything allocated from an arena is freed at once */
+typedef struct arena_block {
+	struct arena_block *nxt;
+	unsigned int siz;
+	unsigned int used;
+	_Alignas(16) char buf[];
+} arena_block_t;
 
-ast_t *
-ast_new_branch(ast_t *root, token_t *tkn) {
-	if (!root) {
-		fprintf(stderr, "ERROR: trying to create a new branch, but root is NULL\n");
-		exit(1);
-	}
-	ast_t *new_branch = malloc(sizeof(ast_t));
-	new_branch->hstt = root->stt;
-	new_branch->stt = root->stt;
-	new_branch->branch = NULL;
-	new_branch->hbranch = NULL;
-	new_branch->root = root;
-	new_branch->nxt = NULL;
-	new_branch->prv = NULL;
-	new_branch->tkn = tkn;
-
-	if (!root->branch) {
-		root->branch = new_branch;
-		root->hbranch = new_branch;
-	} else {
-		root->branch->nxt = new_branch;
-		new_branch->prv = root->branch;
-		root->branch = new_branch;
-	}
-	return new_branch;
-}
+typedef struct {
+	arena_block_t *block;
+} arena_t;
 
-void
-ast_branch_change_root(ast_t *branch, ast_t *new_root) {
-	ast_t *prv_root = branch->root;
-	if (branch->prv) {
-		branch->prv->nxt = branch->nxt;
-	} else {
-		prv_root->hbranch = branch->nxt;
-	}
-	if (branch->nxt) {
-		branch->nxt->prv = branch->prv;
-	}
-	branch->nxt = NULL;
-	branch->prv = new_root->branch;
-	branch->root = new_root;
-	if (branch->prv) {
-		branch->prv->nxt = branch;
-	} else {
-		new_root->branch = branch;
-		new_root->hbranch = branch;
-	}
-}
+#define ARENA_BLOCK_SIZE (64 * 1024)
 
-void
-parse_expression(ast_t *root, token_t **out_tkn) {
-	if (!root) {
-		fprintf(stderr, "ERROR: trying to parse a expression, but root is NULL\n");
-		exit(1);
-	}
-	if (!out_tkn || !*out_tkn) {
-		fprintf(stderr, "ERROR: trying to parse a expression, but token is NULL\n");
-		exit(1);
-	}
-	token_t *tkn = *out_tkn;
-	ast_t *lhs = root->branch, *expr = ast_new_branch(root, tkn);
+static arena_t ast_arena;  /* tokens' ast, freed by doil_lex */
+static arena_t doil_arena; /* doil, freed at exit */
 
-	switch(tkn->type) {
-		case TKN_INTEGER:
-				expr->type = AST_INTEGER;
-			break;
-		case TKN_IDENTIFIER:
-				expr->type = AST_IDENTIFIER;
-			break;
-		case TKN_OPERATOR:
-			if (!lhs) {
-				fprintf(stderr, "ERROR: %.*s without a left hand side\n", tkn->siz, tkn->str);
-				exit(1);
-			}
-			if (lhs->type != AST_INTEGER && lhs->type != AST_IDENTIFIER && !(lhs->tkn && lhs->tkn->type == TKN_OPERATOR)) {
-				if (lhs->tkn) fprintf(stderr, "ERROR: %.*s", lhs->tkn->siz, lhs->tkn->str);
-				else					fprintf(stderr, "ERROR: %s", ast_type_str[lhs->type]);
-				fprintf(stderr, " isn't valid as left hand side of %.*s\n", tkn->siz, tkn->str);
-				exit(1);
-			}
-			if (!tkn->nxt) {
-				fprintf(stderr, "ERROR: %.*s without a right hand side\n", tkn->siz, tkn->str);
-				exit(1);
-			}
-			if (tkn->nxt->type != TKN_INTEGER && tkn->nxt->type != TKN_IDENTIFIER) {
-				fprintf(stderr, "ERROR: %.*s isn't valid as right hand side of %.*s\n", tkn->nxt->siz, tkn->nxt->str, tkn->siz, tkn->str);
-				exit(1);
-			}
-			if (lhs->tkn && lhs->tkn->type == TKN_OPERATOR && lhs->tkn->precedence < tkn->precedence) assert(0 && "parse_expression: unreacheble");
-			if (strncmp("=", tkn->str, tkn->siz) == 0) {
-				expr->type = AST_ASSIGN;
-			} else if (strncmp("+", tkn->str, tkn->siz) == 0) {
-				expr->type = AST_ADD;
-			} else if (strncmp("-", tkn->str, tkn->siz) == 0) {
-				expr->type = AST_SUB;
-			} else if (strncmp("*", tkn->str, tkn->siz) == 0) {
-				expr->type = AST_MUL;
-			} else if (strncmp("/", tkn->str, tkn->siz) == 0) {
-				expr->type = AST_DIV;
-			} else {
-				fprintf(stderr, "ERROR: operator '%.*s' is not handled\n", tkn->siz, tkn->str);
-				exit(1);
-			}
-			ast_branch_change_root(lhs, expr);
-			*out_tkn = tkn->nxt;
-			parse_expression(expr, out_tkn);
-			if (tkn->nxt->nxt && tkn->nxt->nxt->type == TKN_OPERATOR) {
-				*out_tkn = tkn->nxt->nxt;
-				if (tkn->nxt->nxt->precedence > tkn->precedence) parse_expression(expr, out_tkn);
-				else {
-					parse_expression(expr->root, out_tkn);
-				}
-			}
-			break;
-		default:
-			fprintf(stderr, "ERROR: %.*s is not valid as an expression\n", tkn->siz, tkn->str);
+void *
+arena_alloc(arena_t *arena, unsigned int siz) {
+	siz = align(siz, 16);
+	if (!arena->block || arena->block->used + siz > arena->block->siz) {
+		unsigned int block_siz = siz > ARENA_BLOCK_SIZE ? siz : ARENA_BLOCK_SIZE;
+		arena_block_t *block = malloc(sizeof(arena_block_t) + block_siz);
+		if (!block) {
+			fprintf(stderr, "ERROR: out of memory\n");
 			exit(1);
-			break;
-	}
-}
-
-void
-parse_variable_declaration(ast_t *root, token_t **out_tkn) {
-	if (!root) {
-		fprintf(stderr, "ERROR: trying to parse a variable declaration, but root is NULL\n");
-		exit(1);
-	}
-	if (!out_tkn || !*out_tkn) {
-		fprintf(stderr, "ERROR: trying to parse a variable declaration, but token is NULL\n");
-		exit(1);
-	}
-	token_t *tkn = *out_tkn;
-	if (!tkn->nxt) {
-		fprintf(stderr, "ERROR: incomplete variable declaration\n");
-		exit(1);
-	}
-	if (tkn->nxt->type != TKN_IDENTIFIER) {
-		fprintf(stderr, "ERROR: %.*s is not a valid name for a variable\n", tkn->nxt->siz, tkn->nxt->str);
-		exit(1);
-	}
-	if (tkn->nxt->nxt) {
-		fprintf(stderr, "ERROR: expected ';' before '%.*s'\n", tkn->nxt->nxt->siz, tkn->nxt->nxt->str); 
-		exit(1);
-	}
-	ast_t *vardef = ast_new_branch(root, NULL);
-	vardef->type = AST_VARDEF;
-
-	ast_t *vartype = ast_new_branch(vardef, tkn);
-	vartype->type = AST_TYPE;
-	tkn = tkn->nxt;
-	parse_expression(vardef, &tkn);
-	*out_tkn = tkn;
-}
-
-void
-parse_keyword(ast_t **out_root, token_t *tkn) {
-	if (!out_root || !*out_root) {
-		fprintf(stderr, "ERROR: trying to parse a variable declaration, but root is NULL\n");
-		exit(1);
-	}
-	if (!tkn) {
-		fprintf(stderr, "ERROR: trying to parse a variable declaration, but token is NULL\n");
-		exit(1);
-	}
-	ast_t *root = *out_root;
-	if (strncmp(tkn->str, "ret", max(3, tkn->siz)) == 0) {
-		ast_t *ret = ast_new_branch(root, NULL);
-		ret->type = AST_RETURN;
-		if (tkn->nxt) {
-			root = ret;
-		}
-	} else {
-		fprintf(stderr, "ERROR: keyword '%.*s' is not handled\n", tkn->siz, tkn->str);
-		exit(1);
-	}
-	*out_root = root;
-}
-
-ast_t *
-parse(void) {
-	ast_t *root = malloc(sizeof(ast_t));
-	root->type = AST_PROGRAM;
-	root->branch = NULL;
-	root->hbranch = NULL;
-	root->nxt = NULL;
-	root->prv = NULL;
-	root->root = NULL;
-
-	root->stt = NULL;
-	root->hstt = NULL;
-	int count = 0;
-	do {
-		lex(&root->stt);
-		//if (root->stt) print_statement(root->stt);
-		if (!root->hstt) root->hstt = root->stt;
-		count++;
-	} while(root->stt);
-
-	root->stt = root->hstt;
-	token_t *tkn = root->stt->htkn;
-	ast_t *branch = root;
-
-	// TODO: semicolon error handling
-	while (root->stt) {
-		switch(segment) {
-			case SEG_LOGIC:
-				switch(tkn->type) {
-				case TKN_SEGMENT: change_segment(tkn); break;
-				case TKN_KEYWORD:
-					parse_keyword(&branch, tkn);
-					break;
-				case TKN_IDENTIFIER:
-				case TKN_INTEGER:
-				case TKN_OPERATOR:
-					parse_expression(branch, &tkn);
-					break;
-				default: 
-					fprintf(stderr, "ERROR: '%.*s' is not handled in 'logic'\n", tkn->siz, tkn->str); 
-					exit(1);
-					break;
-				}
-				break;
-			case SEG_DATA:
-				switch(tkn->type) {
-				case TKN_SEGMENT: change_segment(tkn); break;
-				case TKN_TYPE: 
-					parse_variable_declaration(branch, &tkn);
-					break;
-				default: 
-					fprintf(stderr, "ERROR: '%d a.k.a %.*s' is not handled in 'data'\n", tkn->type, tkn->siz, tkn->str); 
-					exit(1);
-					break;
-				}
-				break;
-			case SEG_SYSTEM: assert(0 && "system segment not implemented"); break;
-			case SEG_LAYOUT: assert(0 && "layout segment not implemented"); break;
-			default: assert(0 && "unreachable");
-		}
-		tkn = tkn->nxt;
-		if (!tkn) {
-			root->stt = root->stt->nxt;
-			if (!root->stt) continue;
-			tkn = root->stt->htkn;
-			branch = root;
-		}
-	}
-
-	return root;
-}
-
-void
-print_ast(ast_t *root, int depth) {
-	if (root->branch) {
-		for(int i = 0; i < depth; i++) printf("  ");
-		printf("%s {\n", ast_type_str[root->type]);
-		ast_t *branch = root->hbranch;
-		while (branch) {
-			print_ast(branch, depth + 1);
-			branch = branch->nxt;
 		}
-		for(int i = 0; i < depth; i++) printf("  ");
-		printf("}\n");
-	} else {
-		for(int i = 0; i < depth; i++) printf("  ");
-		printf("%s", ast_type_str[root->type]);
-		if (root->tkn) printf(" : %.*s", root->tkn->siz, root->tkn->str);
-		putchar('\n');
+		stats.arena_blocks++;
+		block->nxt = arena->block;
+		block->siz = block_siz;
+		block->used = 0;
+		arena->block = block;
 	}
+	void *ptr = arena->block->buf + arena->block->used;
+	arena->block->used += siz;
+	return ptr;
 }
 
 void
-free_ast(ast_t *root) {
-	while (root->hbranch) {
-		root->branch = root->hbranch;
-		root->hbranch = root->hbranch->nxt;
-		free_ast(root->branch);
-	}
-	if (root->type == AST_PROGRAM) {
-		while (root->hstt) {
-			root->stt = root->hstt;
-			while (root->stt->htkn) {
-				root->stt->tkn = root->stt->htkn;
-				root->stt->htkn = root->stt->htkn->nxt;
-				free(root->stt->tkn);
-			}
-			root->hstt = root->hstt->nxt;
-			free(root->stt);
-		}
+arena_free(arena_t *arena) {
+	while (arena->block) {
+		arena_block_t *nxt = arena->block->nxt;
+		free(arena->block);
+		arena->block = nxt;
 	}
-	free(root);
 }
 
 /* djb2 */
@@ -572,6 +369,7 @@ typedef struct identifier {
 	enum {
 		ID_VARIABLE,
 		ID_SYSTEM,
+		ID_UNDEFINED,
 		ID_ANY,
 		ID_COUNT
 	} type;
@@ -581,784 +379,8047 @@ typedef struct identifier {
 		unsigned int returntype;
 	};
 	unsigned int siz;
+	unsigned int hash;
+	int is_signed;
 	unsigned int use_amount;
 	unsigned int set_amount;
-	string_t first_value;
-	struct identifier *nxt;
+	unsigned int symbol; /* index in the backend symbol table */
+	unsigned int layout; /* index + 1 in layouts, 0 when the variable isn't in one */
+	unsigned int length; /* elements of an array, 0 for a scalar or a slice */
+	int is_slice; /* address and length of an array's elements */
+	int is_vector; /* an array of length lanes that fits one xmm or ymm register */
+	int is_sliced; /* an array assigned to a slice, its elements have to follow each other */
+	unsigned int system; /* index + 1 in systems of a system, or of the one a parameter or local variable is in */
 } identifier_t;
 
 static const char *const identifier_type_str[] = {
 	"ID_VARIABLE",
 	"ID_SYSTEM",
+	"ID_UNDEFINED",
 };
 
-static identifier_t **ids;
+#define ID_NONE 0xffffffffu
+
+/*
+ * every name is interned once by the lexer, from then on it is only known by its index in ids.
+ * ids_table is an open addressing (robin hood) table of those indices + 1, 0 being an empty slot.
+ */
+static identifier_t *ids;
 static unsigned int ids_count;
-static unsigned int ids_cap = 3;
+static unsigned int ids_cap;
+static unsigned int *ids_table;
+static unsigned int ids_table_cap;
+static unsigned int ids_table_shift;
+
+unsigned int
+ids_home(unsigned int h) {
+	/* fibonacci hashing, djb2 is weak in the low bits */
+	return (h * 2654435769u) >> ids_table_shift;
+}
 
 void
-set_identifier(identifier_t **ids, unsigned int ids_cap, identifier_t *id) {
-	if (!ids_cap) {
-		fprintf(stderr, "ERROR: trying to set identifier, but ids capacity is 0\n");
-		exit(1);
-	}
-	if (!id) {
-		fprintf(stderr, "ERROR: trying to set identifier, but id is NULL\n");
-		exit(1);
-	}
-	if (!ids) {
-		fprintf(stderr, "ERROR: trying to set identifier, but ids is NULL\n");
-		exit(1);
+ids_table_insert(unsigned int id) {
+	unsigned int mask = ids_table_cap - 1;
+	unsigned int slot = id + 1;
+	unsigned int i = ids_home(ids[id].hash), dist = 0;
+	while (ids_table[i]) {
+		unsigned int other_dist = (i - ids_home(ids[ids_table[i] - 1].hash)) & mask;
+		if (other_dist < dist) {
+			/* the entry closer to its home slot gives its place away */
+			unsigned int tmp = ids_table[i];
+			ids_table[i] = slot;
+			slot = tmp;
+			dist = other_dist;
+		}
+		i = (i + 1) & mask;
+		dist++;
 	}
-	id->nxt = NULL;
-	unsigned int idx = hash(id->str, id->siz) % ids_cap;
-	if (ids[idx] != NULL) id->nxt = ids[idx];
-	ids[idx] = id;
+	ids_table[i] = slot;
 }
 
 void
 ids_resize(void) {
-	unsigned int new_ids_cap = ids_cap * 2 + 1;
-	identifier_t **new_ids = malloc(sizeof(identifier_t *) * new_ids_cap);
-	memset(new_ids, 0, sizeof(identifier_t *) * new_ids_cap);
-	if (ids != NULL) {
-		for (unsigned int i = 0; i < ids_cap; i++) {
-			if (ids[i] == NULL) continue;
-			while(ids[i]) {
-				identifier_t *nxt = ids[i]->nxt;
-				set_identifier(new_ids, new_ids_cap, ids[i]);
-				ids[i] = nxt;
-			}
-		}
-		free(ids);
-	}
-	ids_cap = new_ids_cap;
-	ids = new_ids;
+	free(ids_table);
+	ids_table_cap = ids_table_cap ? ids_table_cap * 2 : 64;
+	ids_table_shift = ids_table_shift ? ids_table_shift - 1 : 32 - 6;
+	ids_table = calloc(ids_table_cap, sizeof(unsigned int));
+	for (unsigned int i = 0; i < ids_count; i++) ids_table_insert(i);
 }
 
-identifier_t *
-get_identifier(unsigned int type, char *str, unsigned int siz) {
-	if (!siz) {
-		fprintf(stderr, "ERROR: trying to get identifier, but string size is 0\n");
-		exit(1);
-	}
-	if (!str) {
-		fprintf(stderr, "ERROR: trying to get identifier, but string is NULL\n");
-		exit(1);
+unsigned int
+ids_find(char *str, unsigned int siz, unsigned int h) {
+	if (!ids_table) return ID_NONE;
+	unsigned int mask = ids_table_cap - 1;
+	unsigned int i = ids_home(h), dist = 0;
+	while (ids_table[i]) {
+		identifier_t *id = &ids[ids_table[i] - 1];
+		if (id->hash == h && id->siz == siz && memcmp(id->str, str, siz) == 0) return ids_table[i] - 1;
+		/* robin hood keeps the probe sequences sorted, the name would have been here */
+		if (((i - ids_home(id->hash)) & mask) < dist) break;
+		i = (i + 1) & mask;
+		dist++;
 	}
-	unsigned int idx = hash(str, siz) % ids_cap;
-	identifier_t *id = ids[idx];
-	while (id) {
-		if (strncmp(id->str, str, max(id->siz, siz)) == 0 && (type == ID_ANY || id->type == type)) break;
-		id = id->nxt;
+	return ID_NONE;
+}
+
+unsigned int
+intern(char *str, unsigned int siz) {
+	unsigned int h = hash(str, siz);
+	unsigned int id = ids_find(str, siz, h);
+	if (id != ID_NONE) return id;
+	if (ids_count >= ids_cap) {
+		ids_cap = ids_cap ? ids_cap * 2 : 32;
+		ids = realloc(ids, sizeof(identifier_t) * ids_cap);
 	}
+	id = ids_count++;
+	ids[id] = (identifier_t){0};
+	ids[id].type = ID_UNDEFINED;
+	ids[id].str = str;
+	ids[id].siz = siz;
+	ids[id].hash = h;
+	if (ids_count * 4 > ids_table_cap * 3) ids_resize();
+	else                                   ids_table_insert(id);
 	return id;
 }
 
 identifier_t *
-add_identifier(unsigned int type, char *str, unsigned int siz) {
-	if (!siz) {
-		fprintf(stderr, "ERROR: trying to add new identifier, but string size is 0\n");
+get_identifier(unsigned int type, unsigned int id) {
+	if (id >= ids_count) {
+		fprintf(stderr, "ERROR: trying to get identifier %u, but it doesn't exists\n", id);
 		exit(1);
 	}
-	if (!str) {
-		fprintf(stderr, "ERROR: trying to add new identifier, but string is NULL\n");
+	identifier_t *ident = &ids[id];
+	if (ident->type == ID_UNDEFINED || (type != ID_ANY && ident->type != type)) return NULL;
+	return ident;
+}
+
+identifier_t *
+add_identifier(unsigned int type, unsigned int id) {
+	if (id >= ids_count) {
+		fprintf(stderr, "ERROR: trying to add identifier %u, but it was never interned\n", id);
 		exit(1);
 	}
-	if (ids == NULL) {
-		ids_resize();
-	}
-	identifier_t *id = get_identifier(type, str, siz);
-	if (!id) {
-		ids_count++;
-		if (ids_count / (float)ids_cap > 0.8f) ids_resize();
-		id = malloc(sizeof(identifier_t));
-		*id = (identifier_t){0};
-		id->type = type;
-		id->str = str;
-		id->siz = siz;
-		set_identifier(ids, ids_cap, id);
+	identifier_t *ident = &ids[id];
+	if (ident->type != ID_UNDEFINED && ident->type != type) {
+		fprintf(stderr, "ERROR: '%.*s' is already defined as %s\n", ident->siz, ident->str, identifier_type_str[ident->type]);
+		exit(1);
 	}
-	return id;
+	ident->type = type;
+	return ident;
 }
 
 void
-remove_identifier(unsigned int type, char *str, unsigned int siz) {
-	if (!siz) {
-		fprintf(stderr, "ERROR: trying to remove identifier, but string size is 0\n");
+remove_identifier(unsigned int type, unsigned int id) {
+	identifier_t *ident = get_identifier(type, id);
+	if (!ident) {
+		fprintf(stderr, "ERROR: trying to remove identifier '%.*s', but it doesn't exists\n", ids[id].siz, ids[id].str);
 		exit(1);
 	}
-	if (!str) {
-		fprintf(stderr, "ERROR: trying to remove identifier, but string is NULL\n");
-		exit(1);
+	ident->type = ID_UNDEFINED;
+}
+
+void
+print_ids(void) {
+	for (unsigned int i = 0; i < ids_table_cap; i++) {
+		printf("ids_table[%u] = ", i);
+		if (ids_table[i]) {
+			identifier_t *id = &ids[ids_table[i] - 1];
+			printf("{ %u, %s: %.*s }\n", ids_table[i] - 1, identifier_type_str[id->type], id->siz, id->str);
+		} else {
+			printf("NULL\n");
+		}
+	}
+}
+
+/* how full ids_table is, and how many slots a lookup of each name looks at */
+void
+print_ids_stats(FILE *f) {
+	unsigned int *probes = calloc(ids_table_cap + 1, sizeof(unsigned int));
+	unsigned int longest = 0;
+	for (unsigned int i = 0; i < ids_table_cap; i++) {
+		if (!ids_table[i]) continue;
+		unsigned int length = ((i - ids_home(ids[ids_table[i] - 1].hash)) & (ids_table_cap - 1)) + 1;
+		probes[length]++;
+		if (length > longest) longest = length;
 	}
-	unsigned int idx = hash(str, siz) % ids_cap;
-	identifier_t *id = ids[idx];
-	identifier_t *prv = NULL;
-	while (id) {
-		if (strncmp(id->str, str, max(id->siz, siz)) == 0 && (type == ID_ANY || id->type == type)) {
-			if (!prv) {
-				ids[idx] = id->nxt;
+	fprintf(f, "\"ids_table\": {\"capacity\": %u, \"entries\": %u, \"load_factor\": %.3f, \"probe_lengths\": [",
+	        ids_table_cap, ids_count, ids_table_cap ? (double)ids_count / ids_table_cap : 0.0);
+	for (unsigned int i = 1; i <= longest; i++) fprintf(f, "%s%u", i > 1 ? ", " : "", probes[i]);
+	fprintf(f, "]}");
+	free(probes);
+}
+
+/* a statement of the layout segment, the backend places its variables together */
+typedef struct {
+	enum {
+		LAYOUT_AOS, /* one record with every variable, in order */
+		LAYOUT_SOA, /* every variable on its own */
+		LAYOUT_AOSOA, /* a block of width elements of every variable */
+	} type;
+	enum {
+		LAYOUT_WARM,
+		LAYOUT_HOT, /* placed first, from the start of a cache line */
+		LAYOUT_COLD, /* placed last, from a cache line of their own */
+	} temperature;
+	unsigned int width;
+	unsigned int align; /* at least the natural alignment of the variables */
+	unsigned int pad; /* sizes are rounded up to a multiple of it, 0 for none */
+	unsigned int *vars; /* ids, checked by layout_resolve */
+	unsigned int vars_count;
+} layout_t;
+
+static layout_t *layouts;
+static unsigned int layouts_count;
+static unsigned int layouts_cap;
+
+static enum {
+	OUTPUT_ASM,
+	OUTPUT_EXE,
+	OUTPUT_OBJ,
+	OUTPUT_RUN, /* nothing is written, the program is interpreted */
+	OUTPUT_JIT, /* nothing is written, the machine code is run from memory */
+} output = OUTPUT_ASM;
+static char *output_path;
+static char *src_path;
+static int layout_report;
+/* the vector instructions the target has, every x86_64 has sse2 */
+static enum {
+	MARCH_SSE2,
+	MARCH_SSE4_1,
+	MARCH_AVX2,
+} march = MARCH_SSE2;
+/* the most iterations a loop is unrolled to */
+static unsigned int unroll_factor = 4;
+
+void
+usage(char *program) {
+	fprintf(stderr, "Usage: %s [options] <file-path>\n", program);
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  --asm      write GAS assembly (default: output.s)\n");
+	fprintf(stderr, "  --elf      write a static ELF64 executable (default: output)\n");
+	fprintf(stderr, "  --obj      write a relocatable ELF64 object (default: output.o)\n");
+	fprintf(stderr, "  --run      interpret the program, what it returns is the exit status\n");
+	fprintf(stderr, "  --jit      compile the program in memory and run it, what it returns is the exit status\n");
+	fprintf(stderr, "  -o <path>  write the output to <path>\n");
+	fprintf(stderr, "  --layout-report  print where every variable was placed\n");
+	fprintf(stderr, "  --stats[=<path>] write the time and memory of every phase as json to <path> (default: stderr)\n");
+	fprintf(stderr, "  -march=<cpu>     x86-64 (sse2, default), x86-64-v2 (sse4.1), x86-64-v3 (avx2) or native\n");
+	fprintf(stderr, "  --unroll=<n>     unroll the loops run a known number of times up to n times (default: 4, 1 disables it)\n");
+}
+
+void
+get_arguments(int argc, char **argv) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--asm") == 0) {
+			output = OUTPUT_ASM;
+		} else if (strcmp(argv[i], "--elf") == 0) {
+			output = OUTPUT_EXE;
+		} else if (strcmp(argv[i], "--obj") == 0) {
+			output = OUTPUT_OBJ;
+		} else if (strcmp(argv[i], "--run") == 0) {
+			output = OUTPUT_RUN;
+		} else if (strcmp(argv[i], "--jit") == 0) {
+			output = OUTPUT_JIT;
+		} else if (strcmp(argv[i], "--layout-report") == 0) {
+			layout_report = 1;
+		} else if (strcmp(argv[i], "--stats") == 0) {
+			stats_report = 1;
+		} else if (strncmp(argv[i], "--stats=", 8) == 0) {
+			stats_report = 1;
+			stats_path = argv[i] + 8;
+		} else if (strncmp(argv[i], "-march=", 7) == 0) {
+			char *cpu = argv[i] + 7;
+			if (strcmp(cpu, "x86-64") == 0) {
+				march = MARCH_SSE2;
+			} else if (strcmp(cpu, "x86-64-v2") == 0) {
+				march = MARCH_SSE4_1;
+			} else if (strcmp(cpu, "x86-64-v3") == 0) {
+				march = MARCH_AVX2;
+			} else if (strcmp(cpu, "native") == 0) {
+				__builtin_cpu_init();
+				march = __builtin_cpu_supports("avx2") ? MARCH_AVX2 : __builtin_cpu_supports("sse4.1") ? MARCH_SSE4_1 : MARCH_SSE2;
 			} else {
-				prv->nxt = id->nxt;
+				fprintf(stderr, "ERROR: unknown cpu %s\n", cpu);
+				usage(argv[0]);
+				exit(1);
 			}
-			free(id);
-			ids_count--;
-			break;
+		} else if (strncmp(argv[i], "--unroll=", 9) == 0) {
+			char *end;
+			unsigned long factor = strtoul(argv[i] + 9, &end, 10);
+			if (end == argv[i] + 9 || *end || factor > 1024) {
+				fprintf(stderr, "ERROR: unroll factor %s isn't a number up to 1024\n", argv[i] + 9);
+				usage(argv[0]);
+				exit(1);
+			}
+			unroll_factor = factor;
+		} else if (strcmp(argv[i], "-o") == 0) {
+			if (i + 1 >= argc) {
+				fprintf(stderr, "ERROR: -o without a path\n");
+				usage(argv[0]);
+				exit(1);
+			}
+			output_path = argv[++i];
+		} else if (argv[i][0] == '-') {
+			fprintf(stderr, "ERROR: unknown option %s\n", argv[i]);
+			usage(argv[0]);
+			exit(1);
+		} else {
+			src_path = argv[i];
 		}
-		prv = id;
-		id = id->nxt;
 	}
-	if (!id) {
-		fprintf(stderr, "ERROR: trying to remove identifier '%.*s', but it doesn't exists\n", siz, str);
+	if (!src_path) {
+		fprintf(stderr, "ERROR: file path not provided\n");
+		usage(argv[0]);
 		exit(1);
 	}
+	if (!output_path) {
+		static char *const default_path[] = { "output.s", "output", "output.o", NULL, NULL };
+		output_path = default_path[output];
+	}
 }
 
 void
-print_ids(void) {
-	for (unsigned int i = 0; i < ids_cap; i++) {
-		printf("ids[%u] = { ", i);
-		if (ids[i] != NULL) {
-			identifier_t *id = ids[i];
-			while (id) {
-				printf("{ %s: %.*s }", identifier_type_str[id->type], id->siz, id->str);
-				id = id->nxt;
-				if (id) printf(", ");
-			}
-		} else {
-				printf("NULL");
+get_source(void) {
+	int fd = open(src_path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "ERROR: could not open file %s: %s\n", src_path, strerror(errno));
+		exit(1);
+	}
+	if (!S_ISREG(st.st_mode)) {
+		/* pipes and the like can't be mapped, so they are read into the heap */
+		unsigned int cap = 4096;
+		ssize_t n;
+		src = malloc(cap + 1 + LEX_PADDING);
+		while ((n = read(fd, src + f_siz, cap - f_siz)) > 0) {
+			f_siz += n;
+			if (f_siz == cap) src = realloc(src, (cap *= 2) + 1 + LEX_PADDING);
+		}
+		memset(src + f_siz, 0, 1 + LEX_PADDING);
+		close(fd);
+		return;
+	}
+	if ((unsigned long long)st.st_size > 0xffffffffu - 1 - LEX_PADDING) {
+		fprintf(stderr, "ERROR: file %s is too big\n", src_path);
+		exit(1);
+	}
+	f_siz = st.st_size;
+	src_map_siz = align(f_siz + 1 + LEX_PADDING, (unsigned int)sysconf(_SC_PAGESIZE));
+	/* the file is mapped over zeroed pages, which give the lexer its '\0' and padding */
+	src = mmap(NULL, src_map_siz, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (src == MAP_FAILED || (f_siz && mmap(src, f_siz, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+		fprintf(stderr, "ERROR: could not map file %s: %s\n", src_path, strerror(errno));
+		exit(1);
+	}
+	madvise(src, f_siz, MADV_SEQUENTIAL);
+	close(fd);
+}
+
+char *
+token_str(token_t *tkn) {
+	return src + tkn->off;
+}
+
+token_t *
+token_next(token_t *tkn) {
+	return tkn[1].type == TKN_SEMICOLON ? NULL : tkn + 1;
+}
+
+unsigned long long
+token_integer(token_t *tkn) {
+	unsigned long long val = 0;
+	for (unsigned int i = 0; i < tkn->siz; i++) {
+		unsigned int digit = token_str(tkn)[i] - '0';
+		if (val > (~0ull - digit) / 10) {
+			fprintf(stderr, "ERROR: integer '%.*s' doesn't fit in 64 bits\n", tkn->siz, token_str(tkn));
+			exit(1);
 		}
-		printf(" }\n");
+		val = val * 10 + digit;
 	}
+	return val;
 }
 
 void
-string_cat(string_t *str, string_t src) {
-	unsigned int idx_modify = str->siz;
-	str->siz += src.siz;
-	str->buf = realloc(str->buf, str->siz);
-	for (unsigned int i = 0; i < src.siz; i++) {
-		str->buf[idx_modify + i] = src.buf[i];
+print_token(token_t *tkn) {
+	printf("%s %.*s", token_type_str[tkn->type], tkn->siz, token_str(tkn));
+}
+
+token_t *
+push_token(unsigned int type, char *str, unsigned int siz, unsigned int precedence) {
+	if (tkns_count >= tkns_cap) {
+		tkns_cap = tkns_cap ? tkns_cap * 2 : 256;
+		tkns = realloc(tkns, sizeof(token_t) * tkns_cap);
 	}
+	token_t *tkn = &tkns[tkns_count++];
+	tkn->type = type;
+	tkn->precedence = precedence;
+	tkn->off = str - src;
+	tkn->siz = siz;
+	tkn->id = ID_NONE;
+	return tkn;
 }
 
-#define string(str, siz) ((string_t){ (str), (siz) })
-#define cstring(cstr) ((string_t){ (cstr), strlen((cstr)) })
-#define cstring_cat(str, src) (string_cat(str, cstring(src)))
+enum {
+	CHR_EMPTY  = 1 << 0,
+	CHR_LETTER = 1 << 1,
+	CHR_NUMBER = 1 << 2,
+};
 
-/* DOIL - DatO Intermediate Language */
 typedef struct {
-	union {
-		unsigned int reg;
-		string_t cst;
-	} val;
-	int is_reg;
-	int unused;
-} reg_or_const;
+	char *str;
+	unsigned char siz;
+	unsigned char type;
+} keyword_t;
 
-typedef struct instruction {
-	enum {
-		DOIL_ADD,
-		DOIL_SUB,
-		DOIL_MUL,
-		DOIL_DIV,
-		DOIL_DEF,
-		DOIL_MOV,
-		DOIL_SET,
-		DOIL_GET,
-		DOIL_RET,
-	} type;
-	union {
-		struct {
-			reg_or_const lhs;
-			reg_or_const rhs;
-			unsigned int dst;
-		} ope; /*ope r0 r1 r2 = (r2 = r0 ? r1)*/
-		struct {
-			string_t name;
-			enum {
-				DOIL_BYTE,
-				DOIL_WORD,
-				DOIL_DWORD,
-				DOIL_QWORD,
-			} type;
-		} def; /*def x u8 = (var x: u8)*/
-		struct {
-			unsigned int reg;
-			string_t val;
-		} mov; /*mov r0 10 = (r0 = 10)*/
-		struct {
-			reg_or_const dst;
-			reg_or_const src;
-		} set; /*set x 10 = (x = 10)*/
-		struct {
-			string_t src;
-			unsigned int reg;
-		} get; /*get x r0 = (r0 = x)*/
-		struct {
-			reg_or_const src;
-		} ret; /*ret 20 | ret*/
-	};
+#define KEYWORDS_CAP 256
 
-	struct instruction *nxt;
-} instruction_t;
-const char *const instruction_type_str[] = {
-	"add",
-	"sub",
-	"mul",
-	"div",
-	"def",
-	"mov",
-	"set",
-	"get",
-	"ret",
-};
-const char *const doil_datatype_str[] = {
-	"byte",
-	"word",
-	"dword",
-	"qword",
-};
+static unsigned char char_class[256];
+static struct {
+	unsigned char type;
+	unsigned char precedence;
+} char_token[256];
+static keyword_t keywords[KEYWORDS_CAP];
 
-typedef struct {
-	int used;
-	string_t val;
-} reg_t;
+/* the constants are picked so every keyword and type gets its own slot */
+unsigned int
+keyword_hash(char *str, unsigned int siz) {
+	unsigned int h = 0;
+	for (unsigned int i = 0; i < siz; i++) h = h * 45 + (unsigned char)str[i];
+	return (h ^ (h >> 10)) & (KEYWORDS_CAP - 1);
+}
 
-typedef struct {
-	reg_t *registers;
-	unsigned int registers_count;
-	unsigned int registers_cap;
-	instruction_t *ins;
-	instruction_t *hins;
-	unsigned int optimized;
-} doil_t;
+void
+add_keyword(char *str, unsigned int type) {
+	unsigned int siz = strlen(str);
+	keyword_t *kw = &keywords[keyword_hash(str, siz)];
+	assert(!kw->str && "keyword_hash is not perfect anymore");
+	kw->str = str;
+	kw->siz = siz;
+	kw->type = type;
+}
 
-#define INTEGER_STRING_MAX 20
+void
+lex_init(void) {
+	static char *const types[] = {
+		"i1", "i2", "i4", "i8", "u1", "u2", "u4", "u8", "ptr",
+		"v16i1", "v8i2", "v4i4", "v2i8", "v16u1", "v8u2", "v4u4", "v2u8",
+		"v32i1", "v16i2", "v8i4", "v4i8", "v32u1", "v16u2", "v8u4", "v4u8",
+	};
+	static char *const keys[] = { "ret", "end", "if", "then", "else", "while", "do" };
+	for (const char *c = empty;  *c; c++) char_class[(unsigned char)*c] |= CHR_EMPTY;
+	for (const char *c = letter; *c; c++) char_class[(unsigned char)*c] |= CHR_LETTER;
+	for (const char *c = number; *c; c++) char_class[(unsigned char)*c] |= CHR_NUMBER;
+	for (unsigned int i = 0; i < 256; i++) char_token[i].type = TKN_UNKNOWN;
+	char_token[';'].type = TKN_SEMICOLON;
+	char_token['('].type = TKN_LPARAN;
+	char_token[')'].type = TKN_RPARAN;
+	char_token['['].type = TKN_LBRACKET;
+	char_token[']'].type = TKN_RBRACKET;
+	char_token[','].type = TKN_COMMA;
+	char_token['='].type = TKN_OPERATOR;
+	char_token['+'].type = TKN_OPERATOR;
+	char_token['-'].type = TKN_OPERATOR;
+	char_token['*'].type = TKN_OPERATOR;
+	char_token['/'].type = TKN_OPERATOR;
+	char_token['<'].type = TKN_OPERATOR;
+	char_token['>'].type = TKN_OPERATOR;
+	char_token['='].precedence = 0;
+	char_token['<'].precedence = 1;
+	char_token['>'].precedence = 1;
+	char_token['+'].precedence = 2;
+	char_token['-'].precedence = 2;
+	char_token['*'].precedence = 3;
+	char_token['/'].precedence = 3;
+	for (unsigned int i = 0; i < sizeof(types) / sizeof(types[0]); i++) add_keyword(types[i], TKN_TYPE);
+	for (unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) add_keyword(keys[i], TKN_KEYWORD);
+}
 
-instruction_t *
-doil_make_instruction(doil_t *doil, unsigned int type) {
-	instruction_t *ins = malloc(sizeof(instruction_t));
-	*ins = (instruction_t){0};
-	ins->type = type;
-	if (doil->ins) doil->ins->nxt = ins;
-	doil->ins = ins;
-	if (!doil->hins) doil->hins = ins;
-	return ins;
+/* the source is followed by LEX_PADDING zeroes, so whole vectors can be read until the '\0' */
+char *
+skip_empty(char *s) {
+	if (!(char_class[(unsigned char)s[0]] & CHR_EMPTY)) return s;
+#if defined(__AVX2__)
+	for (;;) {
+		__m256i v = _mm256_loadu_si256((__m256i *)s);
+		__m256i m = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),  _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+		unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(m);
+		if (mask) return s + __builtin_ctz(mask);
+		s += 32;
+	}
+#elif defined(__SSE2__)
+	for (;;) {
+		__m128i v = _mm_loadu_si128((__m128i *)s);
+		__m128i m = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),  _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+		unsigned int mask = ~_mm_movemask_epi8(m) & 0xffff;
+		if (mask) return s + __builtin_ctz(mask);
+		s += 16;
+	}
+#else
+	while (char_class[(unsigned char)s[0]] & CHR_EMPTY) s++;
+	return s;
+#endif
 }
 
-unsigned int
-doil_get_register(doil_t *doil) {
-	for (unsigned int i = 0; i < doil->registers_count; i++) {
-		if (!doil->registers[i].used) {
-			doil->registers[i].used = 1;
-			return i;
-		}
+/* same as skip_empty, for the letters and numbers of a name */
+char *
+skip_name(char *s) {
+#if defined(__AVX2__)
+	for (;;) {
+		__m256i v = _mm256_loadu_si256((__m256i *)s);
+		__m256i l = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		__m256i m = _mm256_or_si256(
+			_mm256_and_si256(_mm256_cmpgt_epi8(l, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), l)),
+			_mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v)));
+		unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(m);
+		if (mask) return s + __builtin_ctz(mask);
+		s += 32;
 	}
-	if (doil->registers_cap <= doil->registers_count) {
-		doil->registers_cap = !doil->registers_cap ? 10 : doil->registers_cap * 2;
-		doil->registers = !doil->registers ? malloc(sizeof(ast_t) * doil->registers_cap) : realloc(doil->registers, doil->registers_cap);
-		for (unsigned int i = doil->registers_count; i < doil->registers_cap; i++) doil->registers[i].used = 0;
+#elif defined(__SSE2__)
+	for (;;) {
+		__m128i v = _mm_loadu_si128((__m128i *)s);
+		__m128i l = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		__m128i m = _mm_or_si128(
+			_mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), l)),
+			_mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), v)));
+		unsigned int mask = ~_mm_movemask_epi8(m) & 0xffff;
+		if (mask) return s + __builtin_ctz(mask);
+		s += 16;
 	}
-	doil->registers[doil->registers_count].used = 1;
-	return doil->registers_count++;
+#else
+	while (char_class[(unsigned char)s[0]] & (CHR_LETTER | CHR_NUMBER)) s++;
+	return s;
+#endif
 }
 
-void
-doil_clear_register(doil_t *doil, int register_index) {
-	doil->registers[register_index].used = 0;
+/* 'then', 'do', 'else' and 'end' close the statement they are in, like a segment does */
+int
+token_ends_statement(token_t *tkn) {
+	if (tkn->type == TKN_SEGMENT) return 1;
+	if (tkn->type != TKN_KEYWORD) return 0;
+	char *str = token_str(tkn);
+	return strncmp(str, "then", max(4, tkn->siz)) == 0 || strncmp(str, "do", max(2, tkn->siz)) == 0 ||
+	       strncmp(str, "else", max(4, tkn->siz)) == 0 || strncmp(str, "end", max(3, tkn->siz)) == 0;
 }
 
-void
-dato_variable_definition_to_doil(doil_t *doil, ast_t *def) {
-	token_t *type = def->hbranch->tkn,
-					*id 	= def->hbranch->nxt->tkn;
-	instruction_t *ins = doil_make_instruction(doil, DOIL_DEF);
-	identifier_t *var = add_identifier(ID_VARIABLE, id->str, id->siz);
-	ins->def.name = string(id->str, id->siz);
-	/*TODO: add a struct for types like the identifiers, for now they are all hard coded and unsigned*/
-	if (strncmp(type->str, "i1", max(type->siz, 2)) == 0 || strncmp(type->str, "u1", max(type->siz, 2)) == 0) {
-		ins->def.type = DOIL_BYTE;
-		var->datatype = DOIL_BYTE;
-	} else if (strncmp(type->str, "i2", max(type->siz, 2)) == 0 || strncmp(type->str, "u2", max(type->siz, 2)) == 0) {
-		ins->def.type = DOIL_WORD;
-		var->datatype = DOIL_WORD;
-	} else if (strncmp(type->str, "i4", max(type->siz, 2)) == 0 || strncmp(type->str, "u4", max(type->siz, 2)) == 0) {
-		ins->def.type = DOIL_DWORD;
-		var->datatype = DOIL_DWORD;
-	} else if (strncmp(type->str, "i8", max(type->siz, 2)) == 0 || strncmp(type->str, "u8", max(type->siz, 2)) == 0) {
-		ins->def.type = DOIL_QWORD;
-		var->datatype = DOIL_QWORD;
+/* returns 0 once the statement that started at the token 'start' is over */
+int
+next_token(unsigned int start) {
+	cur = skip_empty(cur);
+	if (cur[0] == '\0') return 0;
+	if (tkns_count > start && token_ends_statement(&tkns[tkns_count - 1])) return 0;
+	char *str = cur;
+	unsigned int siz, type, precedence = 0;
+	unsigned char chr = cur[0];
+
+	if (char_class[chr] & CHR_LETTER) {
+		cur = skip_name(cur);
+		siz = cur - str;
+		keyword_t *kw = &keywords[keyword_hash(str, siz)];
+		if (cur[0] == ':') {
+			cur++;
+			type = TKN_SEGMENT;
+		} else if (kw->siz == siz && strncmp(str, kw->str, siz) == 0) {
+			type = kw->type;
+		} else {
+			type = TKN_IDENTIFIER;
+		}
+	} else if (char_class[chr] & CHR_NUMBER) {
+		while (char_class[(unsigned char)cur[0]] & CHR_NUMBER) cur++;
+		siz = cur - str;
+		type = TKN_INTEGER;
 	} else {
-		fprintf(stderr, "ERROR: type '%.*s' not supported\n", type->siz, type->str);
-		exit(1);
+		cur++;
+		siz = 1;
+		type = char_token[chr].type;
+		precedence = char_token[chr].precedence;
+		/* <=, >=, == and != */
+		if (cur[0] == '=' && (chr == '<' || chr == '>' || chr == '=' || chr == '!')) {
+			cur++;
+			siz = 2;
+			type = TKN_OPERATOR;
+			precedence = char_token['<'].precedence;
+		}
 	}
+	if (type == TKN_SEMICOLON) return 0;
+	token_t *tkn = push_token(type, str, siz, precedence);
+	if (type == TKN_IDENTIFIER) tkn->id = intern(str, siz);
+	return 1;
 }
 
-unsigned int dato_assignment_to_doil(doil_t *doil, ast_t *asg, int return_register);
-unsigned int dato_expression_to_doil(doil_t *doil, ast_t *exp);
+void
+lex(void) {
+	unsigned int start = tkns_count;
+	while (next_token(start));
+	if (tkns_count == start) return;
 
-unsigned int
-dato_expression_operator_to_doil(doil_t *doil, ast_t *exp, unsigned int operator) {
-	ast_t *lhs = exp->hbranch;
-	ast_t *rhs = exp->hbranch->nxt;
-	
-	unsigned int lhs_register, rhs_register;
+	if (stts_count >= stts_cap) {
+		stts_cap = stts_cap ? stts_cap * 2 : 64;
+		stts = realloc(stts, sizeof(statement_t) * stts_cap);
+	}
+	stts[stts_count++] = (statement_t){ start, tkns_count - start };
+	push_token(TKN_SEMICOLON, cur, 0, 0);
+	//print_statement(&stts[stts_count - 1]);
+}
 
-	int lhs_is_reg = lhs->type != AST_INTEGER;
-	if (lhs_is_reg) lhs_register = dato_expression_to_doil(doil, lhs);
+void
+print_statement(statement_t *stt) {
+	printf("{ ");
+	for (unsigned int i = 0; i < stt->count; i++) {
+		print_token(&tkns[stt->start + i]);
+		if (i + 1 < stt->count) {
+			printf(", ");
+		}
+	}
+	printf(" }\n");
+}
 
-	int rhs_is_reg = rhs->type != AST_INTEGER;
-	if (rhs_is_reg) rhs_register = dato_expression_to_doil(doil, rhs);
+token_t *ast_token(unsigned int node);
 
-	instruction_t *ins = doil_make_instruction(doil, operator);
-	ins->ope.lhs.is_reg = lhs_is_reg;
-	if (lhs_is_reg) {
-		ins->ope.lhs.val.reg = lhs_register;
-		ins->ope.dst = lhs_register;
+/* the AST_SYSTEM whose body is being parsed, 0 outside of one */
+static unsigned int system_branch;
+/* the statements of the ifs and whiles that aren't closed by 'end' yet, innermost last */
+static unsigned int *blocks;
+static unsigned int blocks_count;
+static unsigned int blocks_cap;
+
+void
+change_segment(token_t *tkn) {
+	if (tkn->type != TKN_SEGMENT) return;
+	if (blocks_count) {
+		fprintf(stderr, "ERROR: '%.*s:' can't be inside of an 'if' or a 'while'\n", tkn->siz, token_str(tkn));
+		exit(1);
+	}
+	if (system_branch && strncmp(token_str(tkn), "data", max(tkn->siz, 4)) != 0 && strncmp(token_str(tkn), "logic", max(tkn->siz, 5)) != 0) {
+		token_t *name = ast_token(system_branch);
+		fprintf(stderr, "ERROR: '%.*s:' can't be in the system '%.*s', only 'data:' and 'logic:' can\n", tkn->siz, token_str(tkn), name->siz, token_str(name));
+		exit(1);
+	}
+	if (strncmp(token_str(tkn), "data", max(tkn->siz, 4)) == 0) {
+		segment = SEG_DATA;
+	} else if (strncmp(token_str(tkn), "logic", max(tkn->siz, 5)) == 0) {
+		segment = SEG_LOGIC;
+	} else if (strncmp(token_str(tkn), "system", max(tkn->siz, 6)) == 0) {
+		segment = SEG_SYSTEM;
+	} else if (strncmp(token_str(tkn), "layout", max(tkn->siz, 6)) == 0) {
+		segment = SEG_LAYOUT;
 	} else {
-		ins->ope.lhs.val.cst = string(lhs->tkn->str, lhs->tkn->siz);
-		ins->ope.dst = doil_get_register(doil);
-		doil->registers[ins->ope.dst].val = ins->ope.lhs.val.cst;
+		// TODO: add position
+		fprintf(stderr, "ERROR: '%.*s' is not a segment\n", tkn->siz, token_str(tkn));
+		exit(1); 
 	}
+}
 
-	ins->ope.rhs.is_reg = rhs_is_reg;
-	if (rhs_is_reg) {
-		ins->ope.rhs.val.reg = rhs_register;
-		doil_clear_register(doil, rhs_register);
-	} else {
-		ins->ope.rhs.val.cst = string(rhs->tkn->str, rhs->tkn->siz);
+void
+ast_grow(unsigned int cap) {
+	ast_t new_ast = { .count = ast.count, .cap = cap };
+	new_ast.type    = arena_alloc(&ast_arena, sizeof(unsigned char) * cap);
+	new_ast.tkn     = arena_alloc(&ast_arena, sizeof(unsigned int) * cap);
+	new_ast.child   = arena_alloc(&ast_arena, sizeof(unsigned int) * cap);
+	new_ast.sibling = arena_alloc(&ast_arena, sizeof(unsigned int) * cap);
+	new_ast.last    = arena_alloc(&ast_arena, sizeof(unsigned int) * cap);
+	new_ast.prv     = arena_alloc(&ast_arena, sizeof(unsigned int) * cap);
+	new_ast.root    = arena_alloc(&ast_arena, sizeof(unsigned int) * cap);
+	if (ast.count) {
+		memcpy(new_ast.type,    ast.type,    sizeof(unsigned char) * ast.count);
+		memcpy(new_ast.tkn,     ast.tkn,     sizeof(unsigned int) * ast.count);
+		memcpy(new_ast.child,   ast.child,   sizeof(unsigned int) * ast.count);
+		memcpy(new_ast.sibling, ast.sibling, sizeof(unsigned int) * ast.count);
+		memcpy(new_ast.last,    ast.last,    sizeof(unsigned int) * ast.count);
+		memcpy(new_ast.prv,     ast.prv,     sizeof(unsigned int) * ast.count);
+		memcpy(new_ast.root,    ast.root,    sizeof(unsigned int) * ast.count);
 	}
+	ast = new_ast;
+}
 
-	return ins->ope.dst;
+token_t *
+ast_token(unsigned int node) {
+	return ast.tkn[node] == AST_NO_TOKEN ? NULL : &tkns[ast.tkn[node]];
 }
 
 unsigned int
-dato_expression_to_doil(doil_t *doil, ast_t *exp) {
-	unsigned int register_index;
+ast_new_branch(unsigned int root, token_t *tkn) {
+	if (root >= ast.count) {
+		fprintf(stderr, "ERROR: trying to create a new branch, but root doesn't exist\n");
+		exit(1);
+	}
+	if (ast.count >= ast.cap) ast_grow(ast.cap * 2);
+	unsigned int new_branch = ast.count++;
+	ast.type[new_branch] = AST_PROGRAM;
+	ast.tkn[new_branch] = tkn ? (unsigned int)(tkn - tkns) : AST_NO_TOKEN;
+	ast.child[new_branch] = AST_NONE;
+	ast.sibling[new_branch] = AST_NONE;
+	ast.last[new_branch] = AST_NONE;
+	ast.prv[new_branch] = ast.last[root];
+	ast.root[new_branch] = root;
 
-	instruction_t *ins;
-	identifier_t *var;
+	if (!ast.last[root]) {
+		ast.child[root] = new_branch;
+	} else {
+		ast.sibling[ast.last[root]] = new_branch;
+	}
+	ast.last[root] = new_branch;
+	return new_branch;
+}
 
-	switch (exp->type) {
-		case AST_ADD:
-			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_ADD);
+void
+ast_branch_change_root(unsigned int branch, unsigned int new_root) {
+	unsigned int prv_root = ast.root[branch];
+	if (ast.prv[branch]) {
+		ast.sibling[ast.prv[branch]] = ast.sibling[branch];
+	} else {
+		ast.child[prv_root] = ast.sibling[branch];
+	}
+	if (ast.sibling[branch]) {
+		ast.prv[ast.sibling[branch]] = ast.prv[branch];
+	} else {
+		ast.last[prv_root] = ast.prv[branch];
+	}
+	ast.sibling[branch] = AST_NONE;
+	ast.prv[branch] = ast.last[new_root];
+	ast.root[branch] = new_root;
+	if (ast.prv[branch]) {
+		ast.sibling[ast.prv[branch]] = branch;
+	} else {
+		ast.child[new_root] = branch;
+	}
+	ast.last[new_root] = branch;
+}
+
+void parse_expression(unsigned int root, token_t **out_tkn);
+
+/* name(argument, argument...), every argument is an expression of its own */
+void
+parse_call(unsigned int call, token_t **out_tkn) {
+	token_t *name = *out_tkn, *tkn = token_next(token_next(name));
+	ast.type[call] = AST_CALL;
+	while (tkn && tkn->type != TKN_RPARAN) {
+		if (tkn->type != TKN_IDENTIFIER && tkn->type != TKN_INTEGER) {
+			fprintf(stderr, "ERROR: %.*s isn't valid as an argument of '%.*s'\n", tkn->siz, token_str(tkn), name->siz, token_str(name));
+			exit(1);
+		}
+		/* the operands and operators of one argument, until ',' or ')' */
+		for (; tkn && tkn->type != TKN_COMMA && tkn->type != TKN_RPARAN; tkn = token_next(tkn)) parse_expression(call, &tkn);
+		if (tkn && tkn->type == TKN_COMMA) {
+			tkn = token_next(tkn);
+			if (!tkn || tkn->type == TKN_RPARAN) {
+				fprintf(stderr, "ERROR: expected an argument of '%.*s' after ','\n", name->siz, token_str(name));
+				exit(1);
+			}
+		}
+	}
+	if (!tkn) {
+		fprintf(stderr, "ERROR: expected ')' after the arguments of '%.*s'\n", name->siz, token_str(name));
+		exit(1);
+	}
+	*out_tkn = tkn;
+}
+
+void
+parse_expression(unsigned int root, token_t **out_tkn) {
+	if (!out_tkn || !*out_tkn) {
+		fprintf(stderr, "ERROR: trying to parse a expression, but token is NULL\n");
+		exit(1);
+	}
+	token_t *tkn = *out_tkn;
+	unsigned int lhs = ast.last[root], expr = ast_new_branch(root, tkn);
+
+	switch(tkn->type) {
+		case TKN_INTEGER:
+				ast.type[expr] = AST_INTEGER;
+			break;
+		case TKN_IDENTIFIER:
+				ast.type[expr] = AST_IDENTIFIER;
+			if (token_next(tkn) && token_next(tkn)->type == TKN_LPARAN) {
+				parse_call(expr, out_tkn);
+			} else if (token_next(tkn) && token_next(tkn)->type == TKN_LBRACKET) {
+				/* name[index], the index is a single variable or integer */
+				token_t *idx = token_next(token_next(tkn));
+				if (!idx || (idx->type != TKN_IDENTIFIER && idx->type != TKN_INTEGER) || !token_next(idx) || token_next(idx)->type != TKN_RBRACKET) {
+					fprintf(stderr, "ERROR: '%.*s' can only be indexed by a variable or an integer\n", tkn->siz, token_str(tkn));
+					exit(1);
+				}
+				ast.type[expr] = AST_INDEX;
+				unsigned int index = ast_new_branch(expr, idx);
+				ast.type[index] = idx->type == TKN_INTEGER ? AST_INTEGER : AST_IDENTIFIER;
+				*out_tkn = token_next(idx);
+			}
+			break;
+		case TKN_OPERATOR:
+			if (!lhs) {
+				fprintf(stderr, "ERROR: %.*s without a left hand side\n", tkn->siz, token_str(tkn));
+				exit(1);
+			}
+			if (ast.type[lhs] != AST_INTEGER && ast.type[lhs] != AST_IDENTIFIER && ast.type[lhs] != AST_INDEX && ast.type[lhs] != AST_CALL && !(ast_token(lhs) && ast_token(lhs)->type == TKN_OPERATOR)) {
+				if (ast_token(lhs)) fprintf(stderr, "ERROR: %.*s", ast_token(lhs)->siz, token_str(ast_token(lhs)));
+				else					fprintf(stderr, "ERROR: %s", ast_type_str[ast.type[lhs]]);
+				fprintf(stderr, " isn't valid as left hand side of %.*s\n", tkn->siz, token_str(tkn));
+				exit(1);
+			}
+			if (!token_next(tkn)) {
+				fprintf(stderr, "ERROR: %.*s without a right hand side\n", tkn->siz, token_str(tkn));
+				exit(1);
+			}
+			if (token_next(tkn)->type != TKN_INTEGER && token_next(tkn)->type != TKN_IDENTIFIER) {
+				fprintf(stderr, "ERROR: %.*s isn't valid as right hand side of %.*s\n", token_next(tkn)->siz, token_str(token_next(tkn)), tkn->siz, token_str(tkn));
+				exit(1);
+			}
+			if (ast_token(lhs) && ast_token(lhs)->type == TKN_OPERATOR && ast_token(lhs)->precedence < tkn->precedence) assert(0 && "parse_expression: unreacheble");
+			if (strncmp("=", token_str(tkn), max(1, tkn->siz)) == 0) {
+				ast.type[expr] = AST_ASSIGN;
+			} else if (strncmp("+", token_str(tkn), max(1, tkn->siz)) == 0) {
+				ast.type[expr] = AST_ADD;
+			} else if (strncmp("-", token_str(tkn), max(1, tkn->siz)) == 0) {
+				ast.type[expr] = AST_SUB;
+			} else if (strncmp("*", token_str(tkn), max(1, tkn->siz)) == 0) {
+				ast.type[expr] = AST_MUL;
+			} else if (strncmp("/", token_str(tkn), max(1, tkn->siz)) == 0) {
+				ast.type[expr] = AST_DIV;
+			} else if (strncmp("<", token_str(tkn), max(1, tkn->siz)) == 0) {
+				ast.type[expr] = AST_LT;
+			} else if (strncmp(">", token_str(tkn), max(1, tkn->siz)) == 0) {
+				ast.type[expr] = AST_GT;
+			} else if (strncmp("<=", token_str(tkn), max(2, tkn->siz)) == 0) {
+				ast.type[expr] = AST_LE;
+			} else if (strncmp(">=", token_str(tkn), max(2, tkn->siz)) == 0) {
+				ast.type[expr] = AST_GE;
+			} else if (strncmp("==", token_str(tkn), max(2, tkn->siz)) == 0) {
+				ast.type[expr] = AST_EQ;
+			} else if (strncmp("!=", token_str(tkn), max(2, tkn->siz)) == 0) {
+				ast.type[expr] = AST_NE;
+			} else {
+				fprintf(stderr, "ERROR: operator '%.*s' is not handled\n", tkn->siz, token_str(tkn));
+				exit(1);
+			}
+			ast_branch_change_root(lhs, expr);
+			*out_tkn = token_next(tkn);
+			parse_expression(expr, out_tkn);
+			/* the right hand side ended at *out_tkn, which is past token_next(tkn) when it is indexed */
+			token_t *nxt = token_next(*out_tkn);
+			if (nxt && nxt->type == TKN_OPERATOR) {
+				*out_tkn = nxt;
+				if (nxt->precedence > tkn->precedence) {
+					parse_expression(expr, out_tkn);
+				} else {
+					/* nxt takes as its left hand side the last operator that binds at least as tight */
+					unsigned int at = ast.root[expr];
+					while (ast_token(at) && ast_token(at)->type == TKN_OPERATOR && ast_token(at)->precedence >= nxt->precedence) at = ast.root[at];
+					parse_expression(at, out_tkn);
+				}
+			}
+			break;
+		default:
+			fprintf(stderr, "ERROR: %.*s is not valid as an expression\n", tkn->siz, token_str(tkn));
+			exit(1);
+			break;
+	}
+}
+
+void
+parse_variable_declaration(unsigned int root, token_t **out_tkn) {
+	if (!out_tkn || !*out_tkn) {
+		fprintf(stderr, "ERROR: trying to parse a variable declaration, but token is NULL\n");
+		exit(1);
+	}
+	token_t *tkn = *out_tkn;
+	if (!token_next(tkn)) {
+		fprintf(stderr, "ERROR: incomplete variable declaration\n");
+		exit(1);
+	}
+	if (token_next(tkn)->type != TKN_IDENTIFIER) {
+		fprintf(stderr, "ERROR: %.*s is not a valid name for a variable\n", token_next(tkn)->siz, token_str(token_next(tkn)));
+		exit(1);
+	}
+	/* type name, type name[length] or type name[] for a slice */
+	token_t *name = token_next(tkn), *length = NULL, *end = name;
+	if (token_next(name) && token_next(name)->type == TKN_LBRACKET) {
+		end = token_next(token_next(name));
+		if (end && end->type == TKN_INTEGER) {
+			length = end;
+			end = token_next(end);
+		}
+		if (!end || end->type != TKN_RBRACKET) {
+			fprintf(stderr, "ERROR: expected ']' after '%.*s['\n", name->siz, token_str(name));
+			exit(1);
+		}
+	}
+	if (token_next(end)) {
+		fprintf(stderr, "ERROR: expected ';' before '%.*s'\n", token_next(end)->siz, token_str(token_next(end))); 
+		exit(1);
+	}
+	unsigned int vardef = ast_new_branch(root, NULL);
+	ast.type[vardef] = AST_VARDEF;
+
+	unsigned int vartype = ast_new_branch(vardef, tkn);
+	ast.type[vartype] = AST_TYPE;
+	unsigned int varname = ast_new_branch(vardef, name);
+	ast.type[varname] = AST_IDENTIFIER;
+	if (end != name) {
+		unsigned int len = ast_new_branch(vardef, length);
+		ast.type[len] = length ? AST_INTEGER : AST_SLICE;
+	}
+	*out_tkn = end;
+}
+
+/* where the statements go: the innermost if or while, the system or the program */
+unsigned int
+parse_branch(unsigned int root) {
+	if (blocks_count) return blocks[blocks_count - 1];
+	return system_branch ? system_branch : root;
+}
+
+void
+parse_push_block(unsigned int block) {
+	if (blocks_count >= blocks_cap) {
+		blocks_cap = blocks_cap ? blocks_cap * 2 : 8;
+		blocks = realloc(blocks, sizeof(unsigned int) * blocks_cap);
+	}
+	blocks[blocks_count++] = block;
+}
+
+/* if condition then, while condition do: the condition is an expression of its own */
+void
+parse_condition(unsigned int node, token_t **out_tkn, char *end) {
+	token_t *keyword = *out_tkn, *tkn = token_next(keyword);
+	unsigned int siz = strlen(end);
+	for (; tkn && !(tkn->type == TKN_KEYWORD && strncmp(token_str(tkn), end, max(siz, tkn->siz)) == 0); tkn = token_next(tkn)) {
+		if (tkn->type != TKN_IDENTIFIER && tkn->type != TKN_INTEGER && tkn->type != TKN_OPERATOR) {
+			fprintf(stderr, "ERROR: %.*s isn't valid in the condition of '%.*s'\n", tkn->siz, token_str(tkn), keyword->siz, token_str(keyword));
+			exit(1);
+		}
+		parse_expression(node, &tkn);
+	}
+	if (!tkn) {
+		fprintf(stderr, "ERROR: expected '%s' after the condition of '%.*s'\n", end, keyword->siz, token_str(keyword));
+		exit(1);
+	}
+	if (!ast.child[node] || ast.child[node] != ast.last[node]) {
+		fprintf(stderr, "ERROR: '%.*s' needs one expression as its condition\n", keyword->siz, token_str(keyword));
+		exit(1);
+	}
+	parse_push_block(ast_new_branch(node, tkn));
+	*out_tkn = tkn;
+}
+
+void
+parse_keyword(unsigned int *out_root, token_t **out_tkn) {
+	if (!out_root) {
+		fprintf(stderr, "ERROR: trying to parse a keyword, but root is NULL\n");
+		exit(1);
+	}
+	if (!out_tkn || !*out_tkn) {
+		fprintf(stderr, "ERROR: trying to parse a keyword, but token is NULL\n");
+		exit(1);
+	}
+	token_t *tkn = *out_tkn;
+	unsigned int root = *out_root;
+	if (strncmp(token_str(tkn), "ret", max(3, tkn->siz)) == 0) {
+		unsigned int ret = ast_new_branch(root, NULL);
+		ast.type[ret] = AST_RETURN;
+		if (token_next(tkn)) {
+			root = ret;
+		}
+	} else if (strncmp(token_str(tkn), "if", max(2, tkn->siz)) == 0) {
+		unsigned int node = ast_new_branch(root, tkn);
+		ast.type[node] = AST_IF;
+		parse_condition(node, out_tkn, "then");
+	} else if (strncmp(token_str(tkn), "while", max(5, tkn->siz)) == 0) {
+		unsigned int node = ast_new_branch(root, tkn);
+		ast.type[node] = AST_WHILE;
+		parse_condition(node, out_tkn, "do");
+	} else if (strncmp(token_str(tkn), "else", max(4, tkn->siz)) == 0) {
+		unsigned int node = blocks_count ? ast.root[blocks[blocks_count - 1]] : AST_NONE;
+		if (!node || ast.type[node] != AST_IF || ast.last[node] != ast.sibling[ast.child[node]]) {
+			fprintf(stderr, "ERROR: 'else' without 'if'\n");
+			exit(1);
+		}
+		blocks[blocks_count - 1] = ast_new_branch(node, tkn);
+	} else if (strncmp(token_str(tkn), "end", max(3, tkn->siz)) == 0 && blocks_count) {
+		blocks_count--;
+	} else if (strncmp(token_str(tkn), "end", max(3, tkn->siz)) == 0) {
+		if (!system_branch) {
+			fprintf(stderr, "ERROR: 'end' outside of a system\n");
+			exit(1);
+		}
+		root = ast.root[system_branch];
+		system_branch = 0;
+		segment = SEG_SYSTEM;
+	} else if (strncmp(token_str(tkn), "then", max(4, tkn->siz)) == 0 || strncmp(token_str(tkn), "do", max(2, tkn->siz)) == 0) {
+		fprintf(stderr, "ERROR: '%.*s' without %s\n", tkn->siz, token_str(tkn), token_str(tkn)[0] == 't' ? "'if'" : "'while'");
+		exit(1);
+	} else {
+		fprintf(stderr, "ERROR: keyword '%.*s' is not handled\n", tkn->siz, token_str(tkn));
+		exit(1);
+	}
+	*out_root = root;
+}
+
+/*
+ * [type] name(type name, type name...) followed by a segment of its body, which goes until 'end',
+ * or by nothing for a system written in C. the AST_SYSTEM has the return type, the parameters
+ * and then the statements of the body as children.
+ */
+void
+parse_system(unsigned int root, token_t **out_tkn) {
+	token_t *tkn = *out_tkn, *type = NULL;
+	if (tkn->type == TKN_TYPE) {
+		type = tkn;
+		tkn = token_next(tkn);
+	}
+	if (!tkn || tkn->type != TKN_IDENTIFIER) {
+		fprintf(stderr, "ERROR: expected the name of a system after '%.*s'\n", (*out_tkn)->siz, token_str(*out_tkn));
+		exit(1);
+	}
+	token_t *name = tkn;
+	tkn = token_next(tkn);
+	if (!tkn || tkn->type != TKN_LPARAN) {
+		fprintf(stderr, "ERROR: expected '(' after '%.*s'\n", name->siz, token_str(name));
+		exit(1);
+	}
+	unsigned int system = ast_new_branch(root, name);
+	ast.type[system] = AST_SYSTEM;
+	if (type) ast.type[ast_new_branch(system, type)] = AST_TYPE;
+	for (tkn = token_next(tkn); tkn && tkn->type != TKN_RPARAN;) {
+		if (tkn->type != TKN_TYPE || !token_next(tkn) || token_next(tkn)->type != TKN_IDENTIFIER) {
+			fprintf(stderr, "ERROR: expected the type and the name of a parameter of '%.*s', got '%.*s'\n", name->siz, token_str(name), tkn->siz, token_str(tkn));
+			exit(1);
+		}
+		unsigned int param = ast_new_branch(system, NULL);
+		ast.type[param] = AST_PARAM;
+		ast.type[ast_new_branch(param, tkn)] = AST_TYPE;
+		tkn = token_next(tkn);
+		ast.type[ast_new_branch(param, tkn)] = AST_IDENTIFIER;
+		tkn = token_next(tkn);
+		if (tkn && tkn->type == TKN_COMMA) {
+			tkn = token_next(tkn);
+			if (!tkn || tkn->type == TKN_RPARAN) {
+				fprintf(stderr, "ERROR: expected a parameter of '%.*s' after ','\n", name->siz, token_str(name));
+				exit(1);
+			}
+		} else if (tkn && tkn->type != TKN_RPARAN) {
+			fprintf(stderr, "ERROR: expected ',' or ')' before '%.*s'\n", tkn->siz, token_str(tkn));
+			exit(1);
+		}
+	}
+	if (!tkn) {
+		fprintf(stderr, "ERROR: expected ')' after the parameters of '%.*s'\n", name->siz, token_str(name));
+		exit(1);
+	}
+	if (!token_next(tkn)) {
+		ast.type[system] = AST_EXTERN;
+	} else if (token_next(tkn)->type == TKN_SEGMENT) {
+		system_branch = system;
+	} else {
+		fprintf(stderr, "ERROR: expected ';' or the segment of the body of '%.*s' before '%.*s'\n", name->siz, token_str(name), token_next(tkn)->siz, token_str(token_next(tkn)));
+		exit(1);
+	}
+	*out_tkn = tkn;
+}
+
+/* the integer after a layout word, between 1 and max */
+unsigned int
+parse_layout_integer(token_t **out_tkn, unsigned int max, int power_of_two) {
+	token_t *tkn = *out_tkn, *val = token_next(tkn);
+	if (!val || val->type != TKN_INTEGER) {
+		fprintf(stderr, "ERROR: expected an integer after '%.*s'\n", tkn->siz, token_str(tkn));
+		exit(1);
+	}
+	unsigned long long n = token_integer(val);
+	if (n == 0 || n > max || (power_of_two && (n & (n - 1)))) {
+		fprintf(stderr, "ERROR: '%.*s %.*s' should be %sbetween 1 and %u\n", tkn->siz, token_str(tkn), val->siz, token_str(val), power_of_two ? "a power of two " : "", max);
+		exit(1);
+	}
+	*out_tkn = val;
+	return n;
+}
+
+/* [hot | cold | align n | pad n]... [aos | soa | aosoa n] variable, variable... */
+void
+parse_layout(token_t **out_tkn) {
+	token_t *tkn = *out_tkn;
+	layout_t layout = { .type = LAYOUT_SOA, .width = 1 };
+	for (; tkn && tkn->type == TKN_IDENTIFIER && token_next(tkn) && token_next(tkn)->type != TKN_COMMA; tkn = token_next(tkn)) {
+		if (strncmp(token_str(tkn), "hot", max(3, tkn->siz)) == 0) {
+			layout.temperature = LAYOUT_HOT;
+		} else if (strncmp(token_str(tkn), "cold", max(4, tkn->siz)) == 0) {
+			layout.temperature = LAYOUT_COLD;
+		} else if (strncmp(token_str(tkn), "align", max(5, tkn->siz)) == 0) {
+			layout.align = parse_layout_integer(&tkn, 4096, 1);
+		} else if (strncmp(token_str(tkn), "pad", max(3, tkn->siz)) == 0) {
+			layout.pad = parse_layout_integer(&tkn, 4096, 0);
+		} else if (strncmp(token_str(tkn), "aos", max(3, tkn->siz)) == 0) {
+			layout.type = LAYOUT_AOS;
+		} else if (strncmp(token_str(tkn), "soa", max(3, tkn->siz)) == 0) {
+			layout.type = LAYOUT_SOA;
+		} else if (strncmp(token_str(tkn), "aosoa", max(5, tkn->siz)) == 0) {
+			layout.type = LAYOUT_AOSOA;
+			layout.width = parse_layout_integer(&tkn, 64, 0);
+		} else {
+			break;
+		}
+	}
+
+	unsigned int count = 0;
+	for (token_t *t = tkn; t; t = token_next(t)) count++;
+	layout.vars = arena_alloc(&doil_arena, sizeof(unsigned int) * (count + 1));
+	for (;;) {
+		if (!tkn || tkn->type != TKN_IDENTIFIER) {
+			if (tkn) fprintf(stderr, "ERROR: expected a variable in the layout, got '%.*s'\n", tkn->siz, token_str(tkn));
+			else     fprintf(stderr, "ERROR: layout without variables\n");
+			exit(1);
+		}
+		layout.vars[layout.vars_count++] = tkn->id;
+		if (!token_next(tkn)) break;
+		if (token_next(tkn)->type != TKN_COMMA) {
+			fprintf(stderr, "ERROR: expected ',' before '%.*s'\n", token_next(tkn)->siz, token_str(token_next(tkn)));
+			exit(1);
+		}
+		tkn = token_next(token_next(tkn));
+	}
+
+	if (layouts_count >= layouts_cap) {
+		layouts_cap = layouts_cap ? layouts_cap * 2 : 8;
+		layouts = realloc(layouts, sizeof(layout_t) * layouts_cap);
+	}
+	layouts[layouts_count++] = layout;
+	*out_tkn = tkn;
+}
+
+/* the variables of a layout are only known once every data segment was lowered */
+void
+layout_resolve(void) {
+	for (unsigned int i = 0; i < layouts_count; i++) {
+		for (unsigned int j = 0; j < layouts[i].vars_count; j++) {
+			identifier_t *var = get_identifier(ID_VARIABLE, layouts[i].vars[j]);
+			if (!var) {
+				identifier_t *id = &ids[layouts[i].vars[j]];
+				fprintf(stderr, "ERROR: '%.*s' in the layout isn't a variable\n", id->siz, id->str);
+				exit(1);
+			}
+			if (var->layout) {
+				fprintf(stderr, "ERROR: '%.*s' is in more than one layout\n", var->siz, var->str);
+				exit(1);
+			}
+			var->layout = i + 1;
+			if (layouts[i].type == LAYOUT_SOA) continue;
+			/* the elements of every variable are interleaved, one record per index */
+			if (var->is_slice || var->is_vector) {
+				fprintf(stderr, "ERROR: the %s '%.*s' can only be in a soa layout\n", var->is_slice ? "slice" : "vector", var->siz, var->str);
+				exit(1);
+			}
+			if (var->is_sliced) {
+				fprintf(stderr, "ERROR: '%.*s' is assigned to a slice, it can only be in a soa layout\n", var->siz, var->str);
+				exit(1);
+			}
+			identifier_t *first = &ids[layouts[i].vars[0]];
+			if ((var->length ? var->length : 1) != (first->length ? first->length : 1)) {
+				fprintf(stderr, "ERROR: '%.*s' and '%.*s' should have the same length to share records\n", first->siz, first->str, var->siz, var->str);
+				exit(1);
+			}
+		}
+	}
+}
+
+unsigned int
+parse(void) {
+	lex_init();
+	cur = src;
+	while (cur[0] != '\0') lex();
+
+	/* every token makes at most one node, plus one without a token per statement */
+	ast_grow(tkns_count + 1);
+	unsigned int root = ast.count++;
+	ast.type[root] = AST_PROGRAM;
+	ast.tkn[root] = AST_NO_TOKEN;
+	ast.child[root] = AST_NONE;
+	ast.sibling[root] = AST_NONE;
+	ast.last[root] = AST_NONE;
+	ast.prv[root] = AST_NONE;
+	ast.root[root] = AST_NONE;
+
+	// TODO: semicolon error handling
+	for (unsigned int i = 0; i < stts_count; i++) {
+		token_t *tkn = &tkns[stts[i].start];
+		unsigned int branch = parse_branch(root);
+		while (tkn) {
+			switch(segment) {
+				case SEG_LOGIC:
+					switch(tkn->type) {
+					case TKN_SEGMENT: change_segment(tkn); break;
+					case TKN_KEYWORD:
+						parse_keyword(&branch, &tkn);
+						break;
+					case TKN_IDENTIFIER:
+					case TKN_INTEGER:
+					case TKN_OPERATOR:
+						parse_expression(branch, &tkn);
+						break;
+					default: 
+						fprintf(stderr, "ERROR: '%.*s' is not handled in 'logic'\n", tkn->siz, token_str(tkn)); 
+						exit(1);
+						break;
+					}
+					break;
+				case SEG_DATA:
+					switch(tkn->type) {
+					case TKN_SEGMENT: change_segment(tkn); break;
+					case TKN_TYPE: 
+						parse_variable_declaration(branch, &tkn);
+						break;
+					case TKN_KEYWORD:
+						/* the body of a system can end after its data */
+						if (system_branch && strncmp(token_str(tkn), "end", max(3, tkn->siz)) == 0) {
+							parse_keyword(&branch, &tkn);
+							break;
+						}
+						/* fallthrough */
+					default: 
+						fprintf(stderr, "ERROR: '%d a.k.a %.*s' is not handled in 'data'\n", tkn->type, tkn->siz, token_str(tkn)); 
+						exit(1);
+						break;
+					}
+					break;
+				case SEG_SYSTEM:
+					switch(tkn->type) {
+					case TKN_SEGMENT: change_segment(tkn); break;
+					case TKN_TYPE:
+					case TKN_IDENTIFIER:
+						parse_system(root, &tkn);
+						break;
+					default:
+						fprintf(stderr, "ERROR: '%.*s' is not handled in 'system'\n", tkn->siz, token_str(tkn));
+						exit(1);
+						break;
+					}
+					break;
+				case SEG_LAYOUT:
+					if (tkn->type == TKN_SEGMENT) change_segment(tkn);
+					else                          parse_layout(&tkn);
+					break;
+				default: assert(0 && "unreachable");
+			}
+			tkn = token_next(tkn);
+		}
+	}
+	if (blocks_count) {
+		token_t *open = ast_token(ast.root[blocks[blocks_count - 1]]);
+		fprintf(stderr, "ERROR: '%.*s' without 'end'\n", open->siz, token_str(open));
+		exit(1);
+	}
+	free(blocks);
+	if (system_branch) {
+		token_t *name = ast_token(system_branch);
+		fprintf(stderr, "ERROR: the system '%.*s' doesn't 'end'\n", name->siz, token_str(name));
+		exit(1);
+	}
+
+	return root;
+}
+
+void
+print_ast(unsigned int root, int depth) {
+	if (ast.child[root]) {
+		for(int i = 0; i < depth; i++) printf("  ");
+		printf("%s {\n", ast_type_str[ast.type[root]]);
+		unsigned int branch = ast.child[root];
+		while (branch) {
+			print_ast(branch, depth + 1);
+			branch = ast.sibling[branch];
+		}
+		for(int i = 0; i < depth; i++) printf("  ");
+		printf("}\n");
+	} else {
+		for(int i = 0; i < depth; i++) printf("  ");
+		printf("%s", ast_type_str[ast.type[root]]);
+		if (ast_token(root)) printf(" : %.*s", ast_token(root)->siz, token_str(ast_token(root)));
+		putchar('\n');
+	}
+}
+
+void
+free_ast(void) {
+	free(tkns);
+	free(stts);
+	arena_free(&ast_arena);
+	ast = (ast_t){0};
+}
+
+void
+string_cat(string_t *str, string_t src) {
+	unsigned int idx_modify = str->siz;
+	str->siz += src.siz;
+	str->buf = realloc(str->buf, str->siz);
+	for (unsigned int i = 0; i < src.siz; i++) {
+		str->buf[idx_modify + i] = src.buf[i];
+	}
+}
+
+#define string(str, siz) ((string_t){ (str), (siz) })
+#define cstring(cstr) ((string_t){ (cstr), strlen((cstr)) })
+#define cstring_cat(str, src) (string_cat(str, cstring(src)))
+
+/* DOIL - DatO Intermediate Language */
+typedef struct {
+	unsigned char siz; /* DOIL_BYTE..DOIL_QWORD */
+	unsigned char is_signed;
+} doil_type_t;
+
+/* constants are kept sign or zero extended to 64 bits from their type */
+typedef struct {
+	union {
+		unsigned int reg;
+		unsigned int var; /* id of the variable */
+		unsigned long long imm;
+	} val;
+	int is_reg;
+	int is_var;
+	int unused;
+	doil_type_t type; /* of a constant */
+} reg_or_const;
+
+#define doil_constant(i, t) ((reg_or_const){ .val.imm = (i), .type = (t) })
+#define doil_variable(v) ((reg_or_const){ .val.var = (v), .is_var = 1 })
+#define doil_unknown() ((reg_or_const){ .unused = 1 })
+
+typedef struct instruction {
+	enum {
+		DOIL_ADD,
+		DOIL_SUB,
+		DOIL_MUL,
+		DOIL_DIV,
+		DOIL_DEF,
+		DOIL_MOV,
+		DOIL_SET,
+		DOIL_GET,
+		DOIL_RET,
+		DOIL_CAST,
+		DOIL_SHL,
+		DOIL_SHR, /* arithmetic when the type is signed */
+		DOIL_MULH, /* high half of the 128 bits product */
+		DOIL_LOAD,
+		DOIL_STORE,
+		DOIL_CHECK,
+		DOIL_LENGTH,
+		DOIL_SLICE,
+		DOIL_VADD,
+		DOIL_VSUB,
+		DOIL_VMUL,
+		DOIL_VDIV,
+		DOIL_ARG,
+		DOIL_CALL,
+		DOIL_LT, /* 1 when lhs < rhs as values of the type, else 0 */
+		DOIL_LE,
+		DOIL_EQ,
+		DOIL_NE,
+		DOIL_LABEL,
+		DOIL_JMP,
+		DOIL_BR,
+		DOIL_PHI,
+	} type;
+	union {
+		struct {
+			reg_or_const lhs;
+			reg_or_const rhs;
+			unsigned int dst;
+			doil_type_t type; /* both sides are converted to it */
+		} ope; /*ope r0 r1 r2 = (r2 = r0 ? r1)*/
+		struct {
+			unsigned int var;
+			enum {
+				DOIL_BYTE,
+				DOIL_WORD,
+				DOIL_DWORD,
+				DOIL_QWORD,
+			} type;
+		} def; /*def x u8 = (var x: u8)*/
+		struct {
+			unsigned int reg;
+			reg_or_const val;
+		} mov; /*mov r0 10 = (r0 = 10)*/
+		struct {
+			reg_or_const dst;
+			reg_or_const src;
+		} set; /*set x 10 = (x = 10)*/
+		struct {
+			unsigned int var;
+			unsigned int reg;
+		} get; /*get x r0 = (r0 = x)*/
+		struct {
+			reg_or_const src;
+		} ret; /*ret 20 | ret*/
+		struct {
+			reg_or_const src;
+			unsigned int dst;
+			doil_type_t type;
+		} cast; /*cast r0 u1 r1 = (r1 = r0 wrapped around u1)*/
+		struct {
+			unsigned int var; /* array or slice */
+			reg_or_const idx;
+			reg_or_const src;
+			unsigned int dst;
+		} elem; /*load xs r0 r1 = (r1 = xs[r0]), store xs r0 r1 = (xs[r0] = r1)*/
+		struct {
+			unsigned int var;
+			reg_or_const idx;
+			reg_or_const len;
+		} check; /*check xs r0 10 = (trap unless r0 < 10, as unsigned)*/
+		struct {
+			unsigned int dst; /* slice */
+			unsigned int src; /* array */
+		} slice; /*slice s xs = (s = xs)*/
+		struct {
+			unsigned int dst; /* array */
+			reg_or_const lhs; /* an array of the same type and length, or a value for every element */
+			reg_or_const rhs;
+		} vec; /*vadd zs xs r0 = (zs[i] = xs[i] + r0 for every i)*/
+		struct {
+			unsigned int idx;
+			unsigned int dst;
+			doil_type_t type;
+		} arg; /*arg 0 r0 = (r0 = the first argument of the system)*/
+		struct {
+			unsigned int system; /* index in systems */
+			reg_or_const *args; /* already of the types of the parameters */
+			unsigned int args_count;
+			unsigned int dst; /* ID_NONE when the system doesn't return a value */
+			doil_type_t type;
+		} call; /*call foo(r0, 5) r1 = (r1 = foo(r0, 5))*/
+		struct {
+			unsigned int block;
+		} label; /*L0: = (the start of block 0)*/
+		struct {
+			reg_or_const cond;
+			unsigned int target[2]; /* blocks, the second one is only taken by br when cond is 0 */
+			unsigned int block; /* the one it ends */
+		} jmp; /*jmp L1 | br r0 L1 L2 = (to L1 when r0 isn't 0, else to L2)*/
+		struct {
+			reg_or_const *args; /* one per predecessor, in the order of the preds of the block */
+			unsigned int args_count;
+			unsigned int dst;
+			doil_type_t type;
+		} phi; /*phi [r0, r3] r4 = (r4 = r0 when coming from the first predecessor, r3 from the second)*/
+	};
+
+	unsigned char dead; /* only while optimizing */
+	unsigned char queued;
+	struct instruction *nxt;
+} instruction_t;
+const char *const instruction_type_str[] = {
+	"add",
+	"sub",
+	"mul",
+	"div",
+	"def",
+	"mov",
+	"set",
+	"get",
+	"ret",
+	"cast",
+	"shl",
+	"shr",
+	"mulh",
+	"load",
+	"store",
+	"check",
+	"len",
+	"slice",
+	"vadd",
+	"vsub",
+	"vmul",
+	"vdiv",
+	"arg",
+	"call",
+	"lt",
+	"le",
+	"eq",
+	"ne",
+	"label",
+	"jmp",
+	"br",
+	"phi",
+};
+const char *const doil_datatype_str[] = {
+	"byte",
+	"word",
+	"dword",
+	"qword",
+};
+
+/* wrap a value around the width of type, the way the target does */
+unsigned long long
+doil_wrap(unsigned long long val, doil_type_t type) {
+	unsigned int bits = 8 << type.siz;
+	if (bits == 64) return val;
+	val &= (1ull << bits) - 1;
+	if (type.is_signed && val >> (bits - 1)) val |= ~0ull << bits;
+	return val;
+}
+
+/* the largest value of type that is positive as well */
+unsigned long long
+doil_positive_max(doil_type_t type) {
+	unsigned int bits = (8 << type.siz) - type.is_signed;
+	return bits == 64 ? ~0ull : (1ull << bits) - 1;
+}
+
+/* the wider type wins, unsigned wins between types of the same width */
+doil_type_t
+doil_promote(doil_type_t lhs, doil_type_t rhs) {
+	if (lhs.siz != rhs.siz) return lhs.siz > rhs.siz ? lhs : rhs;
+	return (doil_type_t){ lhs.siz, lhs.is_signed && rhs.is_signed };
+}
+
+/* uses of an ssa register */
+typedef struct doil_use {
+	struct instruction *ins;
+	struct doil_use *nxt;
+} doil_use_t;
+
+typedef struct {
+	int used;
+	doil_type_t type; /* type of the value */
+	/* once in ssa form */
+	struct instruction *def;
+	doil_use_t *uses; /* can still hold dead instructions */
+	unsigned int uses_count; /* live uses */
+} reg_t;
+
+/*
+ * a basic block goes from its label to the jmp, br or ret that ends it, in the order of the
+ * instructions. block 0 is the entry.
+ */
+typedef struct {
+	instruction_t *head; /* the label */
+	instruction_t *tail;
+	unsigned int *preds; /* malloced */
+	unsigned int preds_count;
+	unsigned int preds_cap;
+	unsigned int succs[2];
+	unsigned int succs_count;
+} block_t;
+
+typedef struct {
+	reg_t *registers;
+	unsigned int registers_count;
+	unsigned int registers_cap;
+	block_t *blocks;
+	unsigned int blocks_count;
+	unsigned int blocks_cap;
+	unsigned int block; /* the one instructions are added to */
+	instruction_t *ins;
+	instruction_t *hins;
+	instruction_t *defs; /* the last def, they all go at the start of the logic */
+	unsigned int optimized; /* changes made by doil_optimize */
+	unsigned int optimize_passes;
+	unsigned int optimize_iterations; /* instructions taken from the worklist */
+	unsigned int system; /* index + 1 in systems, 0 for the logic */
+} doil_t;
+
+/* a system is lowered to a doil of its own, its parameters and local variables only live in registers */
+typedef struct {
+	unsigned int id; /* of its name, whose returntype is the one of the value it returns */
+	unsigned int *params; /* ids, in order */
+	unsigned int params_count;
+	int returns;
+	int is_extern; /* declared without a body, written in C */
+	doil_t doil;
+} system_t;
+
+static system_t *systems;
+static unsigned int systems_count;
+static unsigned int systems_cap;
+
+instruction_t *
+doil_make_instruction(doil_t *doil, unsigned int type) {
+	instruction_t *ins = arena_alloc(&doil_arena, sizeof(instruction_t));
+	*ins = (instruction_t){0};
+	ins->type = type;
+	if (doil->ins) doil->ins->nxt = ins;
+	doil->ins = ins;
+	if (!doil->hins) doil->hins = ins;
+	if (type == DOIL_JMP || type == DOIL_BR || type == DOIL_RET) doil->blocks[doil->block].tail = ins;
+	if (type == DOIL_JMP || type == DOIL_BR) ins->jmp.block = doil->block;
+	return ins;
+}
+
+#define doil_is_comparison(t) ((t) >= DOIL_LT && (t) <= DOIL_NE)
+#define doil_ends_block(ins) ((ins)->type == DOIL_JMP || (ins)->type == DOIL_BR || (ins)->type == DOIL_RET)
+
+static const doil_type_t doil_bool = { DOIL_BYTE, 0 };
+
+/* a comparison only used by the br right after it, which the back ends can branch on directly */
+int
+doil_is_fused(doil_t *doil, instruction_t *ins) {
+	return ins && doil_is_comparison(ins->type) && ins->nxt && ins->nxt->type == DOIL_BR && ins->nxt->jmp.cond.is_reg &&
+	       ins->nxt->jmp.cond.val.reg == ins->ope.dst && doil->registers[ins->ope.dst].uses_count == 1;
+}
+
+/* a block without instructions yet, doil_place_block starts it */
+unsigned int
+doil_new_block(doil_t *doil) {
+	if (doil->blocks_count >= doil->blocks_cap) {
+		doil->blocks_cap = doil->blocks_cap ? doil->blocks_cap * 2 : 8;
+		doil->blocks = realloc(doil->blocks, sizeof(block_t) * doil->blocks_cap);
+	}
+	doil->blocks[doil->blocks_count] = (block_t){0};
+	return doil->blocks_count++;
+}
+
+void
+doil_place_block(doil_t *doil, unsigned int block) {
+	instruction_t *ins = doil_make_instruction(doil, DOIL_LABEL);
+	ins->label.block = block;
+	doil->blocks[block].head = ins;
+	doil->block = block;
+}
+
+void
+doil_add_edge(doil_t *doil, unsigned int from, unsigned int to) {
+	block_t *b = &doil->blocks[to];
+	if (b->preds_count >= b->preds_cap) {
+		b->preds_cap = b->preds_cap ? b->preds_cap * 2 : 2;
+		b->preds = realloc(b->preds, sizeof(unsigned int) * b->preds_cap);
+	}
+	b->preds[b->preds_count++] = from;
+	doil->blocks[from].succs[doil->blocks[from].succs_count++] = to;
+}
+
+/* jmp to block */
+void
+doil_jump(doil_t *doil, unsigned int block) {
+	instruction_t *ins = doil_make_instruction(doil, DOIL_JMP);
+	ins->jmp.target[0] = block;
+	doil_add_edge(doil, doil->block, block);
+}
+
+/* br to then when cond isn't 0, else to otherwise */
+void
+doil_branch(doil_t *doil, reg_or_const cond, unsigned int then, unsigned int otherwise) {
+	instruction_t *ins = doil_make_instruction(doil, DOIL_BR);
+	ins->jmp.cond = cond;
+	ins->jmp.target[0] = then;
+	ins->jmp.target[1] = otherwise;
+	doil_add_edge(doil, doil->block, then);
+	doil_add_edge(doil, doil->block, otherwise);
+}
+
+/* the code after a jmp, br or ret is unreachable until a block that is jumped to starts */
+int
+doil_reachable(doil_t *doil) {
+	if (doil->ins && doil_ends_block(doil->ins)) return 0;
+	return doil->block == 0 || doil->blocks[doil->block].preds_count;
+}
+
+/* of the logic and of every system */
+unsigned int
+doil_instructions_count(doil_t *doil) {
+	unsigned int count = 0;
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) count++;
+	for (unsigned int i = 0; i < systems_count; i++) {
+		for (instruction_t *ins = systems[i].doil.hins; ins; ins = ins->nxt) count++;
+	}
+	return count;
+}
+
+unsigned int
+doil_get_register(doil_t *doil) {
+	for (unsigned int i = 0; i < doil->registers_count; i++) {
+		if (!doil->registers[i].used) {
+			doil->registers[i].used = 1;
+			return i;
+		}
+	}
+	if (doil->registers_cap <= doil->registers_count) {
+		doil->registers_cap = !doil->registers_cap ? 10 : doil->registers_cap * 2;
+		doil->registers = realloc(doil->registers, sizeof(reg_t) * doil->registers_cap);
+		for (unsigned int i = doil->registers_count; i < doil->registers_cap; i++) doil->registers[i].used = 0;
+	}
+	doil->registers[doil->registers_count].used = 1;
+	return doil->registers_count++;
+}
+
+void
+doil_clear_register(doil_t *doil, int register_index) {
+	doil->registers[register_index].used = 0;
+}
+
+/* so that the byte offset of every element fits a 32 bits displacement */
+#define DOIL_MAX_LENGTH (1u << 24)
+
+/* the type of a type token, lanes is 0 unless it is a vector */
+doil_type_t
+dato_type(token_t *type, unsigned int *lanes) {
+	/*TODO: add a struct for types like the identifiers, for now they are all hard coded*/
+	char *str = token_str(type);
+	unsigned int siz = type->siz;
+	doil_type_t t;
+	*lanes = 0;
+	/* vNtS is a vector of N lanes of the type tS, lexed only for the 16 and 32 bytes ones */
+	if (str[0] == 'v') {
+		for (str++, siz--; *str >= '0' && *str <= '9'; str++, siz--) *lanes = *lanes * 10 + *str - '0';
+	}
+	if (strncmp(str, "i1", max(siz, 2)) == 0 || strncmp(str, "u1", max(siz, 2)) == 0) {
+		t.siz = DOIL_BYTE;
+	} else if (strncmp(str, "i2", max(siz, 2)) == 0 || strncmp(str, "u2", max(siz, 2)) == 0) {
+		t.siz = DOIL_WORD;
+	} else if (strncmp(str, "i4", max(siz, 2)) == 0 || strncmp(str, "u4", max(siz, 2)) == 0) {
+		t.siz = DOIL_DWORD;
+	} else if (strncmp(str, "i8", max(siz, 2)) == 0 || strncmp(str, "u8", max(siz, 2)) == 0) {
+		t.siz = DOIL_QWORD;
+	} else {
+		fprintf(stderr, "ERROR: type '%.*s' not supported\n", type->siz, token_str(type));
+		exit(1);
+	}
+	t.is_signed = str[0] == 'i';
+	return t;
+}
+
+/* wherever the data segment is, the variables exist from the start */
+instruction_t *
+doil_define(doil_t *doil, unsigned int var, unsigned int type) {
+	instruction_t *ins = arena_alloc(&doil_arena, sizeof(instruction_t)), *at = doil->defs ? doil->defs : doil->blocks[0].head;
+	*ins = (instruction_t){ .type = DOIL_DEF, .nxt = at->nxt };
+	at->nxt = ins;
+	if (doil->ins == at) doil->ins = ins;
+	doil->defs = ins;
+	ins->def.var = var;
+	ins->def.type = type;
+	return ins;
+}
+
+void
+dato_variable_definition_to_doil(doil_t *doil, unsigned int def) {
+	token_t *type = ast_token(ast.child[def]),
+					*name = ast_token(ast.sibling[ast.child[def]]);
+	identifier_t *var = add_identifier(ID_VARIABLE, name->id);
+	unsigned int lanes;
+	doil_type_t t = dato_type(type, &lanes);
+	doil_define(doil, name->id, t.siz);
+	var->datatype = t.siz;
+	var->is_signed = t.is_signed;
+	var->length = lanes;
+	var->is_vector = lanes != 0;
+
+	unsigned int len = ast.sibling[ast.sibling[ast.child[def]]];
+	if (len && var->is_vector) {
+		fprintf(stderr, "ERROR: '%.*s' can't be an array of vectors\n", name->siz, token_str(name));
+		exit(1);
+	} else if (len && ast.type[len] == AST_SLICE) {
+		var->is_slice = 1;
+	} else if (len) {
+		unsigned long long n = token_integer(ast_token(len));
+		if (n == 0 || n > DOIL_MAX_LENGTH) {
+			fprintf(stderr, "ERROR: the length of '%.*s' should be between 1 and %u\n", name->siz, token_str(name), DOIL_MAX_LENGTH);
+			exit(1);
+		}
+		var->length = n;
+	}
+}
+
+doil_type_t
+doil_variable_type(identifier_t *var) {
+	return (doil_type_t){ var->datatype, var->is_signed };
+}
+
+/* integer literals are i8, or u8 when they don't fit */
+reg_or_const
+dato_integer_to_doil(unsigned int node) {
+	unsigned long long val = token_integer(ast_token(node));
+	return doil_constant(val, ((doil_type_t){ DOIL_QWORD, val >> 63 == 0 }));
+}
+
+/* src as a value of type, through a cast doil_optimize drops when it already is one */
+reg_or_const
+dato_convert(doil_t *doil, reg_or_const src, doil_type_t type) {
+	if (!src.is_reg) return doil_constant(doil_wrap(src.val.imm, type), type);
+	instruction_t *ins = doil_make_instruction(doil, DOIL_CAST);
+	ins->cast.src = src;
+	ins->cast.type = type;
+	ins->cast.dst = doil_get_register(doil);
+	doil->registers[ins->cast.dst].type = type;
+	doil_clear_register(doil, src.val.reg);
+	return (reg_or_const){ .val.reg = ins->cast.dst, .is_reg = 1 };
+}
+
+unsigned int dato_assignment_to_doil(doil_t *doil, unsigned int asg, int return_register);
+unsigned int dato_expression_to_doil(doil_t *doil, unsigned int exp);
+unsigned int dato_call_to_doil(doil_t *doil, unsigned int call);
+
+identifier_t *
+dato_array(token_t *name) {
+	identifier_t *var = get_identifier(ID_VARIABLE, name->id);
+	if (!var || (!var->length && !var->is_slice)) {
+		fprintf(stderr, "ERROR: '%.*s' is not an array or a slice\n", name->siz, token_str(name));
+		exit(1);
+	}
+	return var;
+}
+
+/* the index of name[index], after the bounds check doil_optimize removes when it can */
+reg_or_const
+dato_index_to_doil(doil_t *doil, unsigned int exp) {
+	token_t *name = ast_token(exp);
+	identifier_t *var = dato_array(name);
+	unsigned int index = ast.child[exp];
+	reg_or_const idx = {0}, len = {0};
+	if (ast.type[index] == AST_INTEGER) {
+		idx = dato_integer_to_doil(index);
+	} else {
+		idx.val.reg = dato_expression_to_doil(doil, index);
+		idx.is_reg = 1;
+	}
+	instruction_t *ins;
+	if (var->is_slice) {
+		var->use_amount++;
+		ins = doil_make_instruction(doil, DOIL_LENGTH);
+		ins->get.var = name->id;
+		ins->get.reg = doil_get_register(doil);
+		doil->registers[ins->get.reg].type = (doil_type_t){ DOIL_QWORD, 0 };
+		len.val.reg = ins->get.reg;
+		len.is_reg = 1;
+		doil_clear_register(doil, len.val.reg);
+	} else {
+		len = doil_constant(var->length, ((doil_type_t){ DOIL_QWORD, 0 }));
+	}
+	ins = doil_make_instruction(doil, DOIL_CHECK);
+	ins->check.var = name->id;
+	ins->check.idx = idx;
+	ins->check.len = len;
+	return idx;
+}
+
+unsigned int
+dato_expression_operator_to_doil(doil_t *doil, unsigned int exp, unsigned int operator) {
+	unsigned int lhs = ast.child[exp];
+	unsigned int rhs = ast.sibling[ast.child[exp]];
+	
+	unsigned int lhs_register, rhs_register;
+
+	int lhs_is_reg = ast.type[lhs] != AST_INTEGER;
+	if (lhs_is_reg) lhs_register = dato_expression_to_doil(doil, lhs);
+
+	int rhs_is_reg = ast.type[rhs] != AST_INTEGER;
+	if (rhs_is_reg) rhs_register = dato_expression_to_doil(doil, rhs);
+
+	instruction_t *ins = doil_make_instruction(doil, operator);
+	doil_type_t lhs_type, rhs_type;
+	if (lhs_is_reg) {
+		ins->ope.lhs.is_reg = 1;
+		ins->ope.lhs.val.reg = lhs_register;
+		ins->ope.dst = lhs_register;
+		lhs_type = doil->registers[lhs_register].type;
+	} else {
+		ins->ope.lhs = dato_integer_to_doil(lhs);
+		ins->ope.dst = doil_get_register(doil);
+		lhs_type = ins->ope.lhs.type;
+	}
+
+	if (rhs_is_reg) {
+		ins->ope.rhs.is_reg = 1;
+		ins->ope.rhs.val.reg = rhs_register;
+		rhs_type = doil->registers[rhs_register].type;
+		doil_clear_register(doil, rhs_register);
+	} else {
+		ins->ope.rhs = dato_integer_to_doil(rhs);
+		rhs_type = ins->ope.rhs.type;
+	}
+	ins->ope.type = doil_promote(lhs_type, rhs_type);
+	doil->registers[ins->ope.dst].type = ins->ope.type;
+	if (doil_is_comparison(operator)) {
+		/* a > b is b < a, once both sides are computed in order */
+		if (ast.type[exp] == AST_GT || ast.type[exp] == AST_GE) {
+			reg_or_const tmp = ins->ope.lhs;
+			ins->ope.lhs = ins->ope.rhs;
+			ins->ope.rhs = tmp;
+		}
+		doil->registers[ins->ope.dst].type = doil_bool;
+	}
+
+	return ins->ope.dst;
+}
+
+unsigned int
+dato_expression_to_doil(doil_t *doil, unsigned int exp) {
+	unsigned int register_index;
+
+	instruction_t *ins;
+	identifier_t *var;
+	reg_or_const idx;
+
+	switch (ast.type[exp]) {
+		case AST_ADD:
+			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_ADD);
+			break;
+		case AST_SUB:
+			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_SUB);
+			break;
+		case AST_MUL:
+			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_MUL);
+			break;
+		case AST_DIV:
+			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_DIV);
+			break;
+		case AST_LT:
+		case AST_GT:
+			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_LT);
+			break;
+		case AST_LE:
+		case AST_GE:
+			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_LE);
+			break;
+		case AST_EQ:
+			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_EQ);
+			break;
+		case AST_NE:
+			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_NE);
+			break;
+		case AST_ASSIGN:
+			register_index = dato_assignment_to_doil(doil, exp, 1);
+			break;
+		case AST_IDENTIFIER:
+			var = get_identifier(ID_VARIABLE, ast_token(exp)->id);
+			if (!var) {
+				fprintf(stderr, "ERROR: '%.*s' is not a variable\n", ast_token(exp)->siz, token_str(ast_token(exp)));
+				exit(1);
+			}
+			if (var->length || var->is_slice) {
+				fprintf(stderr, "ERROR: '%.*s' can only be used through its elements\n", var->siz, var->str);
+				exit(1);
+			}
+			var->use_amount++;
+			ins = doil_make_instruction(doil, DOIL_GET);
+			ins->get.var = ast_token(exp)->id;
+			ins->get.reg = doil_get_register(doil);
+			register_index = ins->get.reg;
+			doil->registers[register_index].type = doil_variable_type(var);
+			break;
+		case AST_INDEX:
+			idx = dato_index_to_doil(doil, exp);
+			var = dato_array(ast_token(exp));
+			var->use_amount++;
+			ins = doil_make_instruction(doil, DOIL_LOAD);
+			ins->elem.var = ast_token(exp)->id;
+			ins->elem.idx = idx;
+			ins->elem.dst = doil_get_register(doil);
+			if (idx.is_reg) doil_clear_register(doil, idx.val.reg);
+			register_index = ins->elem.dst;
+			doil->registers[register_index].type = doil_variable_type(var);
+			break;
+		case AST_CALL:
+			register_index = dato_call_to_doil(doil, exp);
+			if (register_index == ID_NONE) {
+				fprintf(stderr, "ERROR: '%.*s' doesn't return a value\n", ast_token(exp)->siz, token_str(ast_token(exp)));
+				exit(1);
+			}
+			break;
+		case AST_INTEGER:
+			ins = doil_make_instruction(doil, DOIL_MOV);
+			ins->mov.reg = doil_get_register(doil);
+			ins->mov.val = dato_integer_to_doil(exp);
+			register_index = ins->mov.reg;
+			doil->registers[register_index].type = ins->mov.val.type;
+			break;
+		default:
+			fprintf(stderr, "ERROR: '%s' is not a valid expression\n", ast_type_str[ast.type[exp]]);
+			exit(1);
+	}
+	return register_index;
+}
+
+/* 1 when the expression reads a whole array, and is computed for every element */
+int
+dato_is_elementwise(unsigned int exp) {
+	switch (ast.type[exp]) {
+		case AST_ADD:
+		case AST_SUB:
+		case AST_MUL:
+		case AST_DIV:
+			return dato_is_elementwise(ast.child[exp]) || dato_is_elementwise(ast.sibling[ast.child[exp]]);
+		case AST_IDENTIFIER: {
+			identifier_t *var = get_identifier(ID_VARIABLE, ast_token(exp)->id);
+			return var && var->length;
+		}
+		default:
+			return 0;
+	}
+}
+
+int
+dato_reads(unsigned int exp, unsigned int id) {
+	if (ast_token(exp) && ast_token(exp)->type == TKN_IDENTIFIER && ast_token(exp)->id == id) return 1;
+	for (unsigned int child = ast.child[exp]; child; child = ast.sibling[child]) {
+		if (dato_reads(child, id)) return 1;
+	}
+	return 0;
+}
+
+#define dato_is_operator(exp) (ast.type[exp] == AST_ADD || ast.type[exp] == AST_SUB || ast.type[exp] == AST_MUL || ast.type[exp] == AST_DIV)
+
+/* the temporary arrays of element-wise expressions, doil_lex defines them in the logic */
+static unsigned int *temps;
+static unsigned int temps_count;
+static unsigned int temps_cap;
+
+/* the k-th temporary array of the element type and length of array, named so no variable can have its name */
+unsigned int
+dato_temporary(unsigned int array, unsigned int k) {
+	identifier_t var = ids[array];
+	char name[64];
+	int siz;
+	if (var.is_vector) siz = snprintf(name, sizeof(name), "tmp.v%u%c%u.%u", var.length, var.is_signed ? 'i' : 'u', 1u << var.datatype, k);
+	else               siz = snprintf(name, sizeof(name), "tmp.%c%u.%u.%u", var.is_signed ? 'i' : 'u', 1u << var.datatype, var.length, k);
+	unsigned int id = ids_find(name, siz, hash(name, siz));
+	if (id != ID_NONE) return id;
+	char *str = arena_alloc(&doil_arena, siz);
+	memcpy(str, name, siz);
+	id = intern(str, siz);
+	ids[id].type = ID_VARIABLE;
+	ids[id].datatype = var.datatype;
+	ids[id].is_signed = var.is_signed;
+	ids[id].length = var.length;
+	ids[id].is_vector = var.is_vector;
+	if (temps_count >= temps_cap) {
+		temps_cap = temps_cap ? temps_cap * 2 : 8;
+		temps = realloc(temps, sizeof(unsigned int) * temps_cap);
+	}
+	temps[temps_count++] = id;
+	return id;
+}
+
+/*
+ * array = element-wise expression, every operator writes its result to dst, which is the array for
+ * the last one. the side of an operator computed first goes to dst as well, unless the other side
+ * reads dst or is computed too, then it gets a temporary array. temps_used of them are in use.
+ * the parts that don't read an array are computed once and used for every element.
+ */
+reg_or_const
+dato_elementwise_to_doil(doil_t *doil, unsigned int array, unsigned int dst, unsigned int exp, unsigned int *temps_used) {
+	reg_or_const op = {0};
+	if (!dato_is_elementwise(exp)) {
+		if (ast.type[exp] == AST_INTEGER) return dato_integer_to_doil(exp);
+		op.val.reg = dato_expression_to_doil(doil, exp);
+		op.is_reg = 1;
+		return op;
+	}
+	if (ast.type[exp] == AST_IDENTIFIER) {
+		identifier_t *var = get_identifier(ID_VARIABLE, ast_token(exp)->id), *arr = &ids[array];
+		if (var->datatype != arr->datatype || var->is_signed != arr->is_signed || var->length != arr->length) {
+			fprintf(stderr, "ERROR: '%.*s' and '%.*s' don't have the same element type and length\n", arr->siz, arr->str, var->siz, var->str);
+			exit(1);
+		}
+		var->use_amount++;
+		return doil_variable(ast_token(exp)->id);
+	}
+	unsigned int lhs_exp = ast.child[exp], rhs_exp = ast.sibling[ast.child[exp]];
+	int lhs_computed = dato_is_operator(lhs_exp) && dato_is_elementwise(lhs_exp);
+	int rhs_computed = dato_is_operator(rhs_exp) && dato_is_elementwise(rhs_exp);
+	unsigned int first = rhs_computed && !lhs_computed ? rhs_exp : lhs_exp, second = first == lhs_exp ? rhs_exp : lhs_exp;
+	unsigned int used = *temps_used, first_dst = dst;
+	if ((first == lhs_exp && rhs_computed) || dato_reads(second, dst)) {
+		first_dst = dato_temporary(array, (*temps_used)++);
+		ids[first_dst].set_amount++;
+		ids[first_dst].use_amount++;
+	}
+	reg_or_const first_op = dato_elementwise_to_doil(doil, array, first_dst, first, temps_used);
+	reg_or_const second_op = dato_elementwise_to_doil(doil, array, dst, second, temps_used);
+	*temps_used = used;
+	static const unsigned int vector_ops[] = { [AST_ADD] = DOIL_VADD, [AST_SUB] = DOIL_VSUB, [AST_MUL] = DOIL_VMUL, [AST_DIV] = DOIL_VDIV };
+	instruction_t *ins = doil_make_instruction(doil, vector_ops[ast.type[exp]]);
+	ins->vec.dst = dst;
+	ins->vec.lhs = first == lhs_exp ? first_op : second_op;
+	ins->vec.rhs = first == lhs_exp ? second_op : first_op;
+	if (first_op.is_reg) doil_clear_register(doil, first_op.val.reg);
+	if (second_op.is_reg) doil_clear_register(doil, second_op.val.reg);
+	return doil_variable(dst);
+}
+
+/* slice = array */
+unsigned int
+dato_slice_to_doil(doil_t *doil, identifier_t *slice, token_t *name, unsigned int val) {
+	identifier_t *array = ast.type[val] == AST_IDENTIFIER ? get_identifier(ID_VARIABLE, ast_token(val)->id) : NULL;
+	if (!array || !array->length) {
+		fprintf(stderr, "ERROR: the slice '%.*s' can only be assigned an array\n", name->siz, token_str(name));
+		exit(1);
+	}
+	if (array->datatype != slice->datatype || array->is_signed != slice->is_signed) {
+		fprintf(stderr, "ERROR: '%.*s' and '%.*s' don't have the same element type\n", name->siz, token_str(name), array->siz, array->str);
+		exit(1);
+	}
+	slice->set_amount++;
+	array->use_amount++;
+	array->is_sliced = 1;
+	instruction_t *ins = doil_make_instruction(doil, DOIL_SLICE);
+	ins->slice.dst = name->id;
+	ins->slice.src = ast_token(val)->id;
+	return 0;
+}
+
+unsigned int
+dato_assignment_to_doil(doil_t *doil, unsigned int asg, int return_register) {
+	unsigned int id  = ast.child[asg];
+	unsigned int val = ast.sibling[ast.child[asg]];
+
+	identifier_t *var = NULL;
+	reg_or_const dst = {0}, src = {0}, idx = {0};
+	if (ast.type[id] == AST_IDENTIFIER) {
+		var = get_identifier(ID_VARIABLE, ast_token(id)->id);
+		if (!var) {
+			fprintf(stderr, "ERROR: trying to assign to '%.*s', but '%.*s' isn't a variable\n", ast_token(id)->siz, token_str(ast_token(id)),ast_token(id)->siz, token_str(ast_token(id)));
+			exit(1);
+		}
+		if (var->is_slice && !return_register) return dato_slice_to_doil(doil, var, ast_token(id), val);
+		if (var->is_slice) {
+			fprintf(stderr, "ERROR: the assignment of the slice '%.*s' isn't a value\n", var->siz, var->str);
+			exit(1);
+		}
+		if (var->length && (return_register || !dato_is_operator(val) || !dato_is_elementwise(val))) {
+			fprintf(stderr, "ERROR: the whole array '%.*s' can only be assigned an element-wise expression\n", var->siz, var->str);
+			exit(1);
+		}
+		if (var->length) {
+			unsigned int temps_used = 0;
+			var->set_amount++;
+			dato_elementwise_to_doil(doil, ast_token(id)->id, ast_token(id)->id, val, &temps_used);
+			return 0;
+		}
+		var->set_amount++;
+		dst = doil_variable(ast_token(id)->id);
+	} else if (ast.type[id] == AST_INDEX) {
+		var = dato_array(ast_token(id));
+		var->set_amount++;
+		idx = dato_index_to_doil(doil, id);
+	} else {
+		dst.val.reg = dato_expression_to_doil(doil, id);
+		dst.is_reg = 1;
+		doil_clear_register(doil, dst.val.reg);
+	}
+
+	if (ast.type[val] == AST_INTEGER) {
+		src = dato_integer_to_doil(val);
+	} else {
+		src.val.reg = dato_expression_to_doil(doil, val);
+		src.is_reg = 1;
+		if (!return_register) doil_clear_register(doil, src.val.reg);
+	}
+	instruction_t *ins;
+	if (ast.type[id] == AST_INDEX) {
+		ins = doil_make_instruction(doil, DOIL_STORE);
+		ins->elem.var = ast_token(id)->id;
+		ins->elem.idx = idx;
+		ins->elem.src = src;
+		if (idx.is_reg) doil_clear_register(doil, idx.val.reg);
+		return src.val.reg;
+	}
+	ins = doil_make_instruction(doil, DOIL_SET);
+	ins->set.dst = dst;
+	ins->set.src = src;
+
+	return src.val.reg;
+}
+
+void
+dato_return_to_doil(doil_t *doil, unsigned int ret) {
+	unsigned int val = ast.child[ret];
+	system_t *sys = doil->system ? &systems[doil->system - 1] : NULL;
+	instruction_t *ins;
+
+	if (sys && sys->returns != (val != 0)) {
+		identifier_t *id = &ids[sys->id];
+		fprintf(stderr, "ERROR: '%.*s' %s\n", id->siz, id->str, sys->returns ? "has to return a value" : "doesn't return a value");
+		exit(1);
+	}
+	if (!val) {
+		ins = doil_make_instruction(doil, DOIL_RET);
+		ins->ret.src.unused = 1;
+		return;
+	}
+
+	reg_or_const src = {0};
+	if (ast.type[val] == AST_INTEGER) {
+		src = dato_integer_to_doil(val);
+	} else {
+		src.val.reg = dato_expression_to_doil(doil, val);
+		src.is_reg = 1;
+	}
+	/* the exit code of the logic is whatever is left in the low byte */
+	if (sys) src = dato_convert(doil, src, doil_variable_type(&ids[sys->id]));
+	if (src.is_reg) doil_clear_register(doil, src.val.reg);
+	ins = doil_make_instruction(doil, DOIL_RET);;
+	ins->ret.src = src;
+}
+
+/* name(arguments), returns the register of the value it returns or ID_NONE */
+unsigned int
+dato_call_to_doil(doil_t *doil, unsigned int call) {
+	token_t *name = ast_token(call);
+	identifier_t *id = get_identifier(ID_SYSTEM, name->id);
+	if (!id && doil->system && systems[doil->system - 1].id == name->id) {
+		fprintf(stderr, "ERROR: '%.*s' can't call itself\n", name->siz, token_str(name));
+		exit(1);
+	} else if (!id) {
+		fprintf(stderr, "ERROR: '%.*s' is not a system, systems have to be defined before they are called\n", name->siz, token_str(name));
+		exit(1);
+	}
+	system_t *sys = &systems[id->system - 1];
+	unsigned int count = 0, i = 0;
+	for (unsigned int arg = ast.child[call]; arg; arg = ast.sibling[arg]) count++;
+	if (count != sys->params_count) {
+		fprintf(stderr, "ERROR: '%.*s' takes %u arguments, not %u\n", name->siz, token_str(name), sys->params_count, count);
+		exit(1);
+	}
+	/* the registers of the arguments are only free once the call is made */
+	reg_or_const *args = arena_alloc(&doil_arena, sizeof(reg_or_const) * (count + 1));
+	for (unsigned int arg = ast.child[call]; arg; arg = ast.sibling[arg], i++) {
+		args[i] = (reg_or_const){0};
+		if (ast.type[arg] == AST_INTEGER) {
+			args[i] = dato_integer_to_doil(arg);
+		} else {
+			args[i].val.reg = dato_expression_to_doil(doil, arg);
+			args[i].is_reg = 1;
+		}
+		args[i] = dato_convert(doil, args[i], doil_variable_type(&ids[sys->params[i]]));
+	}
+	instruction_t *ins = doil_make_instruction(doil, DOIL_CALL);
+	ins->call.system = id->system - 1;
+	ins->call.args = args;
+	ins->call.args_count = count;
+	ins->call.dst = ID_NONE;
+	for (i = 0; i < count; i++) {
+		if (args[i].is_reg) doil_clear_register(doil, args[i].val.reg);
+	}
+	if (sys->returns) {
+		ins->call.type = doil_variable_type(id);
+		ins->call.dst = doil_get_register(doil);
+		doil->registers[ins->call.dst].type = ins->call.type;
+	}
+	return ins->call.dst;
+}
+
+void dato_statement_to_doil(doil_t *doil, unsigned int branch);
+
+/* the condition of an if or a while, which is true when it isn't 0 */
+reg_or_const
+dato_condition_to_doil(doil_t *doil, unsigned int cond) {
+	if (ast.type[cond] == AST_INTEGER) return dato_integer_to_doil(cond);
+	reg_or_const reg = { .val.reg = dato_expression_to_doil(doil, cond), .is_reg = 1 };
+	doil_clear_register(doil, reg.val.reg);
+	return reg;
+}
+
+void
+dato_block_to_doil(doil_t *doil, unsigned int block, unsigned int next) {
+	for (unsigned int stt = ast.child[block]; stt; stt = ast.sibling[stt]) dato_statement_to_doil(doil, stt);
+	if (!doil_ends_block(doil->ins)) doil_jump(doil, next);
+}
+
+/* br to the statements of the if, or to the ones of 'else', and both jmp past them */
+void
+dato_if_to_doil(doil_t *doil, unsigned int node) {
+	unsigned int cond = ast.child[node], then = ast.sibling[cond], otherwise = ast.sibling[then];
+	unsigned int then_block = doil_new_block(doil), else_block = otherwise ? doil_new_block(doil) : 0, end_block = doil_new_block(doil);
+	doil_branch(doil, dato_condition_to_doil(doil, cond), then_block, otherwise ? else_block : end_block);
+	doil_place_block(doil, then_block);
+	dato_block_to_doil(doil, then, end_block);
+	if (otherwise) {
+		doil_place_block(doil, else_block);
+		dato_block_to_doil(doil, otherwise, end_block);
+	}
+	doil_place_block(doil, end_block);
+}
+
+/* the condition has a block of its own, the loop jumps back to it */
+void
+dato_while_to_doil(doil_t *doil, unsigned int node) {
+	unsigned int cond = ast.child[node], body = ast.sibling[cond];
+	unsigned int cond_block = doil_new_block(doil), body_block = doil_new_block(doil), end_block = doil_new_block(doil);
+	doil_jump(doil, cond_block);
+	doil_place_block(doil, cond_block);
+	doil_branch(doil, dato_condition_to_doil(doil, cond), body_block, end_block);
+	doil_place_block(doil, body_block);
+	dato_block_to_doil(doil, body, cond_block);
+	doil_place_block(doil, end_block);
+}
+
+void
+dato_statement_to_doil(doil_t *doil, unsigned int branch) {
+	unsigned int reg;
+	if (doil_ends_block(doil->ins) && ast.type[branch] != AST_VARDEF) {
+		fprintf(stderr, "WARNING: statement after 'ret' is unreachable\n");
+		doil_place_block(doil, doil_new_block(doil));
+	}
+	switch (ast.type[branch]) {
+		case AST_ADD:
+		case AST_SUB:
+		case AST_MUL:
+		case AST_DIV:
+		case AST_LT:
+		case AST_GT:
+		case AST_LE:
+		case AST_GE:
+		case AST_EQ:
+		case AST_NE:
+		case AST_IDENTIFIER:
+		case AST_INTEGER:
+			fprintf(stderr, "WARNING: statement with no effect\n");
+			break;
+		case AST_VARDEF: 
+			/* the ones of a system were made into locals by dato_system_to_doil */
+			if (!doil->system) dato_variable_definition_to_doil(doil, branch);
+			break;
+		case AST_ASSIGN: 
+			dato_assignment_to_doil(doil, branch, 0);
+			break;
+		case AST_RETURN: 
+			dato_return_to_doil(doil, branch);
+			break;
+		case AST_CALL:
+			reg = dato_call_to_doil(doil, branch);
+			if (reg != ID_NONE) doil_clear_register(doil, reg);
+			break;
+		case AST_IF:
+			dato_if_to_doil(doil, branch);
+			break;
+		case AST_WHILE:
+			dato_while_to_doil(doil, branch);
+			break;
+		default:
+			fprintf(stderr, "ERROR: '%s' is not a valid operation\n", ast_type_str[ast.type[branch]]);
+			exit(1);
+	}
+}
+
+/* what fits in the registers of both calling conventions */
+#define DOIL_MAX_PARAMS 6
+
+/* a parameter or local variable of a system, a new identifier with the name of the token */
+unsigned int
+dato_local(system_t *sys, unsigned int *rename, token_t *type, token_t *name) {
+	identifier_t *owner = &ids[sys->id];
+	unsigned int lanes;
+	doil_type_t t = dato_type(type, &lanes);
+	if (rename[name->id] != ID_NONE) {
+		fprintf(stderr, "ERROR: '%.*s' is defined twice in '%.*s'\n", name->siz, token_str(name), owner->siz, owner->str);
+		exit(1);
+	}
+	if (lanes) {
+		fprintf(stderr, "ERROR: '%.*s' in '%.*s' can't be a vector, only the data of the logic can\n", name->siz, token_str(name), owner->siz, owner->str);
+		exit(1);
+	}
+	if (ids_count >= ids_cap) {
+		ids_cap *= 2;
+		ids = realloc(ids, sizeof(identifier_t) * ids_cap);
+	}
+	/* it isn't in ids_table, the names only lead to it through rename */
+	unsigned int id = ids_count++;
+	ids[id] = (identifier_t){ .type = ID_VARIABLE, .str = ids[name->id].str, .siz = ids[name->id].siz, .hash = ids[name->id].hash,
+	                          .datatype = t.siz, .is_signed = t.is_signed, .system = sys - systems + 1 };
+	rename[name->id] = id;
+	return id;
+}
+
+void
+dato_rename(unsigned int node, unsigned int *rename) {
+	for (; node; node = ast.sibling[node]) {
+		token_t *tkn = ast_token(node);
+		if (tkn && tkn->type == TKN_IDENTIFIER && rename[tkn->id] != ID_NONE) tkn->id = rename[tkn->id];
+		dato_rename(ast.child[node], rename);
+	}
+}
+
+/*
+ * a system gets a doil of its own, which starts by taking its arguments. its parameters and local
+ * variables are new identifiers, the names in its body are changed to them before it is lowered,
+ * so they hide the variables of the data segments with the same name.
+ */
+void
+dato_system_to_doil(unsigned int node) {
+	token_t *name = ast_token(node);
+	if (get_identifier(ID_ANY, name->id)) {
+		fprintf(stderr, "ERROR: '%.*s' is already defined as %s\n", name->siz, token_str(name), identifier_type_str[ids[name->id].type]);
+		exit(1);
+	}
+	if (systems_count >= systems_cap) {
+		systems_cap = systems_cap ? systems_cap * 2 : 8;
+		systems = realloc(systems, sizeof(system_t) * systems_cap);
+	}
+	system_t *sys = &systems[systems_count++];
+	*sys = (system_t){ .id = name->id, .is_extern = ast.type[node] == AST_EXTERN };
+	sys->doil.system = systems_count;
+
+	unsigned int child = ast.child[node], count = 0, lanes;
+	if (child && ast.type[child] == AST_TYPE) {
+		doil_type_t type = dato_type(ast_token(child), &lanes);
+		if (lanes) {
+			fprintf(stderr, "ERROR: '%.*s' can't return a vector\n", name->siz, token_str(name));
+			exit(1);
+		}
+		sys->returns = 1;
+		ids[name->id].returntype = type.siz;
+		ids[name->id].is_signed = type.is_signed;
+		child = ast.sibling[child];
+	}
+	for (unsigned int param = child; param && ast.type[param] == AST_PARAM; param = ast.sibling[param]) count++;
+	if (count > DOIL_MAX_PARAMS) {
+		fprintf(stderr, "ERROR: '%.*s' has more than %u parameters\n", name->siz, token_str(name), DOIL_MAX_PARAMS);
+		exit(1);
+	}
+	unsigned int *rename = malloc(sizeof(unsigned int) * (ids_count + 1));
+	for (unsigned int i = 0; i < ids_count; i++) rename[i] = ID_NONE;
+	sys->params = arena_alloc(&doil_arena, sizeof(unsigned int) * (count + 1));
+	for (; child && ast.type[child] == AST_PARAM; child = ast.sibling[child]) {
+		sys->params[sys->params_count++] = dato_local(sys, rename, ast_token(ast.child[child]), ast_token(ast.sibling[ast.child[child]]));
+	}
+	for (unsigned int def = child; def; def = ast.sibling[def]) {
+		if (ast.type[def] != AST_VARDEF) continue;
+		token_t *local = ast_token(ast.sibling[ast.child[def]]);
+		if (ast.sibling[ast.sibling[ast.child[def]]]) {
+			fprintf(stderr, "ERROR: '%.*s' in '%.*s' can't be an array or a slice, only the data of the logic can\n", local->siz, token_str(local), name->siz, token_str(name));
+			exit(1);
+		}
+		dato_local(sys, rename, ast_token(ast.child[def]), local);
+	}
+	dato_rename(child, rename);
+	free(rename);
+
+	doil_t *doil = &sys->doil;
+	if (!sys->is_extern) doil_place_block(doil, doil_new_block(doil));
+	for (unsigned int i = 0; !sys->is_extern && i < sys->params_count; i++) {
+		identifier_t *param = &ids[sys->params[i]];
+		instruction_t *ins = doil_make_instruction(doil, DOIL_ARG);
+		ins->arg.idx = i;
+		ins->arg.type = doil_variable_type(param);
+		ins->arg.dst = doil_get_register(doil);
+		doil->registers[ins->arg.dst].type = ins->arg.type;
+		reg_or_const src = { .val.reg = ins->arg.dst, .is_reg = 1 };
+		param->set_amount++;
+		ins = doil_make_instruction(doil, DOIL_SET);
+		ins->set.dst = doil_variable(sys->params[i]);
+		ins->set.src = src;
+		doil_clear_register(doil, src.val.reg);
+	}
+	for (; child; child = ast.sibling[child]) dato_statement_to_doil(doil, child);
+	if (!sys->is_extern && !doil_ends_block(doil->ins)) {
+		if (sys->returns && doil_reachable(doil)) {
+			fprintf(stderr, "ERROR: '%.*s' has to end with 'ret'\n", name->siz, token_str(name));
+			exit(1);
+		}
+		/* what can't be reached is dropped before it matters which value it returns */
+		doil_make_instruction(doil, DOIL_RET)->ret.src.unused = 1;
+	}
+	add_identifier(ID_SYSTEM, name->id)->system = systems_count;
+}
+
+doil_t
+doil_lex(unsigned int root) {
+	doil_t doil = {0};
+	doil_place_block(&doil, doil_new_block(&doil));
+	for (unsigned int branch = ast.child[root]; branch; branch = ast.sibling[branch]) {
+		if (ast.type[branch] == AST_SYSTEM || ast.type[branch] == AST_EXTERN) dato_system_to_doil(branch);
+		else                                                                   dato_statement_to_doil(&doil, branch);
+	}
+	/* falling off the end of the logic exits with 0 */
+	if (!doil_ends_block(doil.ins)) doil_make_instruction(&doil, DOIL_RET)->ret.src.unused = 1;
+	for (unsigned int i = 0; i < temps_count; i++) doil_define(&doil, temps[i], ids[temps[i]].datatype);
+	free(temps);
+	layout_resolve();
+	free_ast();
+	return doil;
+}
+
+void
+print_doil_constant(reg_or_const cst) {
+	if (cst.type.is_signed) printf("%lld", (long long)cst.val.imm);
+	else                    printf("%llu", cst.val.imm);
+}
+
+void
+print_doil_operand(reg_or_const op) {
+	if (op.is_reg)      printf("r%u", op.val.reg);
+	else if (op.is_var) printf("%.*s", ids[op.val.var].siz, ids[op.val.var].str);
+	else                print_doil_constant(op);
+}
+
+void
+print_doil(doil_t doil) {
+	doil.ins = doil.hins;
+	while (doil.ins) {
+		switch (doil.ins->type) {
+			case DOIL_ADD:
+			case DOIL_SUB:
+			case DOIL_MUL:
+			case DOIL_DIV:
+			case DOIL_SHL:
+			case DOIL_SHR:
+			case DOIL_MULH:
+			case DOIL_LT:
+			case DOIL_LE:
+			case DOIL_EQ:
+			case DOIL_NE:
+				printf("%s ", instruction_type_str[doil.ins->type]);
+				if (doil.ins->ope.lhs.is_reg) {
+					printf("r%u ", doil.ins->ope.lhs.val.reg);
+				} else {
+					print_doil_constant(doil.ins->ope.lhs);
+					putchar(' ');
+				}
+				if (doil.ins->ope.rhs.is_reg) {
+					printf("r%u ", doil.ins->ope.rhs.val.reg);
+				} else {
+					print_doil_constant(doil.ins->ope.rhs);
+					putchar(' ');
+				}
+				printf("r%u\n", doil.ins->ope.dst);
+				break;
+			case DOIL_DEF:
+				printf("def %.*s %s", ids[doil.ins->def.var].siz, ids[doil.ins->def.var].str, doil_datatype_str[doil.ins->def.type]);
+				if (ids[doil.ins->def.var].is_slice) printf("[]");
+				else if (ids[doil.ins->def.var].is_vector) printf("<%u>", ids[doil.ins->def.var].length);
+				else if (ids[doil.ins->def.var].length) printf("[%u]", ids[doil.ins->def.var].length);
+				putchar('\n');
+				break;
+			case DOIL_MOV:
+				printf("mov r%u ", doil.ins->mov.reg);
+				print_doil_constant(doil.ins->mov.val);
+				putchar('\n');
+				break;
+			case DOIL_SET:
+				if (doil.ins->set.dst.is_reg) {
+					printf("set r%u", doil.ins->set.dst.val.reg);
+				} else {
+					printf("set %.*s", ids[doil.ins->set.dst.val.var].siz, ids[doil.ins->set.dst.val.var].str);
+				}
+				if (doil.ins->set.src.is_reg) {
+					printf(" r%u\n", doil.ins->set.src.val.reg);
+				} else {
+						putchar(' ');
+						print_doil_constant(doil.ins->set.src);
+						putchar('\n');
+				}
+				break;
+			case DOIL_GET:
+				printf("get %.*s r%u\n", ids[doil.ins->get.var].siz, ids[doil.ins->get.var].str, doil.ins->get.reg);
+				break;
+			case DOIL_CAST:
+				printf("cast ");
+				if (doil.ins->cast.src.is_reg) printf("r%u", doil.ins->cast.src.val.reg);
+				else                           print_doil_constant(doil.ins->cast.src);
+				printf(" %c%u r%u\n", doil.ins->cast.type.is_signed ? 'i' : 'u', 1 << doil.ins->cast.type.siz, doil.ins->cast.dst);
+				break;
+			case DOIL_LOAD:
+			case DOIL_STORE:
+				printf("%s %.*s ", instruction_type_str[doil.ins->type], ids[doil.ins->elem.var].siz, ids[doil.ins->elem.var].str);
+				print_doil_operand(doil.ins->elem.idx);
+				putchar(' ');
+				if (doil.ins->type == DOIL_LOAD) printf("r%u", doil.ins->elem.dst);
+				else                             print_doil_operand(doil.ins->elem.src);
+				putchar('\n');
+				break;
+			case DOIL_CHECK:
+				printf("check %.*s ", ids[doil.ins->check.var].siz, ids[doil.ins->check.var].str);
+				print_doil_operand(doil.ins->check.idx);
+				putchar(' ');
+				print_doil_operand(doil.ins->check.len);
+				putchar('\n');
+				break;
+			case DOIL_LENGTH:
+				printf("len %.*s r%u\n", ids[doil.ins->get.var].siz, ids[doil.ins->get.var].str, doil.ins->get.reg);
+				break;
+			case DOIL_SLICE:
+				printf("slice %.*s %.*s\n", ids[doil.ins->slice.dst].siz, ids[doil.ins->slice.dst].str, ids[doil.ins->slice.src].siz, ids[doil.ins->slice.src].str);
+				break;
+			case DOIL_VADD:
+			case DOIL_VSUB:
+			case DOIL_VMUL:
+			case DOIL_VDIV:
+				printf("%s %.*s ", instruction_type_str[doil.ins->type], ids[doil.ins->vec.dst].siz, ids[doil.ins->vec.dst].str);
+				print_doil_operand(doil.ins->vec.lhs);
+				putchar(' ');
+				print_doil_operand(doil.ins->vec.rhs);
+				putchar('\n');
+				break;
+			case DOIL_ARG:
+				printf("arg %u r%u\n", doil.ins->arg.idx, doil.ins->arg.dst);
+				break;
+			case DOIL_CALL:
+				printf("call %.*s(", ids[systems[doil.ins->call.system].id].siz, ids[systems[doil.ins->call.system].id].str);
+				for (unsigned int i = 0; i < doil.ins->call.args_count; i++) {
+					if (i) printf(", ");
+					print_doil_operand(doil.ins->call.args[i]);
+				}
+				putchar(')');
+				if (doil.ins->call.dst != ID_NONE) printf(" r%u", doil.ins->call.dst);
+				putchar('\n');
+				break;
+			case DOIL_LABEL:
+				printf("L%u:\n", doil.ins->label.block);
+				break;
+			case DOIL_JMP:
+				printf("jmp L%u\n", doil.ins->jmp.target[0]);
+				break;
+			case DOIL_BR:
+				printf("br ");
+				print_doil_operand(doil.ins->jmp.cond);
+				printf(" L%u L%u\n", doil.ins->jmp.target[0], doil.ins->jmp.target[1]);
+				break;
+			case DOIL_PHI:
+				printf("phi [");
+				for (unsigned int i = 0; i < doil.ins->phi.args_count; i++) {
+					if (i) printf(", ");
+					print_doil_operand(doil.ins->phi.args[i]);
+				}
+				printf("] r%u\n", doil.ins->phi.dst);
+				break;
+			case DOIL_RET:
+				printf("ret");
+				if (!doil.ins->ret.src.unused) {
+					if (doil.ins->ret.src.is_reg) {
+						printf(" r%u\n", doil.ins->ret.src.val.reg);
+					} else {
+						putchar(' ');
+					print_doil_constant(doil.ins->ret.src);
+					putchar('\n');
+					}
+				} else {
+					putchar('\n');
+				}
+				break;
+			default:
+				fprintf(stderr, "ERROR: not a valid instruction %d\n", doil.hins->type);
+				exit(1);
+		}
+		doil.ins = doil.ins->nxt;
+	}
+}
+
+/* the error of a division of two constants that can't be folded, NULL when it can be */
+const char *
+doil_division_error(instruction_t *ins) {
+	unsigned long long lhs = doil_wrap(ins->ope.lhs.val.imm, ins->ope.type);
+	unsigned long long rhs = doil_wrap(ins->ope.rhs.val.imm, ins->ope.type);
+	if (!rhs) return "WARNING: trying to divide by zero";
+	if (ins->ope.type.is_signed && lhs == 1ull << 63 && rhs == ~0ull) return "ERROR: signed division overflows";
+	return NULL;
+}
+
+/* fold an operation on two constants, wrapping around its type */
+reg_or_const
+doil_perform_operation(instruction_t *ins, unsigned int operator) {
+	doil_type_t type = ins->ope.type;
+	unsigned long long lhs = doil_wrap(ins->ope.lhs.val.imm, type);
+	unsigned long long rhs = doil_wrap(ins->ope.rhs.val.imm, type);
+	unsigned int reg = ins->ope.dst;
+	unsigned long long val;
+	ins->type = DOIL_MOV;
+	ins->mov.reg = reg;
+	switch (operator) {
+		case DOIL_ADD:
+			val = lhs + rhs;
+			break;
+		case DOIL_SUB:
+			val = lhs - rhs;
+			break;
+		case DOIL_MUL:
+			val = lhs * rhs;
+			break;
+		case DOIL_DIV:
+			assert(rhs && !(type.is_signed && lhs == 1ull << 63 && rhs == ~0ull) && "a failing division isn't folded");
+			if (!type.is_signed) val = lhs / rhs;
+			else                 val = (long long)lhs / (long long)rhs;
+			break;
+		case DOIL_SHL:
+			val = lhs << rhs;
+			break;
+		case DOIL_SHR:
+			val = type.is_signed ? (unsigned long long)((long long)lhs >> rhs) : lhs >> rhs;
+			break;
+		case DOIL_MULH:
+			if (type.is_signed) val = (unsigned long long)(((__int128)(long long)lhs * (long long)rhs) >> 64);
+			else                val = ((unsigned __int128)lhs * rhs) >> 64;
+			break;
+		case DOIL_LT:
+			val = type.is_signed ? (long long)lhs < (long long)rhs : lhs < rhs;
+			type = doil_bool;
+			break;
+		case DOIL_LE:
+			val = type.is_signed ? (long long)lhs <= (long long)rhs : lhs <= rhs;
+			type = doil_bool;
+			break;
+		case DOIL_EQ:
+			val = lhs == rhs;
+			type = doil_bool;
+			break;
+		case DOIL_NE:
+			val = lhs != rhs;
+			type = doil_bool;
+			break;
+		default:
+			assert(0 && "unreachable");
+			break;
+	}
+	return doil_constant(doil_wrap(val, type), type);
+}
+
+/* the operands that can be registers, NULL past the last one */
+reg_or_const *
+doil_operand(instruction_t *ins, unsigned int i) {
+	switch (ins->type) {
+		case DOIL_ADD:
+		case DOIL_SUB:
+		case DOIL_MUL:
+		case DOIL_DIV:
+		case DOIL_SHL:
+		case DOIL_SHR:
+		case DOIL_MULH:
+		case DOIL_LT:
+		case DOIL_LE:
+		case DOIL_EQ:
+		case DOIL_NE:
+			return i == 0 ? &ins->ope.lhs : i == 1 ? &ins->ope.rhs : NULL;
+		case DOIL_BR:
+			return i == 0 ? &ins->jmp.cond : NULL;
+		case DOIL_PHI:
+			return i < ins->phi.args_count ? &ins->phi.args[i] : NULL;
+		case DOIL_SET:
+			return i == 0 ? &ins->set.src : NULL;
+		case DOIL_RET:
+			return i == 0 && !ins->ret.src.unused ? &ins->ret.src : NULL;
+		case DOIL_CAST:
+			return i == 0 ? &ins->cast.src : NULL;
+		case DOIL_LOAD:
+			return i == 0 ? &ins->elem.idx : NULL;
+		case DOIL_STORE:
+			return i == 0 ? &ins->elem.idx : i == 1 ? &ins->elem.src : NULL;
+		case DOIL_CHECK:
+			return i == 0 ? &ins->check.idx : i == 1 ? &ins->check.len : NULL;
+		case DOIL_VADD:
+		case DOIL_VSUB:
+		case DOIL_VMUL:
+		case DOIL_VDIV:
+			return i == 0 ? &ins->vec.lhs : i == 1 ? &ins->vec.rhs : NULL;
+		case DOIL_CALL:
+			return i < ins->call.args_count ? &ins->call.args[i] : NULL;
+		default:
+			return NULL;
+	}
+}
+
+/* returns NULL when the instruction doesn't write a register */
+unsigned int *
+doil_defined_register(instruction_t *ins) {
+	switch (ins->type) {
+		case DOIL_ADD:
+		case DOIL_SUB:
+		case DOIL_MUL:
+		case DOIL_DIV:
+		case DOIL_SHL:
+		case DOIL_SHR:
+		case DOIL_MULH:
+		case DOIL_LT:
+		case DOIL_LE:
+		case DOIL_EQ:
+		case DOIL_NE:
+			return &ins->ope.dst;
+		case DOIL_PHI:
+			return &ins->phi.dst;
+		case DOIL_MOV:
+			return &ins->mov.reg;
+		case DOIL_GET:
+		case DOIL_LENGTH:
+			return &ins->get.reg;
+		case DOIL_CAST:
+			return &ins->cast.dst;
+		case DOIL_LOAD:
+			return &ins->elem.dst;
+		case DOIL_SET:
+			return ins->set.dst.is_reg ? &ins->set.dst.val.reg : NULL;
+		case DOIL_ARG:
+			return &ins->arg.dst;
+		case DOIL_CALL:
+			return ins->call.dst != ID_NONE ? &ins->call.dst : NULL;
+		default:
+			return NULL;
+	}
+}
+
+/* whether every value of type from is also a value of type to */
+int
+doil_type_fits(doil_type_t from, doil_type_t to) {
+	if (from.siz == to.siz) return from.is_signed == to.is_signed || to.siz == DOIL_QWORD;
+	return from.siz < to.siz && (!from.is_signed || to.is_signed);
+}
+
+void
+doil_add_use(doil_t *doil, unsigned int reg, instruction_t *ins) {
+	doil_use_t *use = arena_alloc(&doil_arena, sizeof(doil_use_t));
+	use->ins = ins;
+	use->nxt = doil->registers[reg].uses;
+	doil->registers[reg].uses = use;
+	doil->registers[reg].uses_count++;
+}
+
+/* a scalar of the data segments, which the systems it calls can read and write as well */
+#define doil_is_global(v) ((v)->type == ID_VARIABLE && !(v)->system && !(v)->length && !(v)->is_slice)
+
+#define DOIL_NO_BLOCK 0xffffffffu
+
+void doil_optimize_push(instruction_t *ins);
+void doil_kill(doil_t *doil, instruction_t *ins);
+int doil_same_operand(reg_or_const a, reg_or_const b);
+
+int
+doil_has_phi(block_t *blk) {
+	for (instruction_t *ins = blk->head->nxt; ins && ins->type == DOIL_PHI; ins = ins->nxt) {
+		if (!ins->dead) return 1;
+	}
+	return 0;
+}
+
+/* the phis of to lose the argument coming from from */
+void
+doil_remove_edge(doil_t *doil, unsigned int from, unsigned int to) {
+	block_t *f = &doil->blocks[from], *t = &doil->blocks[to];
+	unsigned int i = 0;
+	while (t->preds[i] != from) i++;
+	memmove(&t->preds[i], &t->preds[i + 1], sizeof(unsigned int) * (t->preds_count - i - 1));
+	t->preds_count--;
+	for (instruction_t *ins = t->head ? t->head->nxt : NULL; ins && ins->type == DOIL_PHI; ins = ins->nxt) {
+		if (ins->dead) continue;
+		reg_or_const arg = ins->phi.args[i];
+		memmove(&ins->phi.args[i], &ins->phi.args[i + 1], sizeof(reg_or_const) * (ins->phi.args_count - i - 1));
+		ins->phi.args_count--;
+		if (arg.is_reg && --doil->registers[arg.val.reg].uses_count == 0) doil_optimize_push(doil->registers[arg.val.reg].def);
+		doil_optimize_push(ins);
+	}
+	for (unsigned int k = 0; k < f->succs_count; k++) {
+		if (f->succs[k] != to) continue;
+		f->succs[k] = f->succs[--f->succs_count];
+		break;
+	}
+}
+
+/*
+ * drop the blocks that can't be reached from the entry, returns how many there were.
+ * once in ssa form their instructions are killed, so what they used can go as well.
+ */
+unsigned int
+doil_prune_blocks(doil_t *doil, int in_ssa) {
+	unsigned int n = doil->blocks_count, pruned = 0, count = 0;
+	unsigned char *reached = calloc(n + 1, 1);
+	unsigned int *stack = malloc(sizeof(unsigned int) * (n + 1));
+	reached[0] = 1;
+	stack[count++] = 0;
+	while (count) {
+		block_t *blk = &doil->blocks[stack[--count]];
+		for (unsigned int k = 0; k < blk->succs_count; k++) {
+			if (reached[blk->succs[k]]) continue;
+			reached[blk->succs[k]] = 1;
+			stack[count++] = blk->succs[k];
+		}
+	}
+	for (unsigned int b = 0; b < n; b++) {
+		block_t *blk = &doil->blocks[b];
+		if (reached[b] || !blk->head) continue;
+		for (instruction_t *ins = blk->head;; ins = ins->nxt) {
+			/* the variables of the code that is never run aren't accessed */
+			if (!ins->dead && ins->type == DOIL_GET) ids[ins->get.var].use_amount--;
+			if (!ins->dead && ins->type == DOIL_SET && !ins->set.dst.is_reg) ids[ins->set.dst.val.var].set_amount--;
+			if (!ins->dead && in_ssa) doil_kill(doil, ins);
+			ins->dead = 1;
+			if (ins == blk->tail) break;
+		}
+		while (blk->succs_count) doil_remove_edge(doil, b, blk->succs[0]);
+		blk->head = NULL;
+		pruned++;
+	}
+	free(reached);
+	free(stack);
+	return pruned;
+}
+
+/*
+ * merge a block into the one before it when that one jumps to it and nothing else does, then
+ * number the blocks left in the order of their labels and link their instructions in that order,
+ * without the dead ones.
+ */
+void
+doil_layout_blocks(doil_t *doil) {
+	unsigned int n = doil->blocks_count, count = 0;
+	instruction_t **heads = malloc(sizeof(instruction_t *) * (n + 1));
+	instruction_t **tails = malloc(sizeof(instruction_t *) * (n + 1));
+	unsigned int *next = malloc(sizeof(unsigned int) * (n + 1)); /* the block merged at its end */
+	unsigned int *number = malloc(sizeof(unsigned int) * (n + 1));
+	unsigned int *order = malloc(sizeof(unsigned int) * (n + 1));
+	for (unsigned int b = 0; b < n; b++) {
+		heads[b] = doil->blocks[b].head;
+		tails[b] = doil->blocks[b].tail;
+		next[b] = DOIL_NO_BLOCK;
+	}
+	for (unsigned int b = 0; b < n; b++) {
+		block_t *blk = &doil->blocks[b];
+		if (!blk->head) continue;
+		unsigned int at = b;
+		while (next[at] != DOIL_NO_BLOCK) at = next[at];
+		while (blk->tail->type == DOIL_JMP) {
+			unsigned int s = blk->tail->jmp.target[0];
+			block_t *nxt = &doil->blocks[s];
+			if (s == b || s == 0 || nxt->preds_count != 1 || doil_has_phi(nxt)) break;
+			blk->tail->dead = 1;
+			nxt->head->dead = 1;
+			blk->tail = nxt->tail;
+			if (blk->tail->type == DOIL_JMP || blk->tail->type == DOIL_BR) blk->tail->jmp.block = b;
+			blk->succs_count = nxt->succs_count;
+			for (unsigned int k = 0; k < nxt->succs_count; k++) {
+				block_t *succ = &doil->blocks[blk->succs[k] = nxt->succs[k]];
+				for (unsigned int i = 0; i < succ->preds_count; i++) {
+					if (succ->preds[i] == s) succ->preds[i] = b;
+				}
+			}
+			free(nxt->preds);
+			*nxt = (block_t){0};
+			next[at] = s;
+			while (next[at] != DOIL_NO_BLOCK) at = next[at];
+		}
+	}
+
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) {
+		if (ins->type == DOIL_LABEL && doil->blocks[ins->label.block].head == ins) order[count++] = ins->label.block;
+	}
+	instruction_t *prv = NULL;
+	for (unsigned int k = 0; k < count; k++) {
+		number[order[k]] = k;
+		for (unsigned int p = order[k]; p != DOIL_NO_BLOCK; p = next[p]) {
+			instruction_t *ins = heads[p], *nxt;
+			for (;; ins = nxt) {
+				nxt = ins->nxt;
+				if (!ins->dead) {
+					if (prv) prv->nxt = ins;
+					else     doil->hins = ins;
+					prv = ins;
+				}
+				if (ins == tails[p]) break;
+			}
+		}
+	}
+	if (prv) prv->nxt = NULL;
+	else     doil->hins = NULL;
+	doil->ins = prv;
+
+	block_t *blocks = malloc(sizeof(block_t) * (count + 1));
+	for (unsigned int k = 0; k < count; k++) {
+		block_t *blk = &blocks[k];
+		*blk = doil->blocks[order[k]];
+		blk->head->label.block = k;
+		for (unsigned int i = 0; i < blk->preds_count; i++) blk->preds[i] = number[blk->preds[i]];
+		for (unsigned int i = 0; i < blk->succs_count; i++) blk->succs[i] = number[blk->succs[i]];
+		if (blk->tail->type == DOIL_JMP || blk->tail->type == DOIL_BR) {
+			blk->tail->jmp.block = k;
+			blk->tail->jmp.target[0] = number[blk->tail->jmp.target[0]];
+			if (blk->tail->type == DOIL_BR) blk->tail->jmp.target[1] = number[blk->tail->jmp.target[1]];
+		}
+	}
+	for (unsigned int b = 0; b < n; b++) {
+		if (!doil->blocks[b].head) free(doil->blocks[b].preds);
+	}
+	free(doil->blocks);
+	doil->blocks = blocks;
+	doil->blocks_count = doil->blocks_cap = count;
+	free(heads);
+	free(tails);
+	free(next);
+	free(number);
+	free(order);
+}
+
+/*
+ * a block of its own on every edge from a br to a block with more than one predecessor, so the
+ * moves into the phis of that block have somewhere to go. it is placed right before the block it
+ * jumps to, and takes the place of the br in its predecessors, which keeps the phis as they are.
+ */
+void
+doil_split_critical_edges(doil_t *doil) {
+	unsigned int n = doil->blocks_count;
+	instruction_t **pending = calloc(n + 1, sizeof(instruction_t *)); /* the splits to place before a block */
+	for (unsigned int b = 0; b < n; b++) {
+		instruction_t *br = doil->blocks[b].tail;
+		if (br->type != DOIL_BR) continue;
+		for (unsigned int k = 0; k < 2; k++) {
+			unsigned int s = br->jmp.target[k];
+			if (doil->blocks[s].preds_count < 2) continue;
+			unsigned int split = doil_new_block(doil);
+			block_t *blk = &doil->blocks[split], *to = &doil->blocks[s], *from = &doil->blocks[b];
+			instruction_t *label = arena_alloc(&doil_arena, sizeof(instruction_t));
+			instruction_t *jmp = arena_alloc(&doil_arena, sizeof(instruction_t));
+			*label = (instruction_t){ .type = DOIL_LABEL, .label.block = split, .nxt = jmp };
+			*jmp = (instruction_t){ .type = DOIL_JMP, .jmp.target = { s }, .jmp.block = split, .nxt = pending[s] };
+			pending[s] = label;
+			blk->head = label;
+			blk->tail = jmp;
+			blk->preds = malloc(sizeof(unsigned int) * 2);
+			blk->preds[0] = b;
+			blk->preds_count = 1;
+			blk->preds_cap = 2;
+			blk->succs[blk->succs_count++] = s;
+			for (unsigned int i = 0; i < to->preds_count; i++) {
+				if (to->preds[i] == b) {
+					to->preds[i] = split;
+					break;
+				}
+			}
+			for (unsigned int i = 0; i < from->succs_count; i++) {
+				if (from->succs[i] == s) {
+					from->succs[i] = split;
+					break;
+				}
+			}
+			br->jmp.target[k] = split;
+		}
+	}
+	instruction_t *prv = NULL;
+	for (instruction_t *ins = doil->hins; ins; prv = ins, ins = ins->nxt) {
+		if (ins->type != DOIL_LABEL || ins->label.block >= n || !pending[ins->label.block]) continue;
+		instruction_t *first = pending[ins->label.block], *last = first;
+		pending[ins->label.block] = NULL;
+		while (last->nxt) last = last->nxt;
+		last->nxt = ins;
+		if (prv) prv->nxt = first;
+		else     doil->hins = first;
+		ins = last;
+	}
+	free(pending);
+}
+
+
+/* the value of a global that is only known by what is in memory */
+#define doil_in_memory() ((reg_or_const){ .is_var = 1, .unused = 1 })
+#define doil_is_in_memory(v) ((v).unused && (v).is_var)
+
+/* the value of a variable at the end of a block */
+typedef struct {
+	unsigned long long key; /* block << 32 | variable, plus 1 so 0 is a free slot */
+	reg_or_const val;
+} doil_definition_t;
+
+/* a phi of a block whose predecessors aren't all renamed yet */
+typedef struct {
+	unsigned int var;
+	unsigned int nxt; /* of the same block, ID_NONE at the end */
+	int quiet;
+	instruction_t *phi;
+} doil_incomplete_t;
+
+/* an argument of a phi the variable has no value for, only warned about once something reads it */
+typedef struct {
+	instruction_t *phi;
+	unsigned int arg;
+	unsigned int block; /* of the phi */
+	unsigned int var;
+} doil_undefined_t;
+
+typedef struct {
+	doil_t *doil;
+	reg_t *registers;
+	unsigned int registers_count;
+	unsigned int registers_cap;
+	/* the variables set in the block being renamed, valid when stamp is the block + 1 */
+	reg_or_const *var_value;
+	unsigned int *stamp;
+	unsigned int *written;
+	unsigned int written_count;
+	unsigned int written_cap;
+	doil_definition_t *defs;
+	unsigned int defs_count;
+	unsigned int defs_cap;
+	doil_incomplete_t *incomplete;
+	unsigned int incomplete_count;
+	unsigned int incomplete_cap;
+	unsigned int *incomplete_head; /* per block */
+	doil_undefined_t *undefined;
+	unsigned int undefined_count;
+	unsigned int undefined_cap;
+	unsigned char *sealed; /* every predecessor is renamed, no phi of the block is incomplete */
+	unsigned char *visited;
+	unsigned char *finished;
+	unsigned char *called; /* the block calls a system, the globals are in memory after it */
+	unsigned char *warned; /* per variable, read while uninitialized */
+	instruction_t **last; /* the instruction before the one ending the block */
+	instruction_t **prv; /* the last instruction kept by doil_ssa */
+	unsigned int block; /* being renamed, DOIL_NO_BLOCK while sealing the blocks after it */
+} doil_ssa_t;
+
+unsigned int
+doil_ssa_register(doil_ssa_t *ssa, doil_type_t type, instruction_t *def) {
+	if (ssa->registers_count >= ssa->registers_cap) {
+		ssa->registers_cap = ssa->registers_cap ? ssa->registers_cap * 2 : 16;
+		ssa->registers = realloc(ssa->registers, sizeof(reg_t) * ssa->registers_cap);
+	}
+	ssa->registers[ssa->registers_count] = (reg_t){ .used = 1, .type = type, .def = def };
+	return ssa->registers_count++;
+}
+
+void
+doil_ssa_insert(doil_ssa_t *ssa, instruction_t *after, instruction_t *ins) {
+	ins->nxt = after->nxt;
+	after->nxt = ins;
+	if (*ssa->prv == after) *ssa->prv = ins;
+}
+
+unsigned long long
+doil_ssa_key(unsigned int block, unsigned int var) {
+	return ((unsigned long long)block << 32 | var) + 1;
+}
+
+doil_definition_t *
+doil_ssa_find(doil_ssa_t *ssa, unsigned long long key) {
+	unsigned int i = (key * 11400714819323198485ull) >> 32 & (ssa->defs_cap - 1);
+	while (ssa->defs[i].key && ssa->defs[i].key != key) i = (i + 1) & (ssa->defs_cap - 1);
+	return &ssa->defs[i];
+}
+
+void
+doil_ssa_write(doil_ssa_t *ssa, unsigned int var, unsigned int block, reg_or_const val) {
+	if (block == ssa->block) {
+		ssa->var_value[var] = val;
+		if (ssa->stamp[var] == block + 1) return;
+		ssa->stamp[var] = block + 1;
+		if (ssa->written_count >= ssa->written_cap) {
+			ssa->written_cap = ssa->written_cap ? ssa->written_cap * 2 : 16;
+			ssa->written = realloc(ssa->written, sizeof(unsigned int) * ssa->written_cap);
+		}
+		ssa->written[ssa->written_count++] = var;
+		return;
+	}
+	if ((ssa->defs_count + 1) * 2 > ssa->defs_cap) {
+		doil_definition_t *old = ssa->defs;
+		unsigned int old_cap = ssa->defs_cap;
+		ssa->defs_cap = old_cap ? old_cap * 2 : 64;
+		ssa->defs = calloc(ssa->defs_cap, sizeof(doil_definition_t));
+		for (unsigned int i = 0; i < old_cap; i++) {
+			if (old[i].key) *doil_ssa_find(ssa, old[i].key) = old[i];
+		}
+		free(old);
+	}
+	doil_definition_t *def = doil_ssa_find(ssa, doil_ssa_key(block, var));
+	if (!def->key) ssa->defs_count++;
+	def->key = doil_ssa_key(block, var);
+	def->val = val;
+}
+
+/* what is known of var at the end of block without looking at its predecessors, unused when nothing is */
+reg_or_const
+doil_ssa_peek(doil_ssa_t *ssa, unsigned int var, unsigned int block) {
+	if (block == ssa->block && ssa->stamp[var] == block + 1) return ssa->var_value[var];
+	if (block != ssa->block && ssa->defs_cap) {
+		doil_definition_t *def = doil_ssa_find(ssa, doil_ssa_key(block, var));
+		if (def->key) return def->val;
+	}
+	if (ssa->called[block] && doil_is_global(&ids[var])) return doil_in_memory();
+	return (reg_or_const){ .unused = 1, .is_reg = 1 };
+}
+
+#define doil_ssa_known(v) (!(v).unused || !(v).is_reg)
+
+int
+doil_ssa_same(reg_or_const a, reg_or_const b) {
+	return a.unused == b.unused && doil_same_operand(a, b);
+}
+
+reg_or_const doil_ssa_read(doil_ssa_t *ssa, unsigned int var, unsigned int block, int quiet);
+
+/* a phi of var at the start of block, its arguments are filled by the caller */
+instruction_t *
+doil_ssa_phi(doil_ssa_t *ssa, unsigned int var, unsigned int block) {
+	block_t *blk = &ssa->doil->blocks[block];
+	instruction_t *phi = arena_alloc(&doil_arena, sizeof(instruction_t));
+	*phi = (instruction_t){ .type = DOIL_PHI };
+	phi->phi.args = arena_alloc(&doil_arena, sizeof(reg_or_const) * (blk->preds_count + 1));
+	phi->phi.args_count = blk->preds_count;
+	phi->phi.type = doil_variable_type(&ids[var]);
+	phi->phi.dst = doil_ssa_register(ssa, phi->phi.type, phi);
+	doil_ssa_insert(ssa, blk->head, phi);
+	/* what is read at the end of the block goes after its phis */
+	if (ssa->finished[block] && ssa->last[block] == blk->head) ssa->last[block] = phi;
+	return phi;
+}
+
+void
+doil_ssa_warn(doil_ssa_t *ssa, unsigned int var) {
+	identifier_t *id = &ids[var];
+	if (!ssa->warned[var]) fprintf(stderr, "WARNING: using variable '%.*s', but the variable isn't initialized\n", id->siz, id->str);
+	ssa->warned[var] = 1;
+}
+
+reg_or_const
+doil_ssa_uninitialized(doil_ssa_t *ssa, unsigned int var) {
+	doil_ssa_warn(ssa, var);
+	return doil_constant(0, doil_variable_type(&ids[var]));
+}
+
+void
+doil_ssa_undefined(doil_ssa_t *ssa, instruction_t *phi, unsigned int arg, unsigned int block, unsigned int var) {
+	for (unsigned int i = 0; i < ssa->undefined_count; i++) {
+		if (ssa->undefined[i].phi == phi && ssa->undefined[i].arg == arg) return;
+	}
+	if (ssa->undefined_count >= ssa->undefined_cap) {
+		ssa->undefined_cap = ssa->undefined_cap ? ssa->undefined_cap * 2 : 16;
+		ssa->undefined = realloc(ssa->undefined, sizeof(doil_undefined_t) * ssa->undefined_cap);
+	}
+	ssa->undefined[ssa->undefined_count++] = (doil_undefined_t){ phi, arg, block, var };
+}
+
+/* an argument of a phi has to be a value, what is in memory is read at the end of the predecessor */
+reg_or_const
+doil_ssa_materialize(doil_ssa_t *ssa, unsigned int var, unsigned int block, reg_or_const val) {
+	identifier_t *id = &ids[var];
+	if (doil_is_in_memory(val)) {
+		instruction_t *get = arena_alloc(&doil_arena, sizeof(instruction_t));
+		*get = (instruction_t){ .type = DOIL_GET, .get.var = var };
+		get->get.reg = doil_ssa_register(ssa, doil_variable_type(id), get);
+		doil_ssa_insert(ssa, ssa->last[block], get);
+		ssa->last[block] = get;
+		id->use_amount++;
+		val = (reg_or_const){ .val.reg = get->get.reg, .is_reg = 1 };
+		doil_ssa_write(ssa, var, block, val);
+	} else if (val.unused) {
+		val = doil_constant(0, doil_variable_type(id));
+	}
+	return val;
+}
+
+void
+doil_ssa_phi_operands(doil_ssa_t *ssa, unsigned int var, instruction_t *phi, unsigned int block, int quiet) {
+	block_t *blk = &ssa->doil->blocks[block];
+	for (unsigned int i = 0; i < blk->preds_count; i++) {
+		reg_or_const val = doil_ssa_read(ssa, var, blk->preds[i], quiet);
+		if (val.unused && !doil_is_in_memory(val) && !quiet) doil_ssa_undefined(ssa, phi, i, block, var);
+		phi->phi.args[i] = doil_ssa_materialize(ssa, var, blk->preds[i], val);
+	}
+}
+
+/* the value of var at the start of block comes from its predecessors */
+reg_or_const
+doil_ssa_read_predecessors(doil_ssa_t *ssa, unsigned int var, unsigned int block, int quiet) {
+	block_t *blk = &ssa->doil->blocks[block];
+	reg_or_const val;
+	if (!ssa->sealed[block]) {
+		/* a loop whose end isn't renamed yet */
+		instruction_t *phi = doil_ssa_phi(ssa, var, block);
+		if (ssa->incomplete_count >= ssa->incomplete_cap) {
+			ssa->incomplete_cap = ssa->incomplete_cap ? ssa->incomplete_cap * 2 : 16;
+			ssa->incomplete = realloc(ssa->incomplete, sizeof(doil_incomplete_t) * ssa->incomplete_cap);
+		}
+		ssa->incomplete[ssa->incomplete_count] = (doil_incomplete_t){ var, ssa->incomplete_head[block], quiet, phi };
+		ssa->incomplete_head[block] = ssa->incomplete_count++;
+		val = (reg_or_const){ .val.reg = phi->phi.dst, .is_reg = 1 };
+	} else if (!blk->preds_count) {
+		/* the logic starts with zeroed memory, a system with whatever the globals hold */
+		val = ssa->doil->system && doil_is_global(&ids[var]) ? doil_in_memory() : doil_unknown();
+	} else if (blk->preds_count == 1) {
+		val = doil_ssa_read(ssa, var, blk->preds[0], quiet);
+	} else {
+		/* no phi when every predecessor already has the same value */
+		val = doil_ssa_peek(ssa, var, blk->preds[0]);
+		for (unsigned int i = 1; i < blk->preds_count && doil_ssa_known(val); i++) {
+			if (!doil_ssa_same(val, doil_ssa_peek(ssa, var, blk->preds[i]))) val = (reg_or_const){ .unused = 1, .is_reg = 1 };
+		}
+		if (!doil_ssa_known(val)) {
+			instruction_t *phi = doil_ssa_phi(ssa, var, block);
+			val = (reg_or_const){ .val.reg = phi->phi.dst, .is_reg = 1 };
+			/* written first, a loop coming back to block finds the phi */
+			doil_ssa_write(ssa, var, block, val);
+			doil_ssa_phi_operands(ssa, var, phi, block, quiet);
+		}
+	}
+	doil_ssa_write(ssa, var, block, val);
+	return val;
+}
+
+/* the value of var at the end of block, or at the current instruction when it is the one being renamed */
+reg_or_const
+doil_ssa_read(doil_ssa_t *ssa, unsigned int var, unsigned int block, int quiet) {
+	reg_or_const val = doil_ssa_peek(ssa, var, block);
+	return doil_ssa_known(val) ? val : doil_ssa_read_predecessors(ssa, var, block, quiet);
+}
+
+void
+doil_ssa_seal(doil_ssa_t *ssa, unsigned int block) {
+	for (unsigned int i = ssa->incomplete_head[block]; i != ID_NONE; i = ssa->incomplete[i].nxt) {
+		doil_incomplete_t *inc = &ssa->incomplete[i];
+		doil_ssa_phi_operands(ssa, inc->var, inc->phi, block, inc->quiet);
+	}
+	ssa->sealed[block] = 1;
+}
+
+int
+doil_ssa_ready(doil_ssa_t *ssa, unsigned int block) {
+	block_t *blk = &ssa->doil->blocks[block];
+	for (unsigned int i = 0; i < blk->preds_count; i++) {
+		if (!ssa->finished[blk->preds[i]]) return 0;
+	}
+	return 1;
+}
+
+/* what is left of the block being renamed is kept for the blocks after it, which may seal some */
+void
+doil_ssa_finish(doil_ssa_t *ssa, unsigned int block) {
+	ssa->block = DOIL_NO_BLOCK;
+	for (unsigned int i = 0; i < ssa->written_count; i++) {
+		unsigned int var = ssa->written[i];
+		if (ssa->stamp[var] != block + 1) continue;
+		ssa->stamp[var] = 0;
+		doil_ssa_write(ssa, var, block, ssa->var_value[var]);
+	}
+	ssa->written_count = 0;
+	ssa->finished[block] = 1;
+	block_t *blk = &ssa->doil->blocks[block];
+	for (unsigned int k = 0; k < blk->succs_count; k++) {
+		unsigned int succ = blk->succs[k];
+		if (ssa->visited[succ] && !ssa->sealed[succ] && doil_ssa_ready(ssa, succ)) doil_ssa_seal(ssa, succ);
+	}
+}
+
+/*
+ * the successors of block when it's entered from its predecessor arg, in succs: the phis get the
+ * constants that predecessor gives them, which can decide the branch. known is unused for every
+ * register and left so.
+ */
+unsigned int
+doil_ssa_entered(doil_ssa_t *ssa, unsigned int block, unsigned int arg, reg_or_const *known, unsigned int *succs) {
+	block_t *blk = &ssa->doil->blocks[block];
+	instruction_t *ins, tmp;
+	reg_or_const *op;
+	for (ins = blk->head->nxt; ins != blk->tail; ins = ins->nxt) {
+		/* the operands of a phi or a call aren't in the instruction, they aren't folded anyway */
+		tmp = *ins;
+		for (unsigned int k = 0; ins->type != DOIL_PHI && ins->type != DOIL_CALL && (op = doil_operand(&tmp, k)); k++) {
+			if (op->is_reg && !known[op->val.reg].unused) *op = known[op->val.reg];
+		}
+		switch (ins->type) {
+			case DOIL_PHI:
+				/* a register from the predecessor can be one of the block's own, from the last time */
+				if (!ins->phi.args[arg].is_reg) known[ins->phi.dst] = ins->phi.args[arg];
+				break;
+			case DOIL_MOV:
+				if (!ins->mov.val.is_reg) known[ins->mov.reg] = ins->mov.val;
+				break;
+			case DOIL_CAST:
+				if (!tmp.cast.src.is_reg) known[ins->cast.dst] = doil_constant(doil_wrap(tmp.cast.src.val.imm, ins->cast.type), ins->cast.type);
+				break;
+			case DOIL_ADD:
+			case DOIL_SUB:
+			case DOIL_MUL:
+			case DOIL_DIV:
+			case DOIL_SHL:
+			case DOIL_SHR:
+			case DOIL_MULH:
+			case DOIL_LT:
+			case DOIL_LE:
+			case DOIL_EQ:
+			case DOIL_NE:
+				if (tmp.ope.lhs.is_reg || tmp.ope.rhs.is_reg) break;
+				if (ins->type == DOIL_DIV && doil_division_error(&tmp)) break;
+				known[ins->ope.dst] = doil_perform_operation(&tmp, ins->type);
+				break;
+			default:
+				break;
+		}
+	}
+	unsigned int count = 0;
+	reg_or_const cond = blk->tail->type == DOIL_BR ? blk->tail->jmp.cond : doil_unknown();
+	if (cond.is_reg && !known[cond.val.reg].unused) cond = known[cond.val.reg];
+	if (blk->tail->type == DOIL_BR && !cond.is_reg) succs[count++] = blk->tail->jmp.target[!cond.val.imm];
+	else for (unsigned int k = 0; k < blk->succs_count; k++) succs[count++] = blk->succs[k];
+	for (ins = blk->head->nxt; ins != blk->tail; ins = ins->nxt) {
+		unsigned int *dst = doil_defined_register(ins);
+		if (dst) known[*dst] = doil_unknown();
+	}
+	return count;
+}
+
+/*
+ * a phi argument a variable has no value for is only warned about when the phi is read on a path
+ * from that predecessor: a loop whose condition holds the first time doesn't leave without going
+ * through its body, where the variable may be set. a phi reading it on such a path is followed in
+ * turn.
+ */
+void
+doil_ssa_warn_undefined(doil_ssa_t *ssa) {
+	if (!ssa->undefined_count) return;
+	doil_t *doil = ssa->doil;
+	unsigned int n = doil->blocks_count;
+	reg_or_const *known = malloc(sizeof(reg_or_const) * (ssa->registers_count + 1));
+	unsigned char *reached = malloc(n + 1);
+	unsigned int *stack = malloc(sizeof(unsigned int) * (n + 1));
+	for (unsigned int i = 0; i < ssa->registers_count; i++) known[i] = doil_unknown();
+	for (unsigned int i = 0; i < ssa->undefined_count; i++) {
+		doil_undefined_t und = ssa->undefined[i];
+		if (ssa->warned[und.var]) continue;
+		unsigned int reg = und.phi->phi.dst, succs[2], stack_count = 0;
+		unsigned int succs_count = doil_ssa_entered(ssa, und.block, und.arg, known, succs);
+		memset(reached, 0, n);
+		/* the blocks reached before coming back to the phi, which would be defined again */
+		for (unsigned int k = 0; k < succs_count; k++) {
+			if (succs[k] != und.block && !reached[succs[k]]) reached[stack[stack_count++] = succs[k]] = 1;
+		}
+		while (stack_count) {
+			block_t *blk = &doil->blocks[stack[--stack_count]];
+			for (unsigned int k = 0; k < blk->succs_count; k++) {
+				if (blk->succs[k] != und.block && !reached[blk->succs[k]]) reached[stack[stack_count++] = blk->succs[k]] = 1;
+			}
+		}
+		for (unsigned int b = 0; b < n && !ssa->warned[und.var]; b++) {
+			if (b != und.block && !reached[b]) continue;
+			block_t *blk = &doil->blocks[b];
+			for (instruction_t *ins = blk->head->nxt; ins != blk->tail->nxt; ins = ins->nxt) {
+				reg_or_const *op;
+				for (unsigned int k = 0; (op = doil_operand(ins, k)); k++) {
+					if (!op->is_reg || op->val.reg != reg) continue;
+					if (ins->type != DOIL_PHI) {
+						doil_ssa_warn(ssa, und.var);
+						break;
+					}
+					unsigned int pred = blk->preds[k];
+					int taken = reached[pred];
+					for (unsigned int s = 0; s < succs_count && pred == und.block; s++) taken |= succs[s] == b;
+					if (taken) doil_ssa_undefined(ssa, ins, k, b, und.var);
+				}
+				if (ssa->warned[und.var]) break;
+			}
+		}
+	}
+	free(known);
+	free(reached);
+	free(stack);
+}
+
+/*
+ * the globals set in a doil are stored before a call or the return of a system, unless what they
+ * hold is still what is in memory
+ */
+void
+doil_ssa_flush(doil_ssa_t *ssa, unsigned int *globals, unsigned int globals_count, instruction_t *before) {
+	for (unsigned int i = 0; i < globals_count; i++) {
+		reg_or_const val = doil_ssa_read(ssa, globals[i], ssa->block, 1);
+		if (val.unused) continue;
+		if (val.is_reg && ssa->registers[val.val.reg].def->type == DOIL_GET && ssa->registers[val.val.reg].def->get.var == globals[i]) continue;
+		instruction_t *set = arena_alloc(&doil_arena, sizeof(instruction_t));
+		*set = (instruction_t){ .type = DOIL_SET, .set.dst = doil_variable(globals[i]), .set.src = val, .nxt = before };
+		(*ssa->prv)->nxt = set;
+		*ssa->prv = set;
+		ids[globals[i]].set_amount++;
+	}
+}
+
+/*
+ * rename the registers so every value is defined once and turn the variables into values, with a
+ * phi where the blocks leading to a block disagree on one (Braun et al., simple and efficient
+ * construction of ssa form): a get reads what the last set stored, or the zero a variable starts
+ * with. the sets and gets are gone afterwards, what is stored is converted with a cast when it
+ * doesn't fit.
+ * the globals are the exception around calls: what was set is stored before a call or the return
+ * of a system, and read again from memory after a call or at the start of a system.
+ */
+void
+doil_ssa(doil_t *doil) {
+	/* an extern system has no code */
+	if (!doil->blocks_count) return;
+	doil_prune_blocks(doil, 0);
+	doil_layout_blocks(doil);
+	unsigned int n = doil->blocks_count;
+	doil_ssa_t ssa = { .doil = doil, .block = DOIL_NO_BLOCK };
+	reg_or_const *value = malloc(sizeof(reg_or_const) * (doil->registers_count + 1));
+	ssa.var_value = malloc(sizeof(reg_or_const) * (ids_count + 1));
+	ssa.stamp = calloc(ids_count + 1, sizeof(unsigned int));
+	ssa.incomplete_head = malloc(sizeof(unsigned int) * (n + 1));
+	ssa.sealed = calloc(n + 1, 1);
+	ssa.visited = calloc(n + 1, 1);
+	ssa.finished = calloc(n + 1, 1);
+	ssa.called = calloc(n + 1, 1);
+	ssa.warned = calloc(ids_count + 1, 1);
+	ssa.last = malloc(sizeof(instruction_t *) * (n + 1));
+	for (unsigned int i = 0; i < doil->registers_count; i++) value[i] = doil_unknown();
+	for (unsigned int b = 0; b < n; b++) ssa.incomplete_head[b] = ID_NONE;
+
+	unsigned char *is_set = calloc(ids_count + 1, 1);
+	unsigned int *globals = malloc(sizeof(unsigned int) * (ids_count + 1)), globals_count = 0;
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) {
+		if (ins->type != DOIL_SET || ins->set.dst.is_reg || !doil_is_global(&ids[ins->set.dst.val.var]) || is_set[ins->set.dst.val.var]) continue;
+		is_set[ins->set.dst.val.var] = 1;
+		globals[globals_count++] = ins->set.dst.val.var;
+	}
+	free(is_set);
+
+	instruction_t *prv = NULL, *nxt;
+	ssa.prv = &prv;
+	for (instruction_t *ins = doil->hins; ins; ins = nxt) {
+		nxt = ins->nxt;
+		reg_or_const *op;
+		for (unsigned int k = 0; (op = doil_operand(ins, k)); k++) {
+			if (!op->is_reg) continue;
+			assert(!value[op->val.reg].unused && "register used before it is defined");
+			*op = value[op->val.reg];
+		}
+
+		unsigned int block = ssa.block;
+		if (ins->type == DOIL_LABEL) {
+			block = ssa.block = ins->label.block;
+			ssa.visited[block] = 1;
+			if (doil_ssa_ready(&ssa, block)) doil_ssa_seal(&ssa, block);
+		}
+		if (ins->type == DOIL_CALL || (ins->type == DOIL_RET && doil->system)) doil_ssa_flush(&ssa, globals, globals_count, ins);
+
+		int remove = 0;
+		unsigned int cast_var = ID_NONE, get_var = ID_NONE;
+		identifier_t *var;
+		unsigned int *dst = doil_defined_register(ins);
+		doil_type_t type;
+		reg_or_const val;
+		switch (ins->type) {
+			case DOIL_GET:
+				var = &ids[ins->get.var];
+				val = doil_ssa_read(&ssa, ins->get.var, block, 0);
+				if (doil_is_in_memory(val)) {
+					/* read once, until the next call */
+					get_var = ins->get.var;
+					break;
+				}
+				if (val.unused) {
+					val = doil_ssa_uninitialized(&ssa, ins->get.var);
+					doil_ssa_write(&ssa, ins->get.var, block, val);
+				}
+				value[ins->get.reg] = val;
+				var->use_amount--;
+				remove = 1;
+				break;
+			case DOIL_SET:
+				if (ins->set.dst.is_reg) {
+					/* a value assigned to a register is just a copy */
+					value[ins->set.dst.val.reg] = ins->set.src;
+					remove = 1;
+					break;
+				}
+				var = &ids[ins->set.dst.val.var];
+				type = doil_variable_type(var);
+				var->set_amount--;
+				if (!ins->set.src.is_reg) {
+					doil_ssa_write(&ssa, ins->set.dst.val.var, block, doil_constant(doil_wrap(ins->set.src.val.imm, type), type));
+					remove = 1;
+				} else if (doil_type_fits(ssa.registers[ins->set.src.val.reg].type, type)) {
+					doil_ssa_write(&ssa, ins->set.dst.val.var, block, ins->set.src);
+					remove = 1;
+				} else {
+					reg_or_const src = ins->set.src;
+					cast_var = ins->set.dst.val.var;
+					ins->type = DOIL_CAST;
+					ins->cast.src = src;
+					ins->cast.type = type;
+					dst = &ins->cast.dst;
+				}
+				break;
+			case DOIL_CALL:
+				ssa.called[block] = 1;
+				for (unsigned int i = 0; i < ssa.written_count; i++) {
+					if (doil_is_global(&ids[ssa.written[i]])) ssa.stamp[ssa.written[i]] = 0;
+				}
+				break;
+			default:
+				break;
+		}
+		if (remove) {
+			prv->nxt = ins->nxt;
+			continue;
+		}
+
+		if (dst) {
+			doil_type_t t;
+			switch (ins->type) {
+				case DOIL_MOV:    t = ins->mov.val.type; break;
+				case DOIL_CAST:   t = ins->cast.type; break;
+				case DOIL_LOAD:   t = doil_variable_type(&ids[ins->elem.var]); break;
+				case DOIL_LENGTH: t = (doil_type_t){ DOIL_QWORD, 0 }; break;
+				case DOIL_GET:    t = doil_variable_type(&ids[ins->get.var]); break;
+				case DOIL_ARG:    t = ins->arg.type; break;
+				case DOIL_CALL:   t = ins->call.type; break;
+				case DOIL_LT:
+				case DOIL_LE:
+				case DOIL_EQ:
+				case DOIL_NE:     t = doil_bool; break;
+				default:          t = ins->ope.type; break;
+			}
+			reg_or_const reg = { .val.reg = doil_ssa_register(&ssa, t, ins), .is_reg = 1 };
+			if (cast_var != ID_NONE)     doil_ssa_write(&ssa, cast_var, block, reg);
+			else                         value[*dst] = reg;
+			if (get_var != ID_NONE)      doil_ssa_write(&ssa, get_var, block, reg);
+			*dst = reg.val.reg;
+		}
+		if (doil_ends_block(ins)) ssa.last[block] = prv;
+		prv = ins;
+		if (doil_ends_block(ins)) doil_ssa_finish(&ssa, block);
+	}
+	prv->nxt = NULL;
+	doil->ins = prv;
+	doil_ssa_warn_undefined(&ssa);
+
+	free(doil->registers);
+	doil->registers = ssa.registers;
+	doil->registers_count = doil->registers_cap = ssa.registers_count;
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) {
+		reg_or_const *op;
+		for (unsigned int k = 0; (op = doil_operand(ins, k)); k++) {
+			if (op->is_reg) doil_add_use(doil, op->val.reg, ins);
+		}
+	}
+	free(value);
+	free(globals);
+	free(ssa.var_value);
+	free(ssa.stamp);
+	free(ssa.written);
+	free(ssa.defs);
+	free(ssa.incomplete);
+	free(ssa.undefined);
+	free(ssa.incomplete_head);
+	free(ssa.sealed);
+	free(ssa.visited);
+	free(ssa.finished);
+	free(ssa.called);
+	free(ssa.warned);
+	free(ssa.last);
+}
+
+static instruction_t **work;
+static unsigned int work_count;
+static unsigned int work_cap;
+
+void
+doil_optimize_push(instruction_t *ins) {
+	if (ins->dead || ins->queued) return;
+	if (work_count >= work_cap) {
+		work_cap = work_cap ? work_cap * 2 : 64;
+		work = realloc(work, sizeof(instruction_t *) * work_cap);
+	}
+	ins->queued = 1;
+	work[work_count++] = ins;
+}
+
+/* every use of reg reads val instead */
+void
+doil_replace_uses(doil_t *doil, unsigned int reg, reg_or_const val) {
+	for (doil_use_t *use = doil->registers[reg].uses; use; use = use->nxt) {
+		if (use->ins->dead) continue;
+		reg_or_const *op;
+		for (unsigned int k = 0; (op = doil_operand(use->ins, k)); k++) {
+			if (!op->is_reg || op->val.reg != reg) continue;
+			*op = val;
+			if (val.is_reg) doil_add_use(doil, val.val.reg, use->ins);
+			doil->optimized++;
+		}
+		doil_optimize_push(use->ins);
+	}
+	doil->registers[reg].uses = NULL;
+	doil->registers[reg].uses_count = 0;
+}
+
+void
+doil_kill(doil_t *doil, instruction_t *ins) {
+	reg_or_const *op;
+	ins->dead = 1;
+	doil->optimized++;
+	for (unsigned int k = 0; (op = doil_operand(ins, k)); k++) {
+		if (!op->is_reg) continue;
+		if (--doil->registers[op->val.reg].uses_count == 0) doil_optimize_push(doil->registers[op->val.reg].def);
+	}
+}
+
+unsigned int
+doil_new_register(doil_t *doil, doil_type_t type, instruction_t *def) {
+	if (doil->registers_count >= doil->registers_cap) {
+		doil->registers_cap = doil->registers_cap ? doil->registers_cap * 2 : 16;
+		doil->registers = realloc(doil->registers, sizeof(reg_t) * doil->registers_cap);
+	}
+	doil->registers[doil->registers_count] = (reg_t){ .used = 1, .type = type, .def = def };
+	return doil->registers_count++;
+}
+
+/* a new operation after *after, which then points to it */
+reg_or_const
+doil_insert_operation(doil_t *doil, instruction_t **after, unsigned int type, reg_or_const lhs, reg_or_const rhs, doil_type_t t) {
+	instruction_t *ins = arena_alloc(&doil_arena, sizeof(instruction_t));
+	*ins = (instruction_t){0};
+	ins->type = type;
+	ins->ope.lhs = lhs;
+	ins->ope.rhs = rhs;
+	ins->ope.type = t;
+	ins->ope.dst = doil_new_register(doil, t, ins);
+	if (lhs.is_reg) doil_add_use(doil, lhs.val.reg, ins);
+	if (rhs.is_reg) doil_add_use(doil, rhs.val.reg, ins);
+	ins->nxt = (*after)->nxt;
+	(*after)->nxt = ins;
+	*after = ins;
+	doil->optimized++;
+	return (reg_or_const){ .val.reg = ins->ope.dst, .is_reg = 1 };
+}
+
+/* the operation only converts x to its type */
+void
+doil_copy(doil_t *doil, instruction_t *ins, reg_or_const x) {
+	doil_type_t type = ins->ope.type;
+	unsigned int dst = ins->ope.dst;
+	if (doil_type_fits(doil->registers[x.val.reg].type, type)) {
+		doil_replace_uses(doil, dst, x);
+		return;
+	}
+	ins->type = DOIL_CAST;
+	ins->cast.src = x;
+	ins->cast.dst = dst;
+	ins->cast.type = type;
+	doil->optimized++;
+	doil_optimize_push(ins);
+}
+
+/* Hacker's Delight 10-1, for 2 <= |d| < 2^63 */
+void
+doil_signed_magic(long long d, unsigned long long *magic, unsigned int *shift) {
+	const unsigned long long two63 = 1ull << 63;
+	unsigned long long ad = d < 0 ? -(unsigned long long)d : (unsigned long long)d;
+	unsigned long long t = two63 + ((unsigned long long)d >> 63);
+	unsigned long long anc = t - 1 - t % ad;
+	unsigned long long q1 = two63 / anc, r1 = two63 - q1 * anc;
+	unsigned long long q2 = two63 / ad, r2 = two63 - q2 * ad, delta;
+	unsigned int p = 63;
+	do {
+		p++;
+		q1 *= 2;
+		r1 *= 2;
+		if (r1 >= anc) {
+			q1++;
+			r1 -= anc;
+		}
+		q2 *= 2;
+		r2 *= 2;
+		if (r2 >= ad) {
+			q2++;
+			r2 -= ad;
+		}
+		delta = ad - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+	*magic = d < 0 ? -(q2 + 1) : q2 + 1;
+	*shift = p - 64;
+}
+
+/* division by a constant that isn't a power of two, or a signed one, as a multiplication by its inverse */
+void
+doil_divide_by_constant(doil_t *doil, instruction_t *ins, reg_or_const x, unsigned long long d) {
+	static const doil_type_t u8 = { DOIL_QWORD, 0 }, i8 = { DOIL_QWORD, 1 };
+	doil_type_t type = ins->ope.type;
+	instruction_t *at = ins;
+	reg_or_const q;
+	if (!type.is_signed) {
+		/* Granlund and Montgomery, with the add back that works for every 64 bits dividend */
+		unsigned int l = 64 - __builtin_clzll(d - 1);
+		unsigned long long m = (unsigned long long)((((unsigned __int128)1 << 64) * (((unsigned __int128)1 << l) - d)) / d) + 1;
+		reg_or_const hi = doil_insert_operation(doil, &at, DOIL_MULH, x, doil_constant(m, u8), u8);
+		q = doil_insert_operation(doil, &at, DOIL_SUB, x, hi, u8);
+		q = doil_insert_operation(doil, &at, DOIL_SHR, q, doil_constant(1, u8), u8);
+		q = doil_insert_operation(doil, &at, DOIL_ADD, hi, q, u8);
+		/* in 64 bits, the sum doesn't fit type even though the quotient does */
+		q = doil_insert_operation(doil, &at, DOIL_SHR, q, doil_constant(l - 1, u8), u8);
+	} else if ((long long)d > 0 && !(d & (d - 1))) {
+		/* negative dividends are biased by d - 1, so the shift rounds toward zero */
+		unsigned int k = __builtin_ctzll(d);
+		q = doil_insert_operation(doil, &at, DOIL_SHR, x, doil_constant(63, u8), i8);
+		q = doil_insert_operation(doil, &at, DOIL_SHR, q, doil_constant(64 - k, u8), u8);
+		q = doil_insert_operation(doil, &at, DOIL_ADD, x, q, i8);
+		q = doil_insert_operation(doil, &at, DOIL_SHR, q, doil_constant(k, u8), type);
+	} else {
+		unsigned long long m;
+		unsigned int s;
+		doil_signed_magic((long long)d, &m, &s);
+		q = doil_insert_operation(doil, &at, DOIL_MULH, x, doil_constant(m, i8), i8);
+		if ((long long)d > 0 && (long long)m < 0) q = doil_insert_operation(doil, &at, DOIL_ADD, q, x, i8);
+		if ((long long)d < 0 && (long long)m > 0) q = doil_insert_operation(doil, &at, DOIL_SUB, q, x, i8);
+		if (s) q = doil_insert_operation(doil, &at, DOIL_SHR, q, doil_constant(s, u8), i8);
+		/* plus one when negative, to round toward zero */
+		reg_or_const sign = doil_insert_operation(doil, &at, DOIL_SHR, q, doil_constant(63, u8), u8);
+		q = doil_insert_operation(doil, &at, DOIL_ADD, q, sign, type);
+	}
+	doil_replace_uses(doil, ins->ope.dst, q);
+}
+
+/* identities and strength reduction of an operation with a constant right hand side */
+void
+doil_simplify(doil_t *doil, instruction_t *ins) {
+	doil_type_t type = ins->ope.type;
+	if (doil_is_comparison(ins->type)) {
+		/* a register compared with itself */
+		if (ins->ope.lhs.is_reg && ins->ope.rhs.is_reg && ins->ope.lhs.val.reg == ins->ope.rhs.val.reg) {
+			doil_replace_uses(doil, ins->ope.dst, doil_constant(ins->type == DOIL_LE || ins->type == DOIL_EQ, doil_bool));
+		}
+		return;
+	}
+	if (ins->type == DOIL_SUB && ins->ope.lhs.is_reg && ins->ope.rhs.is_reg && ins->ope.lhs.val.reg == ins->ope.rhs.val.reg) {
+		doil_replace_uses(doil, ins->ope.dst, doil_constant(0, type));
+		return;
+	}
+	if ((ins->type == DOIL_ADD || ins->type == DOIL_MUL) && !ins->ope.lhs.is_reg) {
+		reg_or_const tmp = ins->ope.lhs;
+		ins->ope.lhs = ins->ope.rhs;
+		ins->ope.rhs = tmp;
+	}
+	if (!ins->ope.lhs.is_reg || ins->ope.rhs.is_reg) return;
+	reg_or_const x = ins->ope.lhs;
+	unsigned long long c = doil_wrap(ins->ope.rhs.val.imm, type);
+	int pow2 = c && !(c & (c - 1));
+	switch (ins->type) {
+		case DOIL_ADD:
+		case DOIL_SUB:
+			if (c == 0) doil_copy(doil, ins, x);
+			break;
+		case DOIL_MUL:
+			if (c == 0) {
+				doil_replace_uses(doil, ins->ope.dst, doil_constant(0, type));
+			} else if (c == 1) {
+				doil_copy(doil, ins, x);
+			} else if (pow2) {
+				ins->type = DOIL_SHL;
+				ins->ope.rhs = doil_constant(__builtin_ctzll(c), type);
+				doil->optimized++;
+			}
+			break;
+		case DOIL_DIV:
+			/* the dividend has to be a value of the type already, the conversion isn't done here */
+			if (c == 1) {
+				doil_copy(doil, ins, x);
+			} else if (c == 0 || !doil_type_fits(doil->registers[x.val.reg].type, type)) {
+				break;
+			} else if (type.is_signed && c == ~0ull) {
+				ins->type = DOIL_SUB;
+				ins->ope.lhs = doil_constant(0, type);
+				ins->ope.rhs = x;
+				doil->optimized++;
+			} else if (type.is_signed && c == 1ull << 63) {
+				break;
+			} else if (!type.is_signed && pow2) {
+				ins->type = DOIL_SHR;
+				ins->ope.rhs = doil_constant(__builtin_ctzll(c), type);
+				doil->optimized++;
+			} else {
+				doil_divide_by_constant(doil, ins, x, c);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/* the largest value op can hold, as an unsigned 64 bits integer */
+unsigned long long
+doil_upper_bound(doil_t *doil, reg_or_const op, unsigned int depth) {
+	if (!op.is_reg) return op.val.imm;
+	reg_t *reg = &doil->registers[op.val.reg];
+	/* negative values are huge once unsigned, a signed register is only bounded by what computed it */
+	unsigned long long bound = reg->type.is_signed ? ~0ull : doil_positive_max(reg->type);
+	instruction_t *def = reg->def;
+	if (!depth || !def) return bound;
+	unsigned long long lhs, rhs, max;
+	switch (def->type) {
+		case DOIL_ADD:
+			/* nothing wraps around when both operands and their sum are positive values of the type */
+			max = doil_positive_max(def->ope.type);
+			lhs = doil_upper_bound(doil, def->ope.lhs, depth - 1);
+			rhs = doil_upper_bound(doil, def->ope.rhs, depth - 1);
+			if (lhs <= max && rhs <= max && lhs + rhs <= max && lhs + rhs < bound) bound = lhs + rhs;
+			break;
+		case DOIL_DIV:
+		case DOIL_SHR:
+			/* a positive value of the type, divided or shifted by a positive constant */
+			if (def->ope.rhs.is_reg) break;
+			max = doil_positive_max(def->ope.type);
+			lhs = doil_upper_bound(doil, def->ope.lhs, depth - 1);
+			rhs = doil_wrap(def->ope.rhs.val.imm, def->ope.type);
+			if (lhs > max || rhs > max) break;
+			if (def->type == DOIL_DIV && rhs) lhs /= rhs;
+			if (def->type == DOIL_SHR) lhs >>= rhs & 63;
+			if (lhs < bound) bound = lhs;
+			break;
+		case DOIL_CAST:
+			lhs = doil_upper_bound(doil, def->cast.src, depth - 1);
+			if (lhs <= doil_positive_max(def->cast.type) && lhs < bound) bound = lhs;
+			break;
+		case DOIL_LT:
+		case DOIL_LE:
+		case DOIL_EQ:
+		case DOIL_NE:
+			bound = 1;
+			break;
+		default:
+			break;
+	}
+	return bound;
+}
+
+/* the value every argument of a phi has, besides the phi itself, unused when they differ */
+reg_or_const
+doil_phi_value(instruction_t *phi) {
+	reg_or_const val = { .unused = 1 };
+	for (unsigned int i = 0; i < phi->phi.args_count; i++) {
+		reg_or_const arg = phi->phi.args[i];
+		if (arg.is_reg && arg.val.reg == phi->phi.dst) continue;
+		if (val.unused) val = arg;
+		else if (!doil_same_operand(val, arg)) return (reg_or_const){ .unused = 1 };
+	}
+	return val;
+}
+
+/* the br of a block only goes to target */
+void
+doil_fold_branch(doil_t *doil, instruction_t *ins, unsigned int target) {
+	unsigned int other = ins->jmp.target[ins->jmp.target[0] == target];
+	doil_remove_edge(doil, ins->jmp.block, other);
+	if (ins->jmp.cond.is_reg && --doil->registers[ins->jmp.cond.val.reg].uses_count == 0) doil_optimize_push(doil->registers[ins->jmp.cond.val.reg].def);
+	ins->type = DOIL_JMP;
+	ins->jmp.target[0] = target;
+	doil->optimized++;
+}
+
+/*
+ * constant propagation, copy propagation, dead code elimination
+ * and strength reduction over the ssa form, and the removal of the branches that are never
+ * taken with the blocks only they led to,
+ * an instruction is only looked at again when one of its operands or users changed
+ */
+void
+doil_optimize(doil_t *doil) {
+	doil->optimized = 0;
+	doil->optimize_passes++;
+	unsigned int count = 0;
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) count++;
+	/* doil_number_values leaves the users of what it replaced queued */
+	while (work_count) work[--work_count]->queued = 0;
+	/* pushed backwards, so the first sweep goes in program order */
+	instruction_t **all = malloc(sizeof(instruction_t *) * (count + 1));
+	count = 0;
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) all[count++] = ins;
+	while (count) doil_optimize_push(all[--count]);
+	free(all);
+
+	while (work_count) {
+		instruction_t *ins = work[--work_count];
+		ins->queued = 0;
+		if (ins->dead) continue;
+		doil->optimize_iterations++;
+		switch (ins->type) {
+			case DOIL_ADD:
+			case DOIL_SUB:
+			case DOIL_MUL:
+			case DOIL_DIV:
+			case DOIL_SHL:
+			case DOIL_SHR:
+			case DOIL_MULH:
+			case DOIL_LT:
+			case DOIL_LE:
+			case DOIL_EQ:
+			case DOIL_NE:
+				if (ins->ope.lhs.is_reg || ins->ope.rhs.is_reg) {
+					doil_simplify(doil, ins);
+					break;
+				}
+				/* as a constant index out of the bounds, it's only refused once it's known to be reached */
+				if (ins->type == DOIL_DIV && doil_division_error(ins)) break;
+				ins->mov.val = doil_perform_operation(ins, ins->type);
+				doil->optimized++;
+				/* fallthrough */
+			case DOIL_MOV:
+				doil_replace_uses(doil, ins->mov.reg, ins->mov.val);
+				break;
+			case DOIL_CAST:
+				if (!ins->cast.src.is_reg) {
+					doil_replace_uses(doil, ins->cast.dst, doil_constant(doil_wrap(ins->cast.src.val.imm, ins->cast.type), ins->cast.type));
+				} else if (doil_type_fits(doil->registers[ins->cast.src.val.reg].type, ins->cast.type)) {
+					doil_replace_uses(doil, ins->cast.dst, ins->cast.src);
+				}
+				break;
+			case DOIL_DEF:
+				if (ids[ins->def.var].use_amount == 0 && ids[ins->def.var].set_amount == 0) doil_kill(doil, ins);
+				break;
+			case DOIL_CHECK:
+				/* a constant index out of the bounds is only refused once it's known to be reached */
+				if (ins->check.len.is_reg) break;
+				if (doil_upper_bound(doil, ins->check.idx, 8) < ins->check.len.val.imm) doil_kill(doil, ins);
+				break;
+			case DOIL_PHI: {
+				reg_or_const val = doil_phi_value(ins);
+				if (!val.unused) doil_replace_uses(doil, ins->phi.dst, val);
+				break;
+			}
+			case DOIL_BR:
+				if (!ins->jmp.cond.is_reg)                        doil_fold_branch(doil, ins, ins->jmp.target[!ins->jmp.cond.val.imm]);
+				else if (ins->jmp.target[0] == ins->jmp.target[1]) doil_fold_branch(doil, ins, ins->jmp.target[0]);
+				break;
+			default:
+				break;
+		}
+		/* after the switch, simplifying may have changed what ins is, a call is made even when its value isn't used */
+		unsigned int *dst = doil_defined_register(ins);
+		if (dst && doil->registers[*dst].uses_count == 0 && ins->type != DOIL_CALL) doil_kill(doil, ins);
+		if (!work_count && doil_prune_blocks(doil, 1)) doil->optimized++;
+	}
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) {
+		const char *error;
+		if (!ins->dead && ins->type == DOIL_DIV && !ins->ope.lhs.is_reg && !ins->ope.rhs.is_reg && (error = doil_division_error(ins))) {
+			fprintf(stderr, "%s\n", error);
+			exit(1);
+		}
+		if (ins->dead || ins->type != DOIL_CHECK || ins->check.idx.is_reg || ins->check.len.is_reg) continue;
+		identifier_t *var = &ids[ins->check.var];
+		fprintf(stderr, "ERROR: index %lld is out of the bounds of '%.*s'\n", (long long)ins->check.idx.val.imm, var->siz, var->str);
+		exit(1);
+	}
+
+	doil_layout_blocks(doil);
+	free(work);
+	work = NULL;
+	work_cap = 0;
+}
+
+/*
+ * the immediate dominator of every block, iterating over the reverse postorder as Cooper, Harvey
+ * and Kennedy do. the entry is its own.
+ */
+void
+doil_dominators(doil_t *doil, unsigned int *idom) {
+	unsigned int n = doil->blocks_count, count = 0, top = 0;
+	unsigned int *order = malloc(sizeof(unsigned int) * (n + 1)); /* postorder */
+	unsigned int *number = malloc(sizeof(unsigned int) * (n + 1)); /* in the postorder */
+	unsigned int *stack = malloc(sizeof(unsigned int) * (n + 1));
+	unsigned int *next = calloc(n + 1, sizeof(unsigned int)); /* the successor to visit */
+	unsigned char *seen = calloc(n + 1, 1);
+	seen[0] = 1;
+	stack[top++] = 0;
+	while (top) {
+		unsigned int b = stack[top - 1];
+		if (next[b] < doil->blocks[b].succs_count) {
+			unsigned int s = doil->blocks[b].succs[next[b]++];
+			if (!seen[s]) {
+				seen[s] = 1;
+				stack[top++] = s;
+			}
+			continue;
+		}
+		top--;
+		number[b] = count;
+		order[count++] = b;
+	}
+	for (unsigned int b = 0; b < n; b++) idom[b] = DOIL_NO_BLOCK;
+	idom[0] = 0;
+	for (int changed = 1; changed;) {
+		changed = 0;
+		/* the entry is the last one of the postorder */
+		for (unsigned int k = count - 1; k--;) {
+			unsigned int b = order[k], dom = DOIL_NO_BLOCK;
+			for (unsigned int i = 0; i < doil->blocks[b].preds_count; i++) {
+				unsigned int p = doil->blocks[b].preds[i];
+				if (!seen[p] || idom[p] == DOIL_NO_BLOCK) continue;
+				if (dom == DOIL_NO_BLOCK) {
+					dom = p;
+					continue;
+				}
+				while (p != dom) {
+					while (number[p] < number[dom]) p = idom[p];
+					while (number[dom] < number[p]) dom = idom[dom];
+				}
+			}
+			if (idom[b] == dom) continue;
+			idom[b] = dom;
+			changed = 1;
+		}
+	}
+	free(order);
+	free(number);
+	free(stack);
+	free(next);
+	free(seen);
+}
+
+int
+doil_dominates(unsigned int *idom, unsigned int a, unsigned int b) {
+	while (b != a && b != 0 && b != DOIL_NO_BLOCK) b = idom[b];
+	return b == a;
+}
+
+/* how many instructions an unrolled loop can have, and how many times a loop is run to count them */
+#define DOIL_UNROLL_SIZE 128
+#define DOIL_UNROLL_TRIPS 65536
+
+/* a natural loop, the blocks from which its header is reached again without leaving it */
+typedef struct {
+	unsigned int header;
+	unsigned int *blocks; /* the header first */
+	unsigned int blocks_count;
+} doil_loop_t;
+
+int
+doil_loop_compare(const void *a, const void *b) {
+	const doil_loop_t *lhs = a, *rhs = b;
+	return (lhs->blocks_count > rhs->blocks_count) - (lhs->blocks_count < rhs->blocks_count);
+}
+
+/* what the loop passes share, mark holds the stamp of the loop being looked at for its blocks */
+typedef struct {
+	doil_t *doil;
+	unsigned int *mark; /* per block */
+	unsigned int stamp;
+	unsigned int *def_block; /* per register, of the registers there were before unrolling */
+	unsigned int def_count;
+	unsigned int *set; /* per variable, the stamp of the loop setting it */
+	/* to run the loop while it is unrolled */
+	unsigned long long *value; /* per register */
+	unsigned int *known; /* per register, the iteration + 1 the value is of */
+	unsigned int iteration;
+} doil_loops_t;
+
+void
+doil_mark_loop(doil_loops_t *loops, doil_loop_t *loop) {
+	loops->stamp++;
+	for (unsigned int k = 0; k < loop->blocks_count; k++) loops->mark[loop->blocks[k]] = loops->stamp;
+}
+
+int
+doil_in_loop(doil_loops_t *loops, unsigned int reg) {
+	if (reg >= loops->def_count || loops->def_block[reg] == DOIL_NO_BLOCK) return 0;
+	return loops->mark[loops->def_block[reg]] == loops->stamp;
+}
+
+/* computes the same value anywhere in the loop while its operands don't change, and can't trap */
+int
+doil_invariant(doil_loops_t *loops, instruction_t *ins, int calls) {
+	reg_or_const *op;
+	switch (ins->type) {
+		case DOIL_ADD:
+		case DOIL_SUB:
+		case DOIL_MUL:
+		case DOIL_SHL:
+		case DOIL_SHR:
+		case DOIL_MULH:
+		case DOIL_LT:
+		case DOIL_LE:
+		case DOIL_EQ:
+		case DOIL_NE:
+		case DOIL_CAST:
+			break;
+		case DOIL_DIV: {
+			unsigned long long d = doil_wrap(ins->ope.rhs.val.imm, ins->ope.type);
+			if (ins->ope.rhs.is_reg || !d || (ins->ope.type.is_signed && d == ~0ull)) return 0;
+			break;
+		}
+		case DOIL_GET:
+			/* the systems it calls can set the global variables */
+			if (calls || loops->set[ins->get.var] == loops->stamp) return 0;
+			break;
+		default:
+			return 0;
+	}
+	for (unsigned int k = 0; (op = doil_operand(ins, k)); k++) {
+		if (op->is_reg && doil_in_loop(loops, op->val.reg)) return 0;
+	}
+	return 1;
+}
+
+/* moves what doesn't change in the loop to the end of the only block that goes into it */
+unsigned int
+doil_hoist(doil_loops_t *loops, doil_loop_t *loop) {
+	doil_t *doil = loops->doil;
+	block_t *header = &doil->blocks[loop->header];
+	unsigned int pre = DOIL_NO_BLOCK, hoisted = 0;
+	int calls = 0;
+	for (unsigned int i = 0; i < header->preds_count; i++) {
+		if (loops->mark[header->preds[i]] == loops->stamp) continue;
+		if (pre != DOIL_NO_BLOCK) return 0;
+		pre = header->preds[i];
+	}
+	if (pre == DOIL_NO_BLOCK || doil->blocks[pre].succs_count != 1) return 0;
+	for (unsigned int k = 0; k < loop->blocks_count; k++) {
+		block_t *blk = &doil->blocks[loop->blocks[k]];
+		for (instruction_t *ins = blk->head; ins != blk->tail; ins = ins->nxt) {
+			if (ins->type == DOIL_CALL) calls = 1;
+			if (ins->type == DOIL_SET && !ins->set.dst.is_reg) loops->set[ins->set.dst.val.var] = loops->stamp;
+		}
+	}
+	instruction_t *at = doil->blocks[pre].head;
+	while (at->nxt != doil->blocks[pre].tail) at = at->nxt;
+	/* what was hoisted can make what uses it invariant, even in a block before */
+	for (int changed = 1; changed;) {
+		changed = 0;
+		for (unsigned int k = 0; k < loop->blocks_count; k++) {
+			block_t *blk = &doil->blocks[loop->blocks[k]];
+			instruction_t *prv = blk->head, *nxt;
+			for (instruction_t *ins = blk->head->nxt; ins != blk->tail; ins = nxt) {
+				nxt = ins->nxt;
+				if (!doil_invariant(loops, ins, calls)) {
+					prv = ins;
+					continue;
+				}
+				prv->nxt = nxt;
+				ins->nxt = at->nxt;
+				at->nxt = ins;
+				at = ins;
+				loops->def_block[*doil_defined_register(ins)] = pre;
+				hoisted++;
+				changed = 1;
+			}
+		}
+	}
+	return hoisted;
+}
+
+/* the value op has in the current iteration of the loop being unrolled, 0 when it can't be told */
+int
+doil_evaluate(doil_loops_t *loops, reg_or_const op, unsigned long long *val) {
+	if (!op.is_reg) {
+		*val = op.val.imm;
+		return 1;
+	}
+	unsigned int reg = op.val.reg;
+	if (loops->known[reg] == loops->iteration + 1) {
+		*val = loops->value[reg];
+		return 1;
+	}
+	if (!doil_in_loop(loops, reg)) return 0;
+	instruction_t *def = loops->doil->registers[reg].def, tmp = *def;
+	unsigned long long lhs, rhs;
+	switch (def->type) {
+		case DOIL_ADD:
+		case DOIL_SUB:
+		case DOIL_MUL:
+		case DOIL_LT:
+		case DOIL_LE:
+		case DOIL_EQ:
+		case DOIL_NE:
+			if (!doil_evaluate(loops, def->ope.lhs, &lhs) || !doil_evaluate(loops, def->ope.rhs, &rhs)) return 0;
+			tmp.ope.lhs = doil_constant(lhs, def->ope.type);
+			tmp.ope.rhs = doil_constant(rhs, def->ope.type);
+			*val = doil_perform_operation(&tmp, def->type).val.imm;
+			break;
+		case DOIL_CAST:
+			if (!doil_evaluate(loops, def->cast.src, &lhs)) return 0;
+			*val = doil_wrap(lhs, def->cast.type);
+			break;
+		default:
+			return 0;
+	}
+	loops->value[reg] = *val;
+	loops->known[reg] = loops->iteration + 1;
+	return 1;
+}
+
+/* a copy of ins after *after, with the operands map has for its registers, its own register goes in map */
+void
+doil_clone(doil_t *doil, instruction_t **after, instruction_t *ins, reg_or_const *map) {
+	instruction_t *copy = arena_alloc(&doil_arena, sizeof(instruction_t));
+	reg_or_const *op;
+	*copy = *ins;
+	copy->queued = 0;
+	if (ins->type == DOIL_CALL) {
+		copy->call.args = arena_alloc(&doil_arena, sizeof(reg_or_const) * (ins->call.args_count + 1));
+		memcpy(copy->call.args, ins->call.args, sizeof(reg_or_const) * ins->call.args_count);
+	}
+	for (unsigned int k = 0; (op = doil_operand(copy, k)); k++) {
+		if (!op->is_reg) continue;
+		*op = map[op->val.reg];
+		if (op->is_reg) doil_add_use(doil, op->val.reg, copy);
+	}
+	unsigned int *dst = doil_defined_register(copy);
+	if (dst) {
+		doil_type_t type = doil->registers[*dst].type;
+		unsigned int reg = doil_new_register(doil, type, copy);
+		map[*dst] = (reg_or_const){ .val.reg = reg, .is_reg = 1 };
+		*dst = reg;
+	}
+	if (copy->type == DOIL_GET) ids[copy->get.var].use_amount++;
+	if (copy->type == DOIL_SET && !copy->set.dst.is_reg) ids[copy->set.dst.val.var].set_amount++;
+	copy->nxt = (*after)->nxt;
+	(*after)->nxt = copy;
+	*after = copy;
+}
+
+/*
+ * one more run of the header and the body of a loop after *after, from the first instruction of
+ * the header after its phis to the last one of the body before its jmp. the phis have the values
+ * in phi_value and get the ones they have at the end of it.
+ */
+void
+doil_clone_iteration(doil_t *doil, instruction_t **after, block_t *header, instruction_t *first, block_t *body, instruction_t *last, instruction_t **phis, unsigned int phis_count, unsigned int back, reg_or_const *phi_value, reg_or_const *map) {
+	for (unsigned int j = 0; j < phis_count; j++) map[phis[j]->phi.dst] = phi_value[j];
+	for (instruction_t *ins = first; ins != header->tail; ins = ins->nxt) doil_clone(doil, after, ins, map);
+	for (instruction_t *ins = body->head; ins != last;) {
+		ins = ins->nxt;
+		doil_clone(doil, after, ins, map);
+	}
+	for (unsigned int j = 0; j < phis_count; j++) {
+		reg_or_const arg = phis[j]->phi.args[back];
+		phi_value[j] = arg.is_reg ? map[arg.val.reg] : arg;
+	}
+}
+
+/*
+ * a loop of a header and a body which runs a number of times known when compiling is unrolled
+ * entirely when it runs at most unroll_factor times, else its body does as many iterations as it
+ * can of those, so the header is still right about when to leave.
+ */
+unsigned int
+doil_unroll(doil_loops_t *loops, doil_loop_t *loop) {
+	doil_t *doil = loops->doil;
+	if (loop->blocks_count != 2) return 0;
+	unsigned int h = loop->header, b = loop->blocks[1], back = 0, trips;
+	block_t *header = &doil->blocks[h], *body = &doil->blocks[b];
+	instruction_t *br = header->tail;
+	if (br->type != DOIL_BR || header->preds_count != 2 || body->tail->type != DOIL_JMP) return 0;
+	if (body->head->nxt->type == DOIL_PHI || br->jmp.target[0] == br->jmp.target[1]) return 0;
+	unsigned int exit = br->jmp.target[br->jmp.target[0] == b];
+	while (header->preds[back] != b) back++;
+
+	unsigned int phis_count = 0, size = 0;
+	instruction_t *last_phi = header->head, *last = body->head;
+	for (instruction_t *ins = header->head->nxt; ins != br; ins = ins->nxt) {
+		if (ins->type == DOIL_PHI) last_phi = ins, phis_count++;
+		else                       size++;
+	}
+	for (instruction_t *ins = body->head->nxt; ins != body->tail; ins = ins->nxt) last = ins, size++;
+	if (size * 2 > DOIL_UNROLL_SIZE) return 0;
+	instruction_t **phis = malloc(sizeof(instruction_t *) * (phis_count + 1));
+	reg_or_const *phi_value = malloc(sizeof(reg_or_const) * (phis_count + 1));
+	unsigned char *phi_known = malloc(phis_count + 1);
+	phis_count = 0;
+	for (instruction_t *ins = header->head->nxt; ins->type == DOIL_PHI; ins = ins->nxt) phis[phis_count++] = ins;
+
+	/* the loop is run until the header leaves it, with the phis that start as constants */
+	loops->value = malloc(sizeof(unsigned long long) * (doil->registers_count + 1));
+	loops->known = calloc(doil->registers_count + 1, sizeof(unsigned int));
+	for (unsigned int j = 0; j < phis_count; j++) {
+		phi_value[j] = phis[j]->phi.args[!back];
+		phi_known[j] = !phi_value[j].is_reg;
+	}
+	for (trips = 0; trips <= DOIL_UNROLL_TRIPS; trips++) {
+		unsigned long long cond;
+		loops->iteration = trips;
+		for (unsigned int j = 0; j < phis_count; j++) {
+			if (!phi_known[j]) continue;
+			loops->value[phis[j]->phi.dst] = phi_value[j].val.imm;
+			loops->known[phis[j]->phi.dst] = trips + 1;
+		}
+		if (!doil_evaluate(loops, br->jmp.cond, &cond)) {
+			trips = DOIL_UNROLL_TRIPS + 1;
+			break;
+		}
+		if (!cond != (br->jmp.target[0] != b)) break;
+		for (unsigned int j = 0; j < phis_count; j++) {
+			if (phi_known[j]) phi_known[j] = doil_evaluate(loops, phis[j]->phi.args[back], &phi_value[j].val.imm);
+		}
+	}
+	free(loops->value);
+	free(loops->known);
+
+	unsigned int times = 0, entirely = trips <= DOIL_UNROLL_TRIPS && trips <= unroll_factor && (trips + 1) * size <= DOIL_UNROLL_SIZE;
+	for (unsigned int u = unroll_factor; !entirely && trips <= DOIL_UNROLL_TRIPS && u >= 2 && !times; u--) {
+		if (trips % u == 0 && u * size <= DOIL_UNROLL_SIZE) times = u;
+	}
+	if (entirely) {
+		/* straight through the header, which leaves after the last iteration */
+		reg_or_const *map = malloc(sizeof(reg_or_const) * (doil->registers_count + 1));
+		for (unsigned int r = 0; r < doil->registers_count; r++) map[r] = (reg_or_const){ .val.reg = r, .is_reg = 1 };
+		for (unsigned int j = 0; j < phis_count; j++) phi_value[j] = phis[j]->phi.args[!back];
+		instruction_t *at = last_phi, *first = last_phi->nxt;
+		for (unsigned int k = 0; k < trips; k++) doil_clone_iteration(doil, &at, header, first, body, last, phis, phis_count, back, phi_value, map);
+		/* the body is gone before the phis are replaced, it would read their values after the last iteration */
+		doil_fold_branch(doil, br, exit);
+		doil_prune_blocks(doil, 1);
+		for (unsigned int j = 0; j < phis_count; j++) {
+			doil_replace_uses(doil, phis[j]->phi.dst, phi_value[j]);
+			doil_kill(doil, phis[j]);
+		}
+		free(map);
+	} else if (times) {
+		/* the first iteration is the body as it is */
+		reg_or_const *map = malloc(sizeof(reg_or_const) * (doil->registers_count + 1));
+		for (unsigned int r = 0; r < doil->registers_count; r++) map[r] = (reg_or_const){ .val.reg = r, .is_reg = 1 };
+		for (unsigned int j = 0; j < phis_count; j++) phi_value[j] = phis[j]->phi.args[back];
+		instruction_t *at = last;
+		for (unsigned int k = 1; k < times; k++) doil_clone_iteration(doil, &at, header, last_phi->nxt, body, last, phis, phis_count, back, phi_value, map);
+		for (unsigned int j = 0; j < phis_count; j++) {
+			reg_or_const *arg = &phis[j]->phi.args[back];
+			if (arg->is_reg) doil->registers[arg->val.reg].uses_count--;
+			*arg = phi_value[j];
+			if (arg->is_reg) doil_add_use(doil, arg->val.reg, phis[j]);
+		}
+		doil->optimized++;
+		free(map);
+	}
+	free(phis);
+	free(phi_value);
+	free(phi_known);
+	return entirely || times;
+}
+
+/* hoists what doesn't change out of the loops, then unrolls the small ones, returns how much it changed */
+unsigned int
+doil_optimize_loops(doil_t *doil) {
+	unsigned int n = doil->blocks_count, changed = 0, loops_count = 0;
+	if (n < 2) return 0;
+	unsigned int *idom = malloc(sizeof(unsigned int) * (n + 1));
+	doil_dominators(doil, idom);
+
+	doil_loops_t loops = { .doil = doil };
+	loops.mark = calloc(n + 1, sizeof(unsigned int));
+	loops.set = calloc(ids_count + 1, sizeof(unsigned int));
+	loops.def_count = doil->registers_count;
+	loops.def_block = malloc(sizeof(unsigned int) * (loops.def_count + 1));
+	for (unsigned int r = 0; r < loops.def_count; r++) loops.def_block[r] = DOIL_NO_BLOCK;
+	for (instruction_t *ins = doil->hins, *label = NULL; ins; ins = ins->nxt) {
+		if (ins->type == DOIL_LABEL) label = ins;
+		unsigned int *dst = doil_defined_register(ins);
+		if (dst && label) loops.def_block[*dst] = label->label.block;
+	}
+
+	/* a loop for every header, with the blocks of all the edges going back to it */
+	doil_loop_t *loop = malloc(sizeof(doil_loop_t) * (n + 1));
+	unsigned int *stack = malloc(sizeof(unsigned int) * (n + 1));
+	for (unsigned int h = 0; h < n; h++) {
+		block_t *header = &doil->blocks[h];
+		unsigned int count = 0;
+		loops.stamp++;
+		loops.mark[h] = loops.stamp;
+		for (unsigned int i = 0; i < header->preds_count; i++) {
+			unsigned int p = header->preds[i];
+			if (!doil_dominates(idom, h, p) || loops.mark[p] == loops.stamp) continue;
+			loops.mark[p] = loops.stamp;
+			stack[count++] = p;
+		}
+		if (!count) continue;
+		doil_loop_t *l = &loop[loops_count++];
+		l->header = h;
+		l->blocks = malloc(sizeof(unsigned int) * (n + 1));
+		l->blocks[0] = h;
+		l->blocks_count = 1;
+		while (count) {
+			unsigned int b = stack[--count];
+			l->blocks[l->blocks_count++] = b;
+			for (unsigned int i = 0; i < doil->blocks[b].preds_count; i++) {
+				unsigned int p = doil->blocks[b].preds[i];
+				if (loops.mark[p] == loops.stamp) continue;
+				loops.mark[p] = loops.stamp;
+				stack[count++] = p;
+			}
+		}
+	}
+	/* the inner loops first, what they hoist can then leave the outer ones as well */
+	qsort(loop, loops_count, sizeof(doil_loop_t), doil_loop_compare);
+	for (unsigned int k = 0; k < loops_count; k++) {
+		doil_mark_loop(&loops, &loop[k]);
+		changed += doil_hoist(&loops, &loop[k]);
+	}
+	if (unroll_factor > 1) {
+		for (unsigned int k = 0; k < loops_count; k++) {
+			doil_mark_loop(&loops, &loop[k]);
+			changed += doil_unroll(&loops, &loop[k]);
+		}
+	}
+	for (unsigned int k = 0; k < loops_count; k++) free(loop[k].blocks);
+	free(loop);
+	free(stack);
+	free(idom);
+	free(loops.mark);
+	free(loops.set);
+	free(loops.def_block);
+	return changed;
+}
+
+/* what an instruction computes, instructions with the same value compute the same thing */
+typedef struct {
+	unsigned int type;
+	reg_or_const lhs;
+	reg_or_const rhs;
+	doil_type_t datatype;
+	unsigned int version; /* of the variable read by a get, bumped by every set to it */
+	unsigned int block; /* + 1, of a get, the other blocks can set the variable before it */
+	instruction_t *ins;
+	unsigned int nxt; /* index + 1 of the next value in the same bucket */
+} doil_value_t;
+
+int
+doil_same_operand(reg_or_const a, reg_or_const b) {
+	if (a.is_reg != b.is_reg || a.is_var != b.is_var) return 0;
+	if (a.is_reg) return a.val.reg == b.val.reg;
+	if (a.is_var) return a.val.var == b.val.var;
+	return a.val.imm == b.val.imm && a.type.siz == b.type.siz && a.type.is_signed == b.type.is_signed;
+}
+
+/* registers first, then constants, so both orders of a commutative operation look the same */
+int
+doil_operand_before(reg_or_const a, reg_or_const b) {
+	if (a.is_reg != b.is_reg) return a.is_reg;
+	return a.is_reg ? a.val.reg < b.val.reg : a.val.imm < b.val.imm;
+}
+
+unsigned long long
+doil_operand_hash(reg_or_const op) {
+	unsigned long long h = op.is_reg ? op.val.reg : op.is_var ? op.val.var : op.val.imm;
+	return h * 31 + (op.is_reg << 1 | op.is_var);
+}
+
+/* 0 when the instruction isn't a pure computation */
+int
+doil_value(instruction_t *ins, unsigned int *versions, doil_value_t *value) {
+	*value = (doil_value_t){ .type = ins->type, .ins = ins };
+	switch (ins->type) {
+		case DOIL_ADD:
+		case DOIL_MUL:
+		case DOIL_MULH:
+		case DOIL_EQ:
+		case DOIL_NE:
+			value->lhs = ins->ope.lhs;
+			value->rhs = ins->ope.rhs;
+			if (doil_operand_before(ins->ope.rhs, ins->ope.lhs)) {
+				value->lhs = ins->ope.rhs;
+				value->rhs = ins->ope.lhs;
+			}
+			value->datatype = ins->ope.type;
+			return 1;
+		case DOIL_SUB:
+		case DOIL_DIV:
+		case DOIL_SHL:
+		case DOIL_SHR:
+		case DOIL_LT:
+		case DOIL_LE:
+			value->lhs = ins->ope.lhs;
+			value->rhs = ins->ope.rhs;
+			value->datatype = ins->ope.type;
+			return 1;
+		case DOIL_CAST:
+			value->lhs = ins->cast.src;
+			value->datatype = ins->cast.type;
+			return 1;
+		case DOIL_GET:
+			value->lhs = doil_variable(ins->get.var);
+			value->version = versions[ins->get.var];
+			return 1;
+		case DOIL_CHECK:
+			/* checks don't compute anything, but the same one twice is useless */
+			value->lhs = ins->check.idx;
+			value->rhs = ins->check.len;
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+unsigned long long
+doil_value_hash(doil_value_t *value) {
+	unsigned long long h = value->type;
+	h = h * 0x100000001b3ull ^ doil_operand_hash(value->lhs);
+	h = h * 0x100000001b3ull ^ doil_operand_hash(value->rhs);
+	h = h * 0x100000001b3ull ^ (value->datatype.siz << 1 | value->datatype.is_signed);
+	h = h * 0x100000001b3ull ^ value->version;
+	h = h * 0x100000001b3ull ^ value->block;
+	return h;
+}
+
+int
+doil_same_value(doil_value_t *a, doil_value_t *b) {
+	return a->type == b->type && doil_same_operand(a->lhs, b->lhs) && doil_same_operand(a->rhs, b->rhs) &&
+	       a->datatype.siz == b->datatype.siz && a->datatype.is_signed == b->datatype.is_signed && a->version == b->version && a->block == b->block;
+}
+
+/*
+ * value numbering over the dominator tree: an instruction computing a value that one of a block
+ * dominating it already computed is replaced by the register of the earlier one. the values of a
+ * block are forgotten once the blocks it dominates are done. gets of a variable are the same value
+ * until the next set to it in their block only, and the length of a slice is the one of the array
+ * last assigned to it in the block, which lets doil_optimize drop the checks against it.
+ * returns how many instructions were removed, doil_optimize has to run again to clean up after them.
+ */
+unsigned int
+doil_number_values(doil_t *doil) {
+	unsigned int count = 0, removed = 0, n = doil->blocks_count;
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) count++;
+	unsigned int shift = 64 - 1, cap = 2;
+	while (cap < count * 2) {
+		cap *= 2;
+		shift--;
+	}
+	/* the values are a stack, the ones of a block are on top of the ones of the blocks dominating it */
+	doil_value_t *values = malloc(sizeof(doil_value_t) * (count + 1));
+	unsigned int *buckets = calloc(cap, sizeof(unsigned int)), values_count = 0;
+	unsigned int *versions = calloc(ids_count + 1, sizeof(unsigned int));
+	unsigned int *lengths = calloc(ids_count + 1, sizeof(unsigned int));
+	/* what is in lengths is only known in the block it was stored by, the block + 1 */
+	unsigned int *length_stamps = calloc(ids_count + 1, sizeof(unsigned int));
+
+	unsigned int *idom = malloc(sizeof(unsigned int) * (n + 1));
+	unsigned int *child = malloc(sizeof(unsigned int) * (n + 1)), *sibling = malloc(sizeof(unsigned int) * (n + 1));
+	unsigned int *stack = malloc(sizeof(unsigned int) * (n * 2 + 1)), *mark = malloc(sizeof(unsigned int) * (n + 1)), top = 0;
+	doil_dominators(doil, idom);
+	for (unsigned int b = 0; b < n; b++) child[b] = DOIL_NO_BLOCK;
+	for (unsigned int b = n; b-- > 1;) {
+		if (idom[b] == DOIL_NO_BLOCK || !doil->blocks[b].head) continue;
+		sibling[b] = child[idom[b]];
+		child[idom[b]] = b;
+	}
+	/* a block is pushed as itself to be numbered, and as ~block to drop its values */
+	stack[top++] = 0;
+	while (top) {
+		unsigned int b = stack[--top];
+		if (b & 1u << 31) {
+			for (b = ~b; values_count > mark[b];) {
+				doil_value_t *value = &values[--values_count];
+				unsigned int i = (doil_value_hash(value) * 11400714819323198485ull) >> shift;
+				buckets[i] = value->nxt;
+			}
+			continue;
+		}
+		mark[b] = values_count;
+		stack[top++] = ~b;
+		for (unsigned int c = child[b]; c != DOIL_NO_BLOCK; c = sibling[c]) stack[top++] = c;
+		block_t *blk = &doil->blocks[b];
+		for (instruction_t *ins = blk->head->nxt, *end = blk->tail->nxt; ins != end; ins = ins->nxt) {
+			if (ins->dead) continue;
+			if (ins->type == DOIL_SET && !ins->set.dst.is_reg) {
+				versions[ins->set.dst.val.var]++;
+				continue;
+			}
+			if (ins->type == DOIL_SLICE) {
+				lengths[ins->slice.dst] = ids[ins->slice.src].length;
+				length_stamps[ins->slice.dst] = b + 1;
+				continue;
+			}
+			if (ins->type == DOIL_CALL) {
+				/* the system can set any variable */
+				for (unsigned int i = 0; i < ids_count; i++) versions[i]++;
+				memset(length_stamps, 0, sizeof(unsigned int) * (ids_count + 1));
+				continue;
+			}
+			if (ins->type == DOIL_LENGTH && length_stamps[ins->get.var] == b + 1) {
+				doil_replace_uses(doil, ins->get.reg, doil_constant(lengths[ins->get.var], doil->registers[ins->get.reg].type));
+				doil_kill(doil, ins);
+				removed++;
+				continue;
+			}
+			doil_value_t value;
+			if (!doil_value(ins, versions, &value)) continue;
+			if (ins->type == DOIL_GET) value.block = b + 1;
+			unsigned int i = (doil_value_hash(&value) * 11400714819323198485ull) >> shift, at = buckets[i];
+			while (at && !doil_same_value(&values[at - 1], &value)) at = values[at - 1].nxt;
+			if (!at) {
+				value.nxt = buckets[i];
+				values[values_count++] = value;
+				buckets[i] = values_count;
+				continue;
+			}
+			unsigned int *dst = doil_defined_register(ins);
+			if (dst) doil_replace_uses(doil, *dst, (reg_or_const){ .val.reg = *doil_defined_register(values[at - 1].ins), .is_reg = 1 });
+			doil_kill(doil, ins);
+			removed++;
+		}
+	}
+	free(values);
+	free(buckets);
+	free(versions);
+	free(lengths);
+	free(length_stamps);
+	free(idom);
+	free(child);
+	free(sibling);
+	free(stack);
+	free(mark);
+	return removed;
+}
+
+/*
+ * the exclusive bound a branch taken only when reg is below a constant puts on it in block: the
+ * smallest one of the lt or le of reg and a constant ending a block whose true edge is the only way
+ * into a block dominating it. 0 when there isn't one, with *is_unsigned set when the comparison
+ * was unsigned, then reg can't be negative either.
+ */
+unsigned long long
+doil_guard_bound(doil_t *doil, unsigned int *idom, unsigned int block, unsigned int reg, int *is_unsigned) {
+	unsigned long long bound = 0;
+	for (unsigned int b = block;; b = idom[b]) {
+		block_t *blk = &doil->blocks[b];
+		if (blk->preds_count == 1) {
+			instruction_t *br = doil->blocks[blk->preds[0]].tail, *cmp;
+			if (br->type == DOIL_BR && br->jmp.cond.is_reg && br->jmp.target[0] == b && br->jmp.target[1] != b &&
+			    (cmp = doil->registers[br->jmp.cond.val.reg].def) && (cmp->type == DOIL_LT || cmp->type == DOIL_LE) &&
+			    cmp->ope.lhs.is_reg && cmp->ope.lhs.val.reg == reg && !cmp->ope.rhs.is_reg &&
+			    (doil->registers[reg].type.siz == cmp->ope.type.siz || doil_type_fits(doil->registers[reg].type, cmp->ope.type))) {
+				unsigned long long n = doil_wrap(cmp->ope.rhs.val.imm, cmp->ope.type);
+				if (n < doil_positive_max(cmp->ope.type) && n < doil_positive_max(doil->registers[reg].type)) {
+					n += cmp->type == DOIL_LE;
+					if (!bound || n < bound) bound = n;
+					if (!cmp->ope.type.is_signed) *is_unsigned = 1;
+				}
+			}
+		}
+		if (b == 0 || idom[b] == DOIL_NO_BLOCK) break;
+	}
+	return bound;
+}
+
+/*
+ * whether the phi reg counts up from positive constants, adding a positive constant to itself
+ * only where a branch keeps it below a bound, so it can't wrap around to a negative value
+ */
+int
+doil_counts_up(doil_t *doil, unsigned int *idom, unsigned int *where, unsigned int reg) {
+	instruction_t *phi = doil->registers[reg].def;
+	if (!phi || phi->type != DOIL_PHI) return 0;
+	doil_type_t type = doil->registers[reg].type;
+	for (unsigned int i = 0; i < phi->phi.args_count; i++) {
+		reg_or_const arg = phi->phi.args[i];
+		if (!arg.is_reg) {
+			if (doil_wrap(arg.val.imm, type) > doil_positive_max(type)) return 0;
+			continue;
+		}
+		if (arg.val.reg == reg) continue;
+		instruction_t *def = doil->registers[arg.val.reg].def;
+		unsigned long long max = doil_positive_max(type);
+		if (def && def->type == DOIL_CAST && def->cast.src.is_reg) {
+			if (doil_positive_max(def->cast.type) < max) max = doil_positive_max(def->cast.type);
+			def = doil->registers[def->cast.src.val.reg].def;
+		}
+		if (!def || def->type != DOIL_ADD) return 0;
+		reg_or_const step = def->ope.rhs;
+		if (def->ope.rhs.is_reg && def->ope.rhs.val.reg == reg) step = def->ope.lhs;
+		else if (!def->ope.lhs.is_reg || def->ope.lhs.val.reg != reg) return 0;
+		if (step.is_reg) return 0;
+		if (doil_positive_max(def->ope.type) < max) max = doil_positive_max(def->ope.type);
+		unsigned long long c = doil_wrap(step.val.imm, def->ope.type);
+		int is_unsigned = 0;
+		unsigned long long bound = doil_guard_bound(doil, idom, where[def->ope.dst], reg, &is_unsigned);
+		/* below the bound, and not negative as long as every value before was not */
+		if (!bound || c > max || bound - 1 > max - c) return 0;
+	}
+	return 1;
+}
+
+/*
+ * drops the checks of an index a dominating branch keeps below the length, as the condition of a
+ * loop does for the index it counts up: while i < 100 do a = xs[i]; i = i + 1; end
+ * returns how many checks were removed.
+ */
+unsigned int
+doil_guarded_checks(doil_t *doil) {
+	unsigned int n = doil->blocks_count, removed = 0;
+	unsigned int *idom = malloc(sizeof(unsigned int) * (n + 1));
+	/* the block every register is defined in */
+	unsigned int *where = calloc(doil->registers_count + 1, sizeof(unsigned int));
+	doil_dominators(doil, idom);
+	for (unsigned int b = 0; b < n; b++) {
+		block_t *blk = &doil->blocks[b];
+		if (!blk->head || idom[b] == DOIL_NO_BLOCK) continue;
+		for (instruction_t *ins = blk->head; ins != blk->tail; ins = ins->nxt) {
+			unsigned int *dst = doil_defined_register(ins);
+			if (!ins->dead && dst) where[*dst] = b;
+		}
+	}
+	for (unsigned int b = 0; b < n; b++) {
+		block_t *blk = &doil->blocks[b];
+		if (!blk->head || idom[b] == DOIL_NO_BLOCK) continue;
+		for (instruction_t *ins = blk->head; ins != blk->tail; ins = ins->nxt) {
+			if (ins->dead || ins->type != DOIL_CHECK || !ins->check.idx.is_reg || ins->check.len.is_reg) continue;
+			unsigned int reg = ins->check.idx.val.reg;
+			int is_unsigned = 0;
+			unsigned long long bound = doil_guard_bound(doil, idom, b, reg, &is_unsigned);
+			if (!bound || bound > ins->check.len.val.imm) continue;
+			doil_type_t type = doil->registers[reg].type;
+			if (!is_unsigned && doil_upper_bound(doil, ins->check.idx, 8) > doil_positive_max(type) &&
+			    !doil_counts_up(doil, idom, where, reg)) continue;
+			doil_kill(doil, ins);
+			removed++;
+		}
+	}
+	free(idom);
+	free(where);
+	return removed;
+}
+
+void
+doil_free_blocks(doil_t *doil) {
+	for (unsigned int i = 0; i < doil->blocks_count; i++) free(doil->blocks[i].preds);
+	free(doil->blocks);
+}
+
+void
+doil_clean_up(doil_t doil) {
+	free(doil.registers);
+	doil_free_blocks(&doil);
+	for (unsigned int i = 0; i < systems_count; i++) {
+		free(systems[i].doil.registers);
+		doil_free_blocks(&systems[i].doil);
+	}
+	free(systems);
+	free(ids);
+	free(ids_table);
+	free(layouts);
+	arena_free(&doil_arena);
+	if (src_map_siz) munmap(src, src_map_siz);
+	else             free(src);
+}
+
+/* generate doil code from dato code */
+doil_t
+front_end(void) {
+	stats_phase(PHASE_PARSE);
+	unsigned int root = parse();
+	stats.tokens = tkns_count;
+	stats.statements = stts_count;
+	stats.ast_nodes = ast.count;
+	stats_phase(PHASE_LOWER);
+	doil_t doil = doil_lex(root);
+	stats_phase(PHASE_SSA);
+	/* every access to a variable is known before the definitions of the unused ones are dropped */
+	for (unsigned int i = 0; i < systems_count; i++) doil_ssa(&systems[i].doil);
+	doil_ssa(&doil);
+	if (stats_report) stats.doil_before = doil_instructions_count(&doil);
+	for (unsigned int i = 0; i < systems_count; i++) {
+		doil_t *system = &systems[i].doil;
+		identifier_t *id = &ids[systems[i].id];
+		if (systems[i].is_extern) continue;
+		stats_phase(PHASE_OPTIMIZE);
+		doil_optimize(system);
+		/* before the loops are unrolled, the checks of their body are cloned otherwise */
+		if (doil_guarded_checks(system)) doil_optimize(system);
+		if (doil_optimize_loops(system)) doil_optimize(system);
+		if (doil_number_values(system)) doil_optimize(system);
+	if (doil_guarded_checks(system)) doil_optimize(system);
+		stats_phase(PHASE_PRINT);
+		printf("system %.*s\n", id->siz, id->str);
+		print_doil(*system);
+		printf("; optimized in %u pass, %u iterations\n", system->optimize_passes, system->optimize_iterations);
+	}
+	stats_phase(PHASE_OPTIMIZE);
+	doil_optimize(&doil);
+	/* before the loops are unrolled, the checks of their body are cloned otherwise */
+	if (doil_guarded_checks(&doil)) doil_optimize(&doil);
+	if (doil_optimize_loops(&doil)) doil_optimize(&doil);
+	if (doil_number_values(&doil)) doil_optimize(&doil);
+	if (doil_guarded_checks(&doil)) doil_optimize(&doil);
+	stats_phase(PHASE_PRINT);
+	print_doil(doil);
+	printf("; optimized in %u pass, %u iterations\n", doil.optimize_passes, doil.optimize_iterations);
+	if (stats_report) stats.doil_after = doil_instructions_count(&doil);
+	return doil;
+}
+
+/*
+ * interpreter, the doil of every system is encoded to threaded code: every instruction holds the
+ * address of its handler, which jumps straight to the handler of the next one. its operands are
+ * slots in the registers of its system, the doil registers followed by the constants it uses.
+ */
+enum {
+	RUN_MOV,
+	RUN_ADD,
+	RUN_SUB,
+	RUN_MUL,
+	RUN_DIV,
+	RUN_SHL,
+	RUN_SHR,
+	RUN_MULH,
+	RUN_CAST,
+	RUN_LT_S,
+	RUN_LT_U,
+	RUN_LE_S,
+	RUN_LE_U,
+	RUN_EQ,
+	RUN_NE,
+	RUN_GET,
+	RUN_SET,
+	RUN_LOAD,
+	RUN_LOAD_SLICE,
+	RUN_STORE,
+	RUN_STORE_SLICE,
+	RUN_CHECK,
+	RUN_LENGTH,
+	RUN_SLICE,
+	RUN_VEC,
+	RUN_ARG,
+	RUN_CALL,
+	RUN_MOVES,
+	RUN_JMP,
+	RUN_BR,
+	RUN_BLT_S, /* a comparison and the br on it */
+	RUN_BLT_U,
+	RUN_BLE_S,
+	RUN_BLE_U,
+	RUN_BEQ,
+	RUN_BNE,
+	RUN_RET,
+	RUN_COUNT,
+};
+
+typedef struct {
+	const void *op; /* the address of its handler */
+	unsigned int dst; /* a slot, an offset in memory or the instruction jumped to */
+	unsigned int lhs;
+	unsigned int rhs;
+	unsigned int type; /* siz | is_signed << 2 */
+} run_ins_t;
+
+/* dst[i] = lhs[i] op rhs[i], where a side that isn't an array is a slot */
+typedef struct {
+	unsigned int op; /* DOIL_VADD..DOIL_VDIV */
+	unsigned int dst;
+	unsigned int lhs;
+	unsigned int rhs;
+	int lhs_is_var;
+	int rhs_is_var;
+	unsigned int length;
+	unsigned int type;
+} run_vec_t;
+
+typedef struct {
+	unsigned int system;
+	unsigned int args[DOIL_MAX_PARAMS]; /* slots */
+	unsigned int args_count;
+} run_call_t;
+
+/* the phi dst gets src when going to its block */
+typedef struct {
+	unsigned int dst;
+	unsigned int src;
+} run_move_t;
+
+typedef struct {
+	unsigned int entry; /* in code */
+	unsigned long long *registers; /* systems don't call themselves, so each one has its own */
+} run_function_t;
+
+typedef struct {
+	const void *const *handlers;
+	run_ins_t *code;
+	unsigned int code_count;
+	unsigned int code_cap;
+	run_vec_t *vecs;
+	unsigned int vecs_count;
+	unsigned int vecs_cap;
+	run_call_t *calls;
+	unsigned int calls_count;
+	unsigned int calls_cap;
+	run_move_t *moves;
+	unsigned int moves_count;
+	unsigned int moves_cap;
+	unsigned long long *temp; /* for the moves of the phis of a block, which happen at once */
+	unsigned int temp_cap;
+	/* of the system being encoded */
+	unsigned long long *consts;
+	unsigned int consts_count;
+	unsigned int consts_cap;
+	unsigned int *jumps; /* the instructions whose dst is a block until its start is known */
+	unsigned int jumps_count;
+	unsigned int jumps_cap;
+	run_function_t *functions; /* the systems, then the logic */
+	unsigned char *memory; /* the variables, 8 bytes more so any of them can be read 8 bytes at a time */
+	unsigned int *offset; /* of every variable in memory */
+	unsigned long long args[DOIL_MAX_PARAMS]; /* of the system being called */
+} run_t;
+
+static const unsigned long long run_mask[8] = { 0xff, 0xffff, 0xffffffff, ~0ull, 0xff, 0xffff, 0xffffffff, ~0ull };
+static const unsigned long long run_sign[8] = { 0, 0, 0, 0, 0x80, 0x8000, 0x80000000, 0 };
+
+/* like doil_wrap, without a branch */
+#define run_wrap(v, t) ((((v) & run_mask[t]) ^ run_sign[t]) - run_sign[t])
+#define run_type(t) ((t).siz | (t).is_signed << 2)
+
+unsigned long long
+run_load(unsigned char *p, unsigned int type) {
+	unsigned long long val;
+	memcpy(&val, p, sizeof(val));
+	return run_wrap(val, type);
+}
+
+/* only the bytes of type are written */
+void
+run_store(unsigned char *p, unsigned long long val, unsigned int type) {
+	unsigned long long old;
+	memcpy(&old, p, sizeof(old));
+	old = (old & ~run_mask[type]) | (val & run_mask[type]);
+	memcpy(p, &old, sizeof(old));
+}
+
+unsigned long long
+run_divide(unsigned long long lhs, unsigned long long rhs, unsigned int type) {
+	lhs = run_wrap(lhs, type);
+	rhs = run_wrap(rhs, type);
+	if (!rhs) {
+		fprintf(stderr, "ERROR: division by zero\n");
+		exit(1);
+	}
+	if (!(type >> 2)) return lhs / rhs;
+	if (lhs == 1ull << 63 && rhs == ~0ull) {
+		fprintf(stderr, "ERROR: signed division overflows\n");
+		exit(1);
+	}
+	return run_wrap((unsigned long long)((long long)lhs / (long long)rhs), type);
+}
+
+void
+run_elementwise(run_t *run, run_vec_t *vec, unsigned long long *r) {
+	unsigned int type = vec->type, shift = type & 3;
+	unsigned long long lhs = vec->lhs_is_var ? 0 : run_wrap(r[vec->lhs], type);
+	unsigned long long rhs = vec->rhs_is_var ? 0 : run_wrap(r[vec->rhs], type), val;
+	for (unsigned int i = 0; i < vec->length; i++) {
+		if (vec->lhs_is_var) lhs = run_load(run->memory + vec->lhs + (i << shift), type);
+		if (vec->rhs_is_var) rhs = run_load(run->memory + vec->rhs + (i << shift), type);
+		switch (vec->op) {
+			case DOIL_VADD: val = lhs + rhs; break;
+			case DOIL_VSUB: val = lhs - rhs; break;
+			case DOIL_VMUL: val = lhs * rhs; break;
+			default:        val = run_divide(lhs, rhs, type); break;
+		}
+		run_store(run->memory + vec->dst + (i << shift), val, type);
+	}
+}
+
+/* runs the code from ip with the registers r until a ret, whose value it returns. without ip, it gives run its handlers */
+unsigned long long
+run_execute(run_t *run, run_ins_t *ip, unsigned long long *r) {
+	static const void *const handlers[RUN_COUNT] = {
+		[RUN_MOV] = &&run_mov,
+		[RUN_ADD] = &&run_add,
+		[RUN_SUB] = &&run_sub,
+		[RUN_MUL] = &&run_mul,
+		[RUN_DIV] = &&run_div,
+		[RUN_SHL] = &&run_shl,
+		[RUN_SHR] = &&run_shr,
+		[RUN_MULH] = &&run_mulh,
+		[RUN_CAST] = &&run_cast,
+		[RUN_LT_S] = &&run_lt_s,
+		[RUN_LT_U] = &&run_lt_u,
+		[RUN_LE_S] = &&run_le_s,
+		[RUN_LE_U] = &&run_le_u,
+		[RUN_EQ] = &&run_eq,
+		[RUN_NE] = &&run_ne,
+		[RUN_GET] = &&run_get,
+		[RUN_SET] = &&run_set,
+		[RUN_LOAD] = &&run_load,
+		[RUN_LOAD_SLICE] = &&run_load_slice,
+		[RUN_STORE] = &&run_store,
+		[RUN_STORE_SLICE] = &&run_store_slice,
+		[RUN_CHECK] = &&run_check,
+		[RUN_LENGTH] = &&run_length,
+		[RUN_SLICE] = &&run_slice,
+		[RUN_VEC] = &&run_vec,
+		[RUN_ARG] = &&run_arg,
+		[RUN_CALL] = &&run_call,
+		[RUN_MOVES] = &&run_moves,
+		[RUN_JMP] = &&run_jmp,
+		[RUN_BR] = &&run_br,
+		[RUN_BLT_S] = &&run_blt_s,
+		[RUN_BLT_U] = &&run_blt_u,
+		[RUN_BLE_S] = &&run_ble_s,
+		[RUN_BLE_U] = &&run_ble_u,
+		[RUN_BEQ] = &&run_beq,
+		[RUN_BNE] = &&run_bne,
+		[RUN_RET] = &&run_ret,
+	};
+	if (!ip) {
+		run->handlers = handlers;
+		return 0;
+	}
+	unsigned char *mem = run->memory;
+	run_ins_t *code = run->code;
+	unsigned long long lhs, rhs;
+#define run_next() goto *(++ip)->op
+#define run_jump(target) do { ip = code + (target); goto *ip->op; } while (0)
+	goto *ip->op;
+
+run_mov:
+	r[ip->dst] = r[ip->lhs];
+	run_next();
+run_add:
+	r[ip->dst] = run_wrap(r[ip->lhs] + r[ip->rhs], ip->type);
+	run_next();
+run_sub:
+	r[ip->dst] = run_wrap(r[ip->lhs] - r[ip->rhs], ip->type);
+	run_next();
+run_mul:
+	r[ip->dst] = run_wrap(r[ip->lhs] * r[ip->rhs], ip->type);
+	run_next();
+run_div:
+	r[ip->dst] = run_divide(r[ip->lhs], r[ip->rhs], ip->type);
+	run_next();
+run_shl:
+	r[ip->dst] = run_wrap(r[ip->lhs] << (r[ip->rhs] & 63), ip->type);
+	run_next();
+run_shr:
+	lhs = run_wrap(r[ip->lhs], ip->type);
+	lhs = ip->type >> 2 ? (unsigned long long)((long long)lhs >> (r[ip->rhs] & 63)) : lhs >> (r[ip->rhs] & 63);
+	r[ip->dst] = run_wrap(lhs, ip->type);
+	run_next();
+run_mulh:
+	lhs = run_wrap(r[ip->lhs], ip->type);
+	rhs = run_wrap(r[ip->rhs], ip->type);
+	if (ip->type >> 2) lhs = (unsigned long long)(((__int128)(long long)lhs * (long long)rhs) >> 64);
+	else               lhs = ((unsigned __int128)lhs * rhs) >> 64;
+	r[ip->dst] = run_wrap(lhs, ip->type);
+	run_next();
+run_cast:
+	r[ip->dst] = run_wrap(r[ip->lhs], ip->type);
+	run_next();
+run_lt_s:
+	r[ip->dst] = (long long)run_wrap(r[ip->lhs], ip->type) < (long long)run_wrap(r[ip->rhs], ip->type);
+	run_next();
+run_lt_u:
+	r[ip->dst] = run_wrap(r[ip->lhs], ip->type) < run_wrap(r[ip->rhs], ip->type);
+	run_next();
+run_le_s:
+	r[ip->dst] = (long long)run_wrap(r[ip->lhs], ip->type) <= (long long)run_wrap(r[ip->rhs], ip->type);
+	run_next();
+run_le_u:
+	r[ip->dst] = run_wrap(r[ip->lhs], ip->type) <= run_wrap(r[ip->rhs], ip->type);
+	run_next();
+run_eq:
+	r[ip->dst] = run_wrap(r[ip->lhs], ip->type) == run_wrap(r[ip->rhs], ip->type);
+	run_next();
+run_ne:
+	r[ip->dst] = run_wrap(r[ip->lhs], ip->type) != run_wrap(r[ip->rhs], ip->type);
+	run_next();
+run_get:
+	r[ip->dst] = run_load(mem + ip->lhs, ip->type);
+	run_next();
+run_set:
+	run_store(mem + ip->dst, r[ip->lhs], ip->type);
+	run_next();
+run_load:
+	r[ip->dst] = run_load(mem + ip->rhs + (r[ip->lhs] << (ip->type & 3)), ip->type);
+	run_next();
+run_load_slice:
+	r[ip->dst] = run_load(mem + run_load(mem + ip->rhs, DOIL_QWORD) + (r[ip->lhs] << (ip->type & 3)), ip->type);
+	run_next();
+run_store:
+	run_store(mem + ip->dst + (r[ip->lhs] << (ip->type & 3)), r[ip->rhs], ip->type);
+	run_next();
+run_store_slice:
+	run_store(mem + run_load(mem + ip->dst, DOIL_QWORD) + (r[ip->lhs] << (ip->type & 3)), r[ip->rhs], ip->type);
+	run_next();
+run_check:
+	if (r[ip->lhs] >= r[ip->rhs]) {
+		fprintf(stderr, "ERROR: index %lld is out of the bounds of '%.*s'\n", (long long)r[ip->lhs], ids[ip->dst].siz, ids[ip->dst].str);
+		exit(1);
+	}
+	run_next();
+run_length:
+	r[ip->dst] = run_load(mem + ip->lhs + 8, DOIL_QWORD);
+	run_next();
+run_slice:
+	run_store(mem + ip->dst, ip->lhs, DOIL_QWORD);
+	run_store(mem + ip->dst + 8, ip->rhs, DOIL_QWORD);
+	run_next();
+run_vec:
+	run_elementwise(run, &run->vecs[ip->lhs], r);
+	run_next();
+run_arg:
+	r[ip->dst] = run->args[ip->lhs];
+	run_next();
+run_call: {
+	run_call_t *call = &run->calls[ip->lhs];
+	run_function_t *fn = &run->functions[call->system];
+	for (unsigned int i = 0; i < call->args_count; i++) run->args[i] = r[call->args[i]];
+	lhs = run_execute(run, code + fn->entry, fn->registers);
+	if (ip->dst != ID_NONE) r[ip->dst] = lhs;
+	run_next();
+}
+run_moves: {
+	run_move_t *move = &run->moves[ip->lhs];
+	for (unsigned int i = 0; i < ip->rhs; i++) run->temp[i] = r[move[i].src];
+	for (unsigned int i = 0; i < ip->rhs; i++) r[move[i].dst] = run->temp[i];
+	run_next();
+}
+run_jmp:
+	run_jump(ip->dst);
+run_br:
+	if (r[ip->lhs]) run_jump(ip->dst);
+	run_next();
+run_blt_s:
+	if ((long long)run_wrap(r[ip->lhs], ip->type) < (long long)run_wrap(r[ip->rhs], ip->type)) run_jump(ip->dst);
+	run_next();
+run_blt_u:
+	if (run_wrap(r[ip->lhs], ip->type) < run_wrap(r[ip->rhs], ip->type)) run_jump(ip->dst);
+	run_next();
+run_ble_s:
+	if ((long long)run_wrap(r[ip->lhs], ip->type) <= (long long)run_wrap(r[ip->rhs], ip->type)) run_jump(ip->dst);
+	run_next();
+run_ble_u:
+	if (run_wrap(r[ip->lhs], ip->type) <= run_wrap(r[ip->rhs], ip->type)) run_jump(ip->dst);
+	run_next();
+run_beq:
+	if (run_wrap(r[ip->lhs], ip->type) == run_wrap(r[ip->rhs], ip->type)) run_jump(ip->dst);
+	run_next();
+run_bne:
+	if (run_wrap(r[ip->lhs], ip->type) != run_wrap(r[ip->rhs], ip->type)) run_jump(ip->dst);
+	run_next();
+run_ret:
+	return r[ip->lhs];
+#undef run_next
+#undef run_jump
+}
+
+run_ins_t *
+run_emit(run_t *run, unsigned int op, unsigned int dst, unsigned int lhs, unsigned int rhs, unsigned int type) {
+	if (run->code_count >= run->code_cap) {
+		run->code_cap = run->code_cap ? run->code_cap * 2 : 256;
+		run->code = realloc(run->code, sizeof(run_ins_t) * run->code_cap);
+	}
+	run->code[run->code_count] = (run_ins_t){ run->handlers[op], dst, lhs, rhs, type };
+	return &run->code[run->code_count++];
+}
+
+/* a jmp, or the branches that take dst when taken, to the start of a block */
+void
+run_emit_jump(run_t *run, unsigned int op, unsigned int block, unsigned int lhs, unsigned int rhs, unsigned int type) {
+	if (run->jumps_count >= run->jumps_cap) {
+		run->jumps_cap = run->jumps_cap ? run->jumps_cap * 2 : 64;
+		run->jumps = realloc(run->jumps, sizeof(unsigned int) * run->jumps_cap);
+	}
+	run->jumps[run->jumps_count++] = run->code_count;
+	run_emit(run, op, block, lhs, rhs, type);
+}
+
+/* the slot of an operand, a constant gets one of its own after the registers */
+unsigned int
+run_operand(run_t *run, doil_t *doil, reg_or_const op) {
+	if (op.is_reg) return op.val.reg;
+	if (run->consts_count >= run->consts_cap) {
+		run->consts_cap = run->consts_cap ? run->consts_cap * 2 : 64;
+		run->consts = realloc(run->consts, sizeof(unsigned long long) * run->consts_cap);
+	}
+	run->consts[run->consts_count] = op.val.imm;
+	return doil->registers_count + run->consts_count++;
+}
+
+/* the phis of block to take their arguments for the edge from block from */
+void
+run_phi_moves(run_t *run, doil_t *doil, unsigned int from, unsigned int to) {
+	block_t *blk = &doil->blocks[to];
+	unsigned int i = 0, start = run->moves_count;
+	while (blk->preds[i] != from) i++;
+	for (instruction_t *ins = blk->head->nxt; ins && ins->type == DOIL_PHI; ins = ins->nxt) {
+		if (run->moves_count >= run->moves_cap) {
+			run->moves_cap = run->moves_cap ? run->moves_cap * 2 : 64;
+			run->moves = realloc(run->moves, sizeof(run_move_t) * run->moves_cap);
+		}
+		run->moves[run->moves_count++] = (run_move_t){ ins->phi.dst, run_operand(run, doil, ins->phi.args[i]) };
+	}
+	unsigned int count = run->moves_count - start, overlap = 0;
+	for (unsigned int j = start; j < run->moves_count; j++) {
+		for (unsigned int k = start; k < run->moves_count; k++) overlap |= j != k && run->moves[j].src == run->moves[k].dst;
+	}
+	if (!overlap) {
+		/* one after the other, when none reads what another one writes */
+		for (unsigned int j = start; j < run->moves_count; j++) run_emit(run, RUN_MOV, run->moves[j].dst, run->moves[j].src, 0, 0);
+		run->moves_count = start;
+		return;
+	}
+	if (count > run->temp_cap) {
+		run->temp_cap = count;
+		run->temp = realloc(run->temp, sizeof(unsigned long long) * run->temp_cap);
+	}
+	run_emit(run, RUN_MOVES, 0, start, count, 0);
+}
+
+/* whether the block starting after ins is b */
+#define run_falls_to(ins, b) ((ins)->nxt && (ins)->nxt->type == DOIL_LABEL && (ins)->nxt->label.block == (b))
+
+void
+run_encode(run_t *run, doil_t *doil, run_function_t *fn) {
+	static const unsigned int compare[][2] = {
+		[DOIL_LT - DOIL_LT] = { RUN_LT_U, RUN_LT_S },
+		[DOIL_LE - DOIL_LT] = { RUN_LE_U, RUN_LE_S },
+		[DOIL_EQ - DOIL_LT] = { RUN_EQ, RUN_EQ },
+		[DOIL_NE - DOIL_LT] = { RUN_NE, RUN_NE },
+	};
+	static const unsigned int branch[][2] = {
+		[DOIL_LT - DOIL_LT] = { RUN_BLT_U, RUN_BLT_S },
+		[DOIL_LE - DOIL_LT] = { RUN_BLE_U, RUN_BLE_S },
+		[DOIL_EQ - DOIL_LT] = { RUN_BEQ, RUN_BEQ },
+		[DOIL_NE - DOIL_LT] = { RUN_BNE, RUN_BNE },
+	};
+	/* the moves into the phis go before the jmp of a block, a br has no block with a phi to go to */
+	doil_split_critical_edges(doil);
+	unsigned int *start = malloc(sizeof(unsigned int) * (doil->blocks_count + 1));
+	run->consts_count = 0;
+	run->jumps_count = 0;
+	fn->entry = run->code_count;
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) {
+		identifier_t *var;
+		instruction_t *def;
+		unsigned int op;
+		switch (ins->type) {
+			case DOIL_DEF:
+			case DOIL_PHI:
+				break;
+			case DOIL_LABEL:
+				start[ins->label.block] = run->code_count;
+				break;
+			case DOIL_MOV:
+				run_emit(run, RUN_MOV, ins->mov.reg, run_operand(run, doil, ins->mov.val), 0, 0);
+				break;
+			case DOIL_ADD:
+			case DOIL_SUB:
+			case DOIL_MUL:
+			case DOIL_DIV:
+			case DOIL_SHL:
+			case DOIL_SHR:
+			case DOIL_MULH:
+				op = ins->type == DOIL_ADD ? RUN_ADD : ins->type == DOIL_SUB ? RUN_SUB : ins->type == DOIL_MUL ? RUN_MUL :
+				     ins->type == DOIL_DIV ? RUN_DIV : ins->type == DOIL_SHL ? RUN_SHL : ins->type == DOIL_SHR ? RUN_SHR : RUN_MULH;
+				run_emit(run, op, ins->ope.dst, run_operand(run, doil, ins->ope.lhs), run_operand(run, doil, ins->ope.rhs), run_type(ins->ope.type));
+				break;
+			case DOIL_LT:
+			case DOIL_LE:
+			case DOIL_EQ:
+			case DOIL_NE:
+				if (doil_is_fused(doil, ins)) break;
+				op = compare[ins->type - DOIL_LT][ins->ope.type.is_signed];
+				run_emit(run, op, ins->ope.dst, run_operand(run, doil, ins->ope.lhs), run_operand(run, doil, ins->ope.rhs), run_type(ins->ope.type));
+				break;
+			case DOIL_CAST:
+				run_emit(run, RUN_CAST, ins->cast.dst, run_operand(run, doil, ins->cast.src), 0, run_type(ins->cast.type));
+				break;
+			case DOIL_GET:
+				var = &ids[ins->get.var];
+				run_emit(run, RUN_GET, ins->get.reg, run->offset[ins->get.var], 0, run_type(doil_variable_type(var)));
+				break;
+			case DOIL_SET:
+				if (ins->set.dst.is_reg) {
+					run_emit(run, RUN_MOV, ins->set.dst.val.reg, run_operand(run, doil, ins->set.src), 0, 0);
+					break;
+				}
+				var = &ids[ins->set.dst.val.var];
+				run_emit(run, RUN_SET, run->offset[ins->set.dst.val.var], run_operand(run, doil, ins->set.src), 0, run_type(doil_variable_type(var)));
+				break;
+			case DOIL_LOAD:
+				var = &ids[ins->elem.var];
+				run_emit(run, var->is_slice ? RUN_LOAD_SLICE : RUN_LOAD, ins->elem.dst, run_operand(run, doil, ins->elem.idx), run->offset[ins->elem.var], run_type(doil_variable_type(var)));
+				break;
+			case DOIL_STORE:
+				var = &ids[ins->elem.var];
+				run_emit(run, var->is_slice ? RUN_STORE_SLICE : RUN_STORE, run->offset[ins->elem.var], run_operand(run, doil, ins->elem.idx), run_operand(run, doil, ins->elem.src), run_type(doil_variable_type(var)));
+				break;
+			case DOIL_CHECK:
+				run_emit(run, RUN_CHECK, ins->check.var, run_operand(run, doil, ins->check.idx), run_operand(run, doil, ins->check.len), 0);
+				break;
+			case DOIL_LENGTH:
+				run_emit(run, RUN_LENGTH, ins->get.reg, run->offset[ins->get.var], 0, 0);
+				break;
+			case DOIL_SLICE:
+				run_emit(run, RUN_SLICE, run->offset[ins->slice.dst], run->offset[ins->slice.src], ids[ins->slice.src].length, 0);
+				break;
+			case DOIL_VADD:
+			case DOIL_VSUB:
+			case DOIL_VMUL:
+			case DOIL_VDIV: {
+				reg_or_const lhs = ins->vec.lhs, rhs = ins->vec.rhs;
+				var = &ids[ins->vec.dst];
+				if (run->vecs_count >= run->vecs_cap) {
+					run->vecs_cap = run->vecs_cap ? run->vecs_cap * 2 : 16;
+					run->vecs = realloc(run->vecs, sizeof(run_vec_t) * run->vecs_cap);
+				}
+				run->vecs[run->vecs_count] = (run_vec_t){
+					.op = ins->type,
+					.dst = run->offset[ins->vec.dst],
+					.lhs = lhs.is_var ? run->offset[lhs.val.var] : run_operand(run, doil, lhs),
+					.rhs = rhs.is_var ? run->offset[rhs.val.var] : run_operand(run, doil, rhs),
+					.lhs_is_var = lhs.is_var,
+					.rhs_is_var = rhs.is_var,
+					.length = var->length,
+					.type = run_type(doil_variable_type(var)),
+				};
+				run_emit(run, RUN_VEC, 0, run->vecs_count++, 0, 0);
+				break;
+			}
+			case DOIL_ARG:
+				run_emit(run, RUN_ARG, ins->arg.dst, ins->arg.idx, 0, 0);
+				break;
+			case DOIL_CALL: {
+				system_t *sys = &systems[ins->call.system];
+				if (sys->is_extern) {
+					fprintf(stderr, "ERROR: '%.*s' is written in C, it can't be run\n", ids[sys->id].siz, ids[sys->id].str);
+					exit(1);
+				}
+				if (run->calls_count >= run->calls_cap) {
+					run->calls_cap = run->calls_cap ? run->calls_cap * 2 : 16;
+					run->calls = realloc(run->calls, sizeof(run_call_t) * run->calls_cap);
+				}
+				run_call_t *call = &run->calls[run->calls_count];
+				call->system = ins->call.system;
+				call->args_count = ins->call.args_count;
+				for (unsigned int i = 0; i < ins->call.args_count; i++) call->args[i] = run_operand(run, doil, ins->call.args[i]);
+				run_emit(run, RUN_CALL, ins->call.dst, run->calls_count++, 0, 0);
+				break;
+			}
+			case DOIL_JMP:
+				run_phi_moves(run, doil, ins->jmp.block, ins->jmp.target[0]);
+				if (!run_falls_to(ins, ins->jmp.target[0])) run_emit_jump(run, RUN_JMP, ins->jmp.target[0], 0, 0, 0);
+				break;
+			case DOIL_BR:
+				def = ins->jmp.cond.is_reg ? doil->registers[ins->jmp.cond.val.reg].def : NULL;
+				if (doil_is_fused(doil, def)) {
+					op = branch[def->type - DOIL_LT][def->ope.type.is_signed];
+					run_emit_jump(run, op, ins->jmp.target[0], run_operand(run, doil, def->ope.lhs), run_operand(run, doil, def->ope.rhs), run_type(def->ope.type));
+				} else {
+					run_emit_jump(run, RUN_BR, ins->jmp.target[0], run_operand(run, doil, ins->jmp.cond), 0, 0);
+				}
+				if (!run_falls_to(ins, ins->jmp.target[1])) run_emit_jump(run, RUN_JMP, ins->jmp.target[1], 0, 0, 0);
+				break;
+			case DOIL_RET:
+				run_emit(run, RUN_RET, 0, run_operand(run, doil, ins->ret.src.unused ? doil_constant(0, doil_bool) : ins->ret.src), 0, 0);
+				break;
+			default:
+				assert(0 && "unreachable");
+		}
+	}
+	for (unsigned int i = 0; i < run->jumps_count; i++) run->code[run->jumps[i]].dst = start[run->code[run->jumps[i]].dst];
+	fn->registers = calloc(doil->registers_count + run->consts_count + 1, sizeof(unsigned long long));
+	if (run->consts_count) memcpy(fn->registers + doil->registers_count, run->consts, sizeof(unsigned long long) * run->consts_count);
+	free(start);
+}
+
+/* runs the program instead of writing it, returns the exit status it would have */
+int
+run_program(doil_t *doil) {
+	run_t run = {0};
+	run_execute(&run, NULL, NULL);
+	unsigned long long size = 0;
+	run.offset = calloc(ids_count + 1, sizeof(unsigned int));
+	for (unsigned int i = 0; i < ids_count; i++) {
+		identifier_t *var = &ids[i];
+		if (var->type != ID_VARIABLE) continue;
+		unsigned long long siz = 1u << var->datatype, bytes = var->is_slice ? 16 : (var->length ? var->length : 1) * siz;
+		size = align(size, var->is_slice ? 8 : siz);
+		run.offset[i] = size;
+		size += bytes;
+	}
+	if (size > 0xffffffffu - 8) {
+		fprintf(stderr, "ERROR: the variables don't fit in 4GB, they can't be run\n");
+		exit(1);
+	}
+	run.memory = calloc(size + 8, 1);
+
+	run.functions = calloc(systems_count + 1, sizeof(run_function_t));
+	for (unsigned int i = 0; i < systems_count; i++) {
+		if (!systems[i].is_extern) run_encode(&run, &systems[i].doil, &run.functions[i]);
+	}
+	run_function_t *logic = &run.functions[systems_count];
+	run_encode(&run, doil, logic);
+	stats_phase(PHASE_RUN);
+	int status = run_execute(&run, run.code + logic->entry, logic->registers) & 0xff;
+	stats_phase(PHASE_BACK_END);
+
+	for (unsigned int i = 0; i <= systems_count; i++) free(run.functions[i].registers);
+	free(run.functions);
+	free(run.code);
+	free(run.vecs);
+	free(run.calls);
+	free(run.moves);
+	free(run.temp);
+	free(run.consts);
+	free(run.jumps);
+	free(run.memory);
+	free(run.offset);
+	return status;
+}
+
+/* x86_64 */
+enum {
+	X86_RAX,
+	X86_RCX,
+	X86_RDX,
+	X86_RBX,
+	X86_RSP,
+	X86_RBP,
+	X86_RSI,
+	X86_RDI,
+	X86_R8,
+	X86_R9,
+	X86_R10,
+	X86_R11,
+	X86_R12,
+	X86_R13,
+	X86_R14,
+	X86_R15,
+	X86_RIP,
+};
+
+static const char *const x86_register_str[][4] = {
+	{ "al",   "ax",   "eax",  "rax" },
+	{ "cl",   "cx",   "ecx",  "rcx" },
+	{ "dl",   "dx",   "edx",  "rdx" },
+	{ "bl",   "bx",   "ebx",  "rbx" },
+	{ "spl",  "sp",   "esp",  "rsp" },
+	{ "bpl",  "bp",   "ebp",  "rbp" },
+	{ "sil",  "si",   "esi",  "rsi" },
+	{ "dil",  "di",   "edi",  "rdi" },
+	{ "r8b",  "r8w",  "r8d",  "r8"  },
+	{ "r9b",  "r9w",  "r9d",  "r9"  },
+	{ "r10b", "r10w", "r10d", "r10" },
+	{ "r11b", "r11w", "r11d", "r11" },
+	{ "r12b", "r12w", "r12d", "r12" },
+	{ "r13b", "r13w", "r13d", "r13" },
+	{ "r14b", "r14w", "r14d", "r14" },
+	{ "r15b", "r15w", "r15d", "r15" },
+	{ "rip",  "rip",  "rip",  "rip" },
+};
+
+static const char x86_suffix_str[] = { 'b', 'w', 'l', 'q' };
+
+typedef struct {
+	enum {
+		X86_NONE,
+		X86_REG,
+		X86_IMM,
+		X86_MEM,
+		X86_XMM,
+		X86_YMM,
+		X86_LABEL_OPERAND,
+	} type;
+	unsigned int siz; /* DOIL_BYTE..DOIL_QWORD, of every element of a vector register */
+	unsigned int reg; /* register, or base register of a memory operand */
+	unsigned int index; /* index register of a memory operand, when scale isn't 0 */
+	unsigned int scale; /* 1, 2, 4 or 8 */
+	long long imm; /* immediate, displacement of a memory operand or label */
+	identifier_t *var; /* variable of a rip relative memory operand */
+} x86_operand_t;
+
+typedef struct x86_instruction {
+	enum {
+		X86_MOV,
+		X86_MOVZX,
+		X86_MOVSX,
+		X86_LEA,
+		X86_ADD,
+		X86_SUB,
+		X86_IMUL,
+		X86_MUL,
+		X86_XOR,
+		X86_AND,
+		X86_CMP,
+		X86_SHL,
+		X86_SHR,
+		X86_SAR,
+		X86_DIV,
+		X86_IDIV,
+		X86_CQO,
+		X86_PUSH,
+		X86_SYSCALL,
+		X86_JB, /* to a label, or src.imm bytes from the start of the jump */
+		X86_UD2,
+		X86_POP,
+		X86_LABEL, /* src.imm */
+		X86_CALL, /* a system at a label, or the symbol of one written in C */
+		X86_RET,
+		X86_FUNCTION, /* the global symbol of src.var, or _start */
+		X86_JMP, /* to a label */
+		X86_JCC, /* to a label when cc holds */
+		X86_SETCC, /* the byte register dst is 1 when cc holds, else 0 */
+		/* the vector instructions take xmm or ymm operands, the ymm ones are vex encoded */
+		X86_MOVDQU,
+		X86_MOVQ, /* general purpose register to xmm */
+		X86_PUNPCKLQDQ,
+		X86_VPBROADCASTQ,
+		X86_PADD,
+		X86_PSUB,
+		X86_PMULL,
+		X86_VZEROUPPER,
+	} type;
+	x86_operand_t dst;
+	x86_operand_t src;
+	unsigned int end; /* offset after the encoded instruction */
+	int far; /* a jump to a label out of reach of 8 bits */
+	unsigned int cc; /* condition code of a jcc or setcc */
+	struct x86_instruction *nxt;
+} x86_instruction_t;
+
+static const char *const x86_instruction_str[] = {
+	"mov",
+	"movz",
+	"movs",
+	"lea",
+	"add",
+	"sub",
+	"imul",
+	"mul",
+	"xor",
+	"and",
+	"cmp",
+	"shl",
+	"shr",
+	"sar",
+	"div",
+	"idiv",
+	"cqto",
+	"push",
+	"syscall",
+	"jb",
+	"ud2",
+	"pop",
+	"",
+	"call",
+	"ret",
+	"",
+	"jmp",
+	"j",
+	"set",
+	"movdqu",
+	"movq",
+	"punpcklqdq",
+	"vpbroadcastq",
+	"padd",
+	"psub",
+	"pmull",
+	"vzeroupper",
+};
+
+/* the condition codes, a code with its lowest bit flipped is the opposite condition */
+enum {
+	X86_CC_B = 0x2,
+	X86_CC_AE,
+	X86_CC_E,
+	X86_CC_NE,
+	X86_CC_BE,
+	X86_CC_A,
+	X86_CC_L = 0xc,
+	X86_CC_GE,
+	X86_CC_LE,
+	X86_CC_G,
+};
+
+static const char *const x86_cc_str[] = { "o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g" };
+
+typedef struct {
+	identifier_t *var;
+	enum {
+		X86_DATA,
+		X86_BSS,
+		X86_EXTERN, /* a system written in C, defined by another object */
+	} section;
+	unsigned int offset;
+	unsigned long long value;
+	/* element i is at offset + i / width * block + i % width * its size */
+	unsigned int width;
+	unsigned int block;
+} x86_symbol_t;
+
+typedef struct {
+	unsigned int offset; /* of the 32 bits displacement in the code */
+	unsigned int symbol;
+	long long addend;
+} x86_relocation_t;
+
+/* where the value of a doil register lives */
+typedef struct {
+	int in_reg;
+	unsigned int reg; /* x86 register, or stack slot */
+} x86_location_t;
+
+/* rax, rcx and rdx are left as scratch registers, for division and the operands that don't fit */
+static const unsigned int x86_allocatable[] = {
+	X86_RBX, X86_RSI, X86_RDI, X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15,
+};
+#define X86_ALLOCATABLE_COUNT (sizeof(x86_allocatable) / sizeof(x86_allocatable[0]))
+#define x86_bit(r) (1u << (r))
+#define X86_SCRATCH (x86_bit(X86_RAX) | x86_bit(X86_RCX) | x86_bit(X86_RDX))
+/* what a function written in C can change, it saves rbx, rbp and r12 to r15 */
+#define X86_SYSV_CLOBBERS (X86_SCRATCH | x86_bit(X86_RSI) | x86_bit(X86_RDI) | x86_bit(X86_R8) | x86_bit(X86_R9) | x86_bit(X86_R10) | x86_bit(X86_R11))
+
+/* every system takes its arguments where the SysV ABI puts them */
+static const unsigned int x86_arguments[] = { X86_RDI, X86_RSI, X86_RDX, X86_RCX, X86_R8, X86_R9 };
+
+/* a lowered system */
+typedef struct {
+	unsigned int label; /* of its entry, for the other systems */
+	unsigned int clobbers; /* the x86 registers a call to it can change */
+	struct x86_instruction *body; /* its first instruction */
+	struct x86_instruction *wrapper; /* its entry for C, NULL when there isn't one */
+} x86_function_t;
+
+typedef struct {
+	arena_t arena;
+	x86_instruction_t *ins;
+	x86_instruction_t *hins;
+	x86_symbol_t *syms;
+	unsigned int syms_count;
+	unsigned int syms_cap;
+	unsigned int data_siz;
+	unsigned int bss_siz;
+	unsigned int bss_align;
+	unsigned char *code;
+	unsigned int code_siz;
+	unsigned int code_cap;
+	x86_relocation_t *rels;
+	unsigned int rels_count;
+	unsigned int rels_cap;
+	x86_location_t *locs; /* per doil register of the doil being lowered */
+	unsigned int slots_count;
+	unsigned int labels_count;
+	unsigned int block_label; /* of the first block of the doil being lowered, the others follow */
+	x86_function_t *functions; /* per system */
+	identifier_t *exit; /* the one of the C library, when the program calls C */
+} x86_t;
+
+#define fits_i8(x) ((x) >= -128 && (x) <= 127)
+#define fits_i32(x) ((x) >= -2147483648LL && (x) <= 2147483647LL)
+
+#define x86_reg(r, s) ((x86_operand_t){ .type = X86_REG, .siz = (s), .reg = (r) })
+#define x86_imm(i) ((x86_operand_t){ .type = X86_IMM, .siz = DOIL_QWORD, .imm = (i) })
+#define x86_mem(r, d, s) ((x86_operand_t){ .type = X86_MEM, .siz = (s), .reg = (r), .imm = (d) })
+#define x86_sib(b, i, sc, d, s) ((x86_operand_t){ .type = X86_MEM, .siz = (s), .reg = (b), .index = (i), .scale = (sc), .imm = (d) })
+#define x86_sym(v) ((x86_operand_t){ .type = X86_MEM, .siz = (v)->datatype, .reg = X86_RIP, .var = (v) })
+/* doil registers that don't get an x86 register live in a stack slot */
+#define x86_slot(s) x86_mem(X86_RBP, -8 * ((long long)(s) + 1), DOIL_QWORD)
+#define x86_vec(r, s, w) ((x86_operand_t){ .type = (w) == 32 ? X86_YMM : X86_XMM, .siz = (s), .reg = (r) })
+#define x86_xmm(r, s) ((x86_operand_t){ .type = X86_XMM, .siz = (s), .reg = (r) })
+#define x86_label(l) ((x86_operand_t){ .type = X86_LABEL_OPERAND, .imm = (l) })
+
+x86_instruction_t *
+x86_make_instruction(x86_t *x86, unsigned int type, x86_operand_t dst, x86_operand_t src) {
+	x86_instruction_t *ins = arena_alloc(&x86->arena, sizeof(x86_instruction_t));
+	ins->type = type;
+	ins->dst = dst;
+	ins->src = src;
+	ins->far = 0;
+	ins->cc = 0;
+	ins->nxt = NULL;
+	if (x86->ins) x86->ins->nxt = ins;
+	x86->ins = ins;
+	if (!x86->hins) x86->hins = ins;
+	return ins;
+}
+
+#define x86_emit(x86, type, dst, src) x86_make_instruction((x86), (type), (dst), (src))
+#define x86_emit_none(x86, type) x86_emit(x86, type, (x86_operand_t){0}, (x86_operand_t){0})
+
+#define X86_CACHE_LINE 64
+
+x86_symbol_t *
+x86_variable_symbol(x86_t *x86, unsigned int id) {
+	identifier_t *var = &ids[id];
+	if (var->symbol >= x86->syms_count || x86->syms[var->symbol].var != var) return NULL;
+	return &x86->syms[var->symbol];
+}
+
+/* a slice is the address of its first element and its length */
+unsigned int
+x86_variable_size(identifier_t *var) {
+	if (var->is_slice) return 16;
+	return (1u << var->datatype) * (var->length ? var->length : 1);
+}
+
+/* a vector is aligned to its size, so it never crosses a cache line */
+unsigned int
+x86_variable_align(identifier_t *var) {
+	if (var->is_vector) return x86_variable_size(var);
+	return var->is_slice ? 8 : 1u << var->datatype;
+}
+
+/* next free offset of .bss aligned to a */
+unsigned int
+x86_bss_reserve(x86_t *x86, unsigned int a) {
+	if (a > x86->bss_align) x86->bss_align = a;
+	return x86->bss_siz = align(x86->bss_siz, a);
+}
+
+void
+x86_place_layout(x86_t *x86, layout_t *layout) {
+	unsigned int record_align = layout->align ? layout->align : 1;
+	for (unsigned int i = 0; i < layout->vars_count; i++) {
+		x86_symbol_t *sym = x86_variable_symbol(x86, layout->vars[i]);
+		if (sym && x86_variable_align(sym->var) > record_align) record_align = x86_variable_align(sym->var);
+	}
+	if (layout->type == LAYOUT_SOA) {
+		for (unsigned int i = 0; i < layout->vars_count; i++) {
+			x86_symbol_t *sym = x86_variable_symbol(x86, layout->vars[i]);
+			if (!sym) continue;
+			unsigned int siz = x86_variable_size(sym->var);
+			sym->offset = x86_bss_reserve(x86, max(x86_variable_align(sym->var), layout->align));
+			if (layout->pad) siz = (siz + layout->pad - 1) / layout->pad * layout->pad;
+			x86->bss_siz += siz;
+		}
+		return;
+	}
+	/*
+	 * aos is an aosoa of width 1: a block holds width elements of every variable in turn, and there
+	 * are as many blocks as needed for the elements of the arrays, which layout_resolve made equal
+	 */
+	unsigned int base = x86_bss_reserve(x86, record_align), off = 0, length = 1;
+	for (unsigned int i = 0; i < layout->vars_count; i++) {
+		x86_symbol_t *sym = x86_variable_symbol(x86, layout->vars[i]);
+		if (!sym) continue;
+		unsigned int siz = 1 << sym->var->datatype;
+		off = align(off, siz);
+		sym->offset = base + off;
+		off += siz * layout->width;
+		if (sym->var->length > length) length = sym->var->length;
+	}
+	off = align(off, record_align);
+	if (layout->pad) off = (off + layout->pad - 1) / layout->pad * layout->pad;
+	for (unsigned int i = 0; i < layout->vars_count; i++) {
+		x86_symbol_t *sym = x86_variable_symbol(x86, layout->vars[i]);
+		if (!sym) continue;
+		sym->width = layout->width;
+		sym->block = off;
+	}
+	x86->bss_siz = base + (length + layout->width - 1) / layout->width * off;
+}
+
+/* accesses left after doil_ssa forwarded what it could */
+#define x86_heat(var) ((var)->use_amount + (var)->set_amount)
+
+int
+x86_placement_compare(const void *a, const void *b) {
+	const x86_symbol_t *lhs = *(x86_symbol_t *const *)a, *rhs = *(x86_symbol_t *const *)b;
+	if (!x86_heat(lhs->var) != !x86_heat(rhs->var)) return !x86_heat(lhs->var) - !x86_heat(rhs->var);
+	/* the accessed ones go from the largest size down and the others back up, so the seam needs no padding either */
+	if (x86_variable_align(lhs->var) != x86_variable_align(rhs->var)) {
+		int order = (int)x86_variable_align(rhs->var) - (int)x86_variable_align(lhs->var);
+		return x86_heat(lhs->var) ? order : -order;
+	}
+	if (x86_heat(lhs->var) != x86_heat(rhs->var)) return x86_heat(lhs->var) > x86_heat(rhs->var) ? -1 : 1;
+	/* declaration order */
+	return (lhs > rhs) - (lhs < rhs);
+}
+
+/*
+ * give every defined variable a place in .bss, all of them start zeroed since the ones set to a
+ * constant were turned into values by doil_ssa. hot layouts come first, packed from the start of a
+ * cache line, then the variables without a layout and the other layouts, then the cold layouts
+ * from a cache line of their own.
+ */
+void
+x86_add_symbol(x86_t *x86, x86_symbol_t sym) {
+	if (x86->syms_count >= x86->syms_cap) {
+		x86->syms_cap = x86->syms_cap ? x86->syms_cap * 2 : 8;
+		x86->syms = realloc(x86->syms, sizeof(x86_symbol_t) * x86->syms_cap);
+	}
+	x86->syms[x86->syms_count] = sym;
+	sym.var->symbol = x86->syms_count++;
+}
+
+void
+x86_layout_data(x86_t *x86, doil_t *doil) {
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) {
+		if (ins->type != DOIL_DEF) continue;
+		identifier_t *var = &ids[ins->def.var];
+		x86_add_symbol(x86, (x86_symbol_t){ .var = var, .section = X86_BSS, .width = 1, .block = 1 << var->datatype });
+	}
+
+	x86->bss_align = 8;
+	unsigned int hot = 0;
+	for (unsigned int i = 0; i < layouts_count; i++) {
+		if (layouts[i].temperature != LAYOUT_HOT) continue;
+		if (!hot++) x86_bss_reserve(x86, X86_CACHE_LINE);
+		x86_place_layout(x86, &layouts[i]);
+	}
+	/*
+	 * without a layout, the variables still accessed in memory are packed first, to share as few
+	 * cache lines as possible. every alignment is a power of two and every size a multiple of it,
+	 * sorting by it leaves no padding.
+	 */
+	x86_symbol_t **placement = malloc(sizeof(x86_symbol_t *) * (x86->syms_count + 1));
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < x86->syms_count; i++) {
+		if (!x86->syms[i].var->layout) placement[count++] = &x86->syms[i];
+	}
+	qsort(placement, count, sizeof(x86_symbol_t *), x86_placement_compare);
+	for (unsigned int i = 0; i < count; i++) {
+		x86_symbol_t *sym = placement[i];
+		sym->offset = x86_bss_reserve(x86, x86_variable_align(sym->var));
+		x86->bss_siz += x86_variable_size(sym->var);
+	}
+	free(placement);
+	for (unsigned int i = 0; i < layouts_count; i++) {
+		if (layouts[i].temperature == LAYOUT_WARM) x86_place_layout(x86, &layouts[i]);
+	}
+	unsigned int cold = 0;
+	for (unsigned int i = 0; i < layouts_count; i++) {
+		if (layouts[i].temperature != LAYOUT_COLD) continue;
+		if (!cold++) x86_bss_reserve(x86, X86_CACHE_LINE);
+		x86_place_layout(x86, &layouts[i]);
+	}
+}
+
+/*
+ * the systems written in C are symbols the linker resolves. a program calling C leaves through its
+ * exit, so what stdio buffered is written.
+ */
+void
+x86_extern_symbols(x86_t *x86) {
+	static char exit_str[] = "exit";
+	static identifier_t exit_id = { .type = ID_SYSTEM, .str = exit_str, .siz = 4 };
+	int calls_c = 0;
+	for (unsigned int i = 0; i < systems_count; i++) {
+		if (!systems[i].is_extern) continue;
+		x86_add_symbol(x86, (x86_symbol_t){ .var = &ids[systems[i].id], .section = X86_EXTERN });
+		calls_c = 1;
+	}
+	if (!calls_c) return;
+	unsigned int id = ids_find(exit_str, 4, hash(exit_str, 4));
+	if (id == ID_NONE) {
+		x86->exit = &exit_id;
+		x86_add_symbol(x86, (x86_symbol_t){ .var = x86->exit, .section = X86_EXTERN });
+	} else if (ids[id].type == ID_SYSTEM && systems[ids[id].system - 1].is_extern) {
+		x86->exit = &ids[id];
+	} else {
+		fprintf(stderr, "ERROR: 'exit' is the exit of C, it can't be defined in a program calling C\n");
+		exit(1);
+	}
+}
+
+#define X86_NO_RANGE 0xffffffffu
+
+unsigned int
+x86_call_clobbers(x86_t *x86, instruction_t *ins) {
+	return systems[ins->call.system].is_extern ? X86_SYSV_CLOBBERS : x86->functions[ins->call.system].clobbers;
+}
+
+#define x86_live(set, r) ((set)[(r) / 64] >> ((r) % 64) & 1)
+#define x86_set_live(set, r) ((set)[(r) / 64] |= 1ull << ((r) % 64))
+
+/*
+ * which registers are live at the start and at the end of every block, from where they are used
+ * backwards to where they are defined. the argument of a phi is used at the end of its predecessor.
+ */
+void
+x86_liveness(doil_t *doil, unsigned long long *live_in, unsigned long long *live_out, unsigned long long *uses, unsigned long long *defs) {
+	unsigned int words = doil->registers_count / 64 + 1, b = 0;
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) {
+		if (ins->type == DOIL_LABEL) b = ins->label.block;
+		reg_or_const *op;
+		for (unsigned int k = 0; ins->type != DOIL_PHI && (op = doil_operand(ins, k)); k++) {
+			/* in ssa form, a register defined in the block is defined before it is used */
+			if (op->is_reg && !x86_live(&defs[b * words], op->val.reg)) x86_set_live(&uses[b * words], op->val.reg);
+		}
+		unsigned int *dst = doil_defined_register(ins);
+		if (dst) x86_set_live(&defs[b * words], *dst);
+		if (ins->type != DOIL_PHI) continue;
+		for (unsigned int i = 0; i < ins->phi.args_count; i++) {
+			if (ins->phi.args[i].is_reg) x86_set_live(&live_out[doil->blocks[b].preds[i] * words], ins->phi.args[i].val.reg);
+		}
+	}
+	/* what the phis need is where live_out starts, the blocks are visited backwards until nothing changes */
+	memcpy(live_in, uses, sizeof(unsigned long long) * words * doil->blocks_count);
+	for (int changed = 1; changed;) {
+		changed = 0;
+		for (b = doil->blocks_count; b--;) {
+			block_t *blk = &doil->blocks[b];
+			unsigned long long *in = &live_in[b * words], *out = &live_out[b * words];
+			for (unsigned int k = 0; k < blk->succs_count; k++) {
+				unsigned long long *succ = &live_in[blk->succs[k] * words];
+				for (unsigned int w = 0; w < words; w++) out[w] |= succ[w];
+			}
+			for (unsigned int w = 0; w < words; w++) {
+				unsigned long long live = uses[b * words + w] | (out[w] & ~defs[b * words + w]);
+				if (live == in[w]) continue;
+				in[w] = live;
+				changed = 1;
+			}
+		}
+	}
+}
+
+/*
+ * linear scan over the live ranges of the ssa registers, in the order they start. a range covers
+ * every block the register is live in, from the first to the last of them in the code, and a phi
+ * lives from the end of each predecessor, where it is moved into.
+ * a range ending where another starts hands its register over, so two address operations and casts
+ * can work in place. when nothing is free, the range ending last goes to the stack.
+ * a range living across a call can't take the registers the called system changes.
+ */
+void
+x86_allocate(x86_t *x86, doil_t *doil) {
+	unsigned int n = doil->registers_count, blocks_count = doil->blocks_count, words = n / 64 + 1;
+	unsigned int *start  = malloc(sizeof(unsigned int) * (n + 1));
+	unsigned int *end    = malloc(sizeof(unsigned int) * (n + 1));
+	unsigned int *hint   = malloc(sizeof(unsigned int) * (n + 1)); /* register whose place the value would like to take */
+	unsigned int *prefer = malloc(sizeof(unsigned int) * (n + 1)); /* x86 register an argument arrives in */
+	unsigned int *forbid = calloc(n + 1, sizeof(unsigned int));
+	unsigned int *order  = malloc(sizeof(unsigned int) * (n + 1)), order_count = 0;
+	unsigned int *calls = NULL, *clobbers = NULL, calls_count = 0, calls_cap = 0;
+	unsigned int *block_start = malloc(sizeof(unsigned int) * (blocks_count + 1));
+	unsigned int *block_end   = malloc(sizeof(unsigned int) * (blocks_count + 1));
+	unsigned long long *live_in  = calloc(words * blocks_count + 1, sizeof(unsigned long long));
+	unsigned long long *live_out = calloc(words * blocks_count + 1, sizeof(unsigned long long));
+	unsigned long long *uses     = calloc(words * blocks_count + 1, sizeof(unsigned long long));
+	unsigned long long *defs     = calloc(words * blocks_count + 1, sizeof(unsigned long long));
+	free(x86->locs);
+	x86->locs = calloc(n + 1, sizeof(x86_location_t));
+	x86->slots_count = 0;
+	for (unsigned int i = 0; i < n; i++) start[i] = end[i] = hint[i] = prefer[i] = X86_NO_RANGE;
+	x86_liveness(doil, live_in, live_out, uses, defs);
+
+	unsigned int p = 0, b = 0;
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt, p++) {
+		reg_or_const *op;
+		if (ins->type == DOIL_LABEL) block_start[b = ins->label.block] = p;
+		if (doil_ends_block(ins)) block_end[b] = p;
+		for (unsigned int k = 0; ins->type != DOIL_PHI && (op = doil_operand(ins, k)); k++) {
+			if (op->is_reg) end[op->val.reg] = p;
+		}
+		if (ins->type == DOIL_CALL) {
+			if (calls_count >= calls_cap) {
+				calls_cap = calls_cap ? calls_cap * 2 : 16;
+				calls = realloc(calls, sizeof(unsigned int) * calls_cap);
+				clobbers = realloc(clobbers, sizeof(unsigned int) * calls_cap);
+			}
+			calls[calls_count] = p;
+			clobbers[calls_count++] = x86_call_clobbers(x86, ins);
+		}
+		unsigned int *dst = doil_defined_register(ins);
+		if (!dst) continue;
+		start[*dst] = end[*dst] = p;
+		order[order_count++] = *dst;
+		if (ins->type == DOIL_ARG && !(X86_SCRATCH & x86_bit(x86_arguments[ins->arg.idx]))) prefer[*dst] = x86_arguments[ins->arg.idx];
+		op = doil_operand(ins, 0);
+		/* division and the high half of a product go through rax and rdx anyway */
+		if (op && op->is_reg && ins->type != DOIL_DIV && ins->type != DOIL_MULH && ins->type != DOIL_CALL) hint[*dst] = op->val.reg;
+	}
+	for (b = 0; b < blocks_count; b++) {
+		for (unsigned int w = 0; w < words; w++) {
+			for (unsigned long long bits = live_in[b * words + w]; bits; bits &= bits - 1) {
+				unsigned int r = w * 64 + __builtin_ctzll(bits);
+				if (block_start[b] < start[r]) start[r] = block_start[b];
+			}
+			for (unsigned long long bits = live_out[b * words + w]; bits; bits &= bits - 1) {
+				unsigned int r = w * 64 + __builtin_ctzll(bits);
+				if (block_end[b] > end[r]) end[r] = block_end[b];
+			}
+		}
+		block_t *blk = &doil->blocks[b];
+		for (instruction_t *ins = blk->head->nxt; ins && ins->type == DOIL_PHI; ins = ins->nxt) {
+			unsigned int r = ins->phi.dst;
+			for (unsigned int i = 0; i < blk->preds_count; i++) {
+				if (block_end[blk->preds[i]] < start[r]) start[r] = block_end[blk->preds[i]];
+				if (block_end[blk->preds[i]] > end[r])   end[r] = block_end[blk->preds[i]];
+			}
+		}
+	}
+	/* sorted by start, a counting sort keeps the ones starting together in the order they are defined */
+	unsigned int *first = calloc(p + 2, sizeof(unsigned int)), *sorted = malloc(sizeof(unsigned int) * (order_count + 1));
+	for (unsigned int o = 0; o < order_count; o++) first[start[order[o]] + 1]++;
+	for (unsigned int i = 0; i < p; i++) first[i + 1] += first[i];
+	for (unsigned int o = 0; o < order_count; o++) sorted[first[start[order[o]]]++] = order[o];
+	memcpy(order, sorted, sizeof(unsigned int) * order_count);
+	free(first);
+	free(sorted);
+	for (unsigned int c = 0; c < calls_count; c++) {
+		for (unsigned int i = 0; i < n; i++) {
+			if (start[i] != X86_NO_RANGE && start[i] < calls[c] && calls[c] < end[i]) forbid[i] |= clobbers[c];
+		}
+	}
+
+	unsigned int active[X86_ALLOCATABLE_COUNT], active_count = 0;
+	for (unsigned int o = 0; o < order_count; o++) {
+		unsigned int r = order[o];
+		for (unsigned int i = 0; i < active_count;) {
+			if (end[active[i]] <= start[r]) active[i] = active[--active_count];
+			else                            i++;
+		}
+		unsigned int taken = forbid[r];
+		for (unsigned int i = 0; i < active_count; i++) taken |= x86_bit(x86->locs[active[i]].reg);
+
+		x86_location_t *loc = &x86->locs[r];
+		unsigned int i = 0;
+		while (i < X86_ALLOCATABLE_COUNT && (taken & x86_bit(x86_allocatable[i]))) i++;
+		if (hint[r] != X86_NO_RANGE && x86->locs[hint[r]].in_reg && !(taken & x86_bit(x86->locs[hint[r]].reg))) {
+			*loc = x86->locs[hint[r]];
+		} else if (prefer[r] != X86_NO_RANGE && !(taken & x86_bit(prefer[r]))) {
+			*loc = (x86_location_t){ 1, prefer[r] };
+		} else if (i < X86_ALLOCATABLE_COUNT) {
+			*loc = (x86_location_t){ 1, x86_allocatable[i] };
+		} else {
+			unsigned int spill = X86_NO_RANGE;
+			for (i = 0; i < active_count; i++) {
+				if (forbid[r] & x86_bit(x86->locs[active[i]].reg)) continue;
+				if (spill == X86_NO_RANGE || end[active[i]] > end[active[spill]]) spill = i;
+			}
+			if (spill != X86_NO_RANGE && end[active[spill]] > end[r]) {
+				*loc = x86->locs[active[spill]];
+				x86->locs[active[spill]] = (x86_location_t){ 0, x86->slots_count++ };
+				active[spill] = r;
+			} else {
+				*loc = (x86_location_t){ 0, x86->slots_count++ };
+			}
+			continue;
+		}
+		active[active_count++] = r;
+	}
+	free(start);
+	free(end);
+	free(hint);
+	free(prefer);
+	free(forbid);
+	free(order);
+	free(calls);
+	free(clobbers);
+	free(block_start);
+	free(block_end);
+	free(live_in);
+	free(live_out);
+	free(uses);
+	free(defs);
+}
+
+x86_operand_t
+x86_location(x86_t *x86, unsigned int reg) {
+	x86_location_t loc = x86->locs[reg];
+	return loc.in_reg ? x86_reg(loc.reg, DOIL_QWORD) : x86_slot(loc.reg);
+}
+
+x86_operand_t
+x86_operand(x86_t *x86, reg_or_const op) {
+	return op.is_reg ? x86_location(x86, op.val.reg) : x86_imm((long long)op.val.imm);
+}
+
+/* a mov, through rax when x86_64 can't do it in one instruction */
+void
+x86_move(x86_t *x86, x86_operand_t dst, x86_operand_t src) {
+	if (dst.type == src.type && dst.reg == src.reg && (dst.type == X86_REG || dst.imm == src.imm)) return;
+	if (dst.type == X86_MEM && (src.type == X86_MEM || (src.type == X86_IMM && !fits_i32(src.imm)))) {
+		x86_emit(x86, X86_MOV, x86_reg(X86_RAX, DOIL_QWORD), src);
+		src = x86_reg(X86_RAX, DOIL_QWORD);
+	}
+	x86_emit(x86, X86_MOV, dst, src);
+}
+
+/* the register an instruction computes in, dst itself unless it is on the stack or read too late */
+unsigned int
+x86_work_register(x86_operand_t dst, x86_operand_t late) {
+	if (dst.type != X86_REG || (late.type == X86_REG && late.reg == dst.reg)) return X86_RAX;
+	return dst.reg;
+}
+
+/* registers always hold a value extended to 64 bits from its type */
+void
+x86_load(x86_t *x86, unsigned int reg, x86_operand_t src, int is_signed) {
+	if (src.type != X86_MEM || src.siz == DOIL_QWORD) {
+		x86_emit(x86, X86_MOV, x86_reg(reg, DOIL_QWORD), src);
+	} else if (is_signed) {
+		x86_emit(x86, X86_MOVSX, x86_reg(reg, DOIL_QWORD), src);
+	} else if (src.siz == DOIL_DWORD) {
+		/* writing to a 32 bits register already clears the upper half */
+		x86_emit(x86, X86_MOV, x86_reg(reg, DOIL_DWORD), src);
+	} else {
+		x86_emit(x86, X86_MOVZX, x86_reg(reg, DOIL_QWORD), src);
+	}
+}
+
+void
+x86_load_variable(x86_t *x86, unsigned int reg, identifier_t *var) {
+	x86_load(x86, reg, x86_sym(var), var->is_signed);
+}
+
+/* the address and the length of a slice */
+#define x86_slice_field(v, d) ((x86_operand_t){ .type = X86_MEM, .siz = DOIL_QWORD, .reg = X86_RIP, .var = (v), .imm = (d) })
+
+/* the offset of element rax of an array of an aosoa layout in rcx, with rdx: rax / width * block + rax % width * siz */
+void
+x86_element_offset(x86_t *x86, x86_symbol_t *sym, unsigned int siz) {
+	if (sym->width & (sym->width - 1)) {
+		x86_emit(x86, X86_MOV, x86_reg(X86_RCX, DOIL_DWORD), x86_imm(sym->width));
+		x86_emit(x86, X86_XOR, x86_reg(X86_RDX, DOIL_DWORD), x86_reg(X86_RDX, DOIL_DWORD));
+		x86_emit(x86, X86_DIV, x86_reg(X86_RCX, DOIL_QWORD), (x86_operand_t){0});
+	} else {
+		x86_emit(x86, X86_MOV, x86_reg(X86_RDX, DOIL_QWORD), x86_reg(X86_RAX, DOIL_QWORD));
+		x86_emit(x86, X86_SHR, x86_reg(X86_RAX, DOIL_QWORD), x86_imm(__builtin_ctz(sym->width)));
+		x86_emit(x86, X86_AND, x86_reg(X86_RDX, DOIL_QWORD), x86_imm(sym->width - 1));
+	}
+	x86_emit(x86, X86_IMUL, x86_reg(X86_RAX, DOIL_QWORD), x86_imm(sym->block));
+	x86_emit(x86, X86_LEA, x86_reg(X86_RCX, DOIL_QWORD), x86_sib(X86_RAX, X86_RDX, siz, 0, DOIL_QWORD));
+}
+
+/* the memory operand of var[idx], its address is computed in rax, rcx and rdx */
+x86_operand_t
+x86_element(x86_t *x86, identifier_t *var, reg_or_const idx) {
+	x86_symbol_t *sym = &x86->syms[var->symbol];
+	unsigned int siz = 1 << var->datatype;
+	if (var->is_slice) {
+		x86_emit(x86, X86_MOV, x86_reg(X86_RAX, DOIL_QWORD), x86_slice_field(var, 0));
+		if (!idx.is_reg && fits_i32((long long)idx.val.imm * siz)) return x86_mem(X86_RAX, (long long)idx.val.imm * siz, var->datatype);
+		x86_move(x86, x86_reg(X86_RCX, DOIL_QWORD), x86_operand(x86, idx));
+		return x86_sib(X86_RAX, X86_RCX, siz, 0, var->datatype);
+	}
+	if (!idx.is_reg) {
+		/* doil_optimize already refused a constant index out of the bounds */
+		x86_operand_t op = x86_sym(var);
+		op.imm = idx.val.imm / sym->width * sym->block + idx.val.imm % sym->width * siz;
+		return op;
+	}
+	unsigned int scale = 1;
+	if (sym->width > 1) {
+		x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), x86_location(x86, idx.val.reg));
+		x86_element_offset(x86, sym, siz);
+	} else {
+		x86_move(x86, x86_reg(X86_RCX, DOIL_QWORD), x86_location(x86, idx.val.reg));
+		if (sym->block == 1 || sym->block == 2 || sym->block == 4 || sym->block == 8) {
+			scale = sym->block;
+		} else {
+			x86_emit(x86, X86_IMUL, x86_reg(X86_RCX, DOIL_QWORD), x86_imm(sym->block));
+		}
+	}
+	x86_operand_t base = x86_sym(var);
+	base.siz = DOIL_QWORD;
+	x86_emit(x86, X86_LEA, x86_reg(X86_RAX, DOIL_QWORD), base);
+	return x86_sib(X86_RAX, X86_RCX, scale, 0, var->datatype);
+}
+
+/* wrap a 64 bits register around type, like doil_wrap */
+void
+x86_extend(x86_t *x86, unsigned int reg, doil_type_t type) {
+	if (type.siz == DOIL_QWORD) return;
+	if (type.is_signed) {
+		x86_emit(x86, X86_MOVSX, x86_reg(reg, DOIL_QWORD), x86_reg(reg, type.siz));
+	} else if (type.siz == DOIL_DWORD) {
+		x86_emit(x86, X86_MOV, x86_reg(reg, DOIL_DWORD), x86_reg(reg, DOIL_DWORD));
+	} else {
+		x86_emit(x86, X86_MOVZX, x86_reg(reg, DOIL_QWORD), x86_reg(reg, type.siz));
+	}
+}
+
+/* whether the elements of var follow each other, the ones of an aos or aosoa layout don't */
+int
+x86_contiguous(x86_t *x86, identifier_t *var) {
+	x86_symbol_t *sym = &x86->syms[var->symbol];
+	return sym->width == 1 && sym->block == 1u << var->datatype;
+}
+
+/* the operand of an array for the element at rcx bytes from the start of base, which is in rdx */
+x86_operand_t
+x86_elementwise_operand(x86_t *x86, identifier_t *base, reg_or_const op) {
+	identifier_t *var = &ids[op.val.var];
+	return x86_sib(X86_RDX, X86_RCX, 1, (long long)x86->syms[var->symbol].offset - x86->syms[base->symbol].offset, var->datatype);
+}
+
+/* an element-wise operation, lhs, rhs and out address the elements of its arrays rcx bytes into a run of them */
+typedef struct {
+	unsigned int type;
+	doil_type_t datatype;
+	reg_or_const l, r;
+	x86_operand_t lhs, rhs, out;
+	x86_operand_t value; /* the same for every element, when one side isn't an array */
+} x86_elementwise_t;
+
+/* the sides of an element-wise operation, a value goes to the right of what's commutative */
+x86_elementwise_t
+x86_elementwise_sides(x86_t *x86, instruction_t *ins) {
+	x86_elementwise_t e = { .type = ins->type, .datatype = doil_variable_type(&ids[ins->vec.dst]), .l = ins->vec.lhs, .r = ins->vec.rhs };
+	if (!e.l.is_var && ins->type != DOIL_VSUB && ins->type != DOIL_VDIV) {
+		e.l = ins->vec.rhs;
+		e.r = ins->vec.lhs;
+	}
+	if (!e.l.is_var || !e.r.is_var) e.value = x86_operand(x86, e.l.is_var ? e.r : e.l);
+	if (e.value.type == X86_IMM) e.value.imm = doil_wrap(e.value.imm, e.datatype);
+	return e;
+}
+
+/* sse2 has no multiplication of bytes, double words (that's sse4.1) and quad words */
+int
+x86_elementwise_vectorized(x86_elementwise_t *e) {
+	if (e->type == DOIL_VDIV) return 0;
+	return e->type != DOIL_VMUL || e->datatype.siz == DOIL_WORD || (e->datatype.siz == DOIL_DWORD && march >= MARCH_SSE4_1);
+}
+
+/* the value of an element-wise operation in every element of xmm1, or of ymm1 */
+void
+x86_elementwise_broadcast(x86_t *x86, x86_elementwise_t *e, unsigned int width) {
+	unsigned int siz = e->datatype.siz, esiz = 1 << siz;
+	if (e->value.type == X86_IMM) {
+		/* the value in every element of a quad word, then of the whole register */
+		unsigned long long pattern = e->value.imm & (esiz == 8 ? ~0ull : (1ull << (esiz * 8)) - 1);
+		for (unsigned int i = esiz; i < 8; i *= 2) pattern |= pattern << (i * 8);
+		x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), x86_imm(pattern));
+	} else {
+		x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), e->value);
+		x86_extend(x86, X86_RAX, (doil_type_t){ siz, 0 });
+		if (esiz < 8) {
+			x86_move(x86, x86_reg(X86_RCX, DOIL_QWORD), x86_imm(~0ull / ((1ull << (esiz * 8)) - 1)));
+			x86_emit(x86, X86_IMUL, x86_reg(X86_RAX, DOIL_QWORD), x86_reg(X86_RCX, DOIL_QWORD));
+		}
+	}
+	x86_emit(x86, X86_MOVQ, x86_xmm(1, DOIL_QWORD), x86_reg(X86_RAX, DOIL_QWORD));
+	if (width == 32) x86_emit(x86, X86_VPBROADCASTQ, x86_vec(1, DOIL_QWORD, width), x86_xmm(1, DOIL_QWORD));
+	else             x86_emit(x86, X86_PUNPCKLQDQ, x86_xmm(1, DOIL_QWORD), x86_xmm(1, DOIL_QWORD));
+}
+
+/* the elements from rcx = 0 to bytes, width bytes of them at a time, the value is already broadcast */
+void
+x86_elementwise_vectors(x86_t *x86, x86_elementwise_t *e, x86_operand_t lhs, x86_operand_t rhs, x86_operand_t out, unsigned int width, unsigned int bytes, int looped) {
+	unsigned int loop = x86->labels_count;
+	if (looped) {
+		x86->labels_count++;
+		x86_emit(x86, X86_LABEL, (x86_operand_t){0}, x86_label(loop));
+	}
+	x86_operand_t acc = x86_vec(0, e->datatype.siz, width), other = x86_vec(1, e->datatype.siz, width);
+	if (e->l.is_var) {
+		x86_emit(x86, X86_MOVDQU, acc, lhs);
+	} else {
+		x86_emit(x86, X86_MOVDQU, acc, other);
+	}
+	if (e->r.is_var) {
+		other = x86_vec(2, e->datatype.siz, width);
+		x86_emit(x86, X86_MOVDQU, other, rhs);
+	}
+	x86_emit(x86, e->type == DOIL_VADD ? X86_PADD : e->type == DOIL_VSUB ? X86_PSUB : X86_PMULL, acc, other);
+	x86_emit(x86, X86_MOVDQU, out, acc);
+	if (looped) {
+		x86_emit(x86, X86_ADD, x86_reg(X86_RCX, DOIL_QWORD), x86_imm(width));
+		x86_emit(x86, X86_CMP, x86_reg(X86_RCX, DOIL_QWORD), x86_imm(bytes));
+		x86_emit(x86, X86_JB, (x86_operand_t){0}, x86_label(loop));
+	}
+}
+
+/* the elements from rcx to total bytes one at a time in rax, computed from at least 32 bits, which leaves the same low bits */
+void
+x86_elementwise_scalars(x86_t *x86, x86_elementwise_t *e, x86_operand_t value, unsigned int total) {
+	unsigned int siz = e->datatype.siz, wide = siz == DOIL_QWORD ? DOIL_QWORD : DOIL_DWORD;
+	x86_operand_t operand = value;
+	if (operand.type == X86_IMM && wide == DOIL_DWORD) operand.imm = (int)operand.imm;
+	if (operand.type == X86_REG) operand.siz = wide;
+	unsigned int loop = x86->labels_count++;
+	x86_emit(x86, X86_LABEL, (x86_operand_t){0}, x86_label(loop));
+	if (e->l.is_var) x86_load(x86, X86_RAX, e->lhs, 0);
+	else             x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), value);
+	unsigned int op = e->type == DOIL_VADD ? X86_ADD : e->type == DOIL_VSUB ? X86_SUB : X86_IMUL;
+	if (!e->r.is_var) {
+		x86_emit(x86, op, x86_reg(X86_RAX, wide), operand);
+	} else if (op == X86_IMUL && siz == DOIL_BYTE) {
+		/* ax = al * the byte */
+		x86_emit(x86, X86_MUL, e->rhs, (x86_operand_t){0});
+	} else {
+		x86_emit(x86, op, x86_reg(X86_RAX, siz), e->rhs);
+	}
+	x86_emit(x86, X86_MOV, e->out, x86_reg(X86_RAX, siz));
+	x86_emit(x86, X86_ADD, x86_reg(X86_RCX, DOIL_QWORD), x86_imm(1 << siz));
+	x86_emit(x86, X86_CMP, x86_reg(X86_RCX, DOIL_QWORD), x86_imm(total));
+	x86_emit(x86, X86_JB, (x86_operand_t){0}, x86_label(loop));
+}
+
+/* the elements from rcx to total bytes divided one at a time, the constant side is in divisor or dividend */
+void
+x86_elementwise_quotients(x86_t *x86, x86_elementwise_t *e, unsigned int divisor, unsigned int dividend, unsigned int total) {
+	doil_type_t type = e->datatype;
+	unsigned int loop = x86->labels_count++;
+	x86_emit(x86, X86_LABEL, (x86_operand_t){0}, x86_label(loop));
+	if (e->l.is_var) x86_load(x86, X86_RAX, e->lhs, type.is_signed);
+	else             x86_emit(x86, X86_MOV, x86_reg(X86_RAX, DOIL_QWORD), x86_reg(dividend, DOIL_QWORD));
+	if (e->r.is_var) x86_load(x86, divisor, e->rhs, type.is_signed);
+	if (type.is_signed) {
+		x86_emit_none(x86, X86_CQO);
+		x86_emit(x86, X86_IDIV, x86_reg(divisor, DOIL_QWORD), (x86_operand_t){0});
+	} else {
+		x86_emit(x86, X86_XOR, x86_reg(X86_RDX, DOIL_DWORD), x86_reg(X86_RDX, DOIL_DWORD));
+		x86_emit(x86, X86_DIV, x86_reg(divisor, DOIL_QWORD), (x86_operand_t){0});
+	}
+	x86_emit(x86, X86_MOV, e->out, x86_reg(X86_RAX, type.siz));
+	x86_emit(x86, X86_ADD, x86_reg(X86_RCX, DOIL_QWORD), x86_imm(1u << type.siz));
+	x86_emit(x86, X86_CMP, x86_reg(X86_RCX, DOIL_QWORD), x86_imm(total));
+	x86_emit(x86, X86_JB, (x86_operand_t){0}, x86_label(loop));
+}
+
+/*
+ * an element-wise operation on arrays of an aos or aosoa layout. the elements are done a run at a
+ * time, as many as the gcd of the widths of the layouts, which follow each other in every array:
+ * a block of an aosoa 4 of i8 is a ymm register, an aos is done an element at a time. when every
+ * layout has that width the address of a run moves by a block, otherwise it's computed again.
+ */
+void
+x86_elementwise_runs(x86_t *x86, x86_elementwise_t *e, identifier_t *dst) {
+	static const unsigned int candidates[] = { X86_RSI, X86_RDI, X86_R8, X86_R9, X86_R10, X86_R11 };
+	/* every array once, with the one of each side */
+	identifier_t *arrays[3] = { dst };
+	unsigned int arrays_count = 1, esiz = 1 << e->datatype.siz, run = 0, sides[2] = {0};
+	for (unsigned int k = 0; k < 2; k++) {
+		reg_or_const side = k ? e->r : e->l;
+		if (!side.is_var) continue;
+		while (sides[k] < arrays_count && arrays[sides[k]] != &ids[side.val.var]) sides[k]++;
+		if (sides[k] == arrays_count) arrays[arrays_count++] = &ids[side.val.var];
+	}
+	for (unsigned int i = 0; i < arrays_count; i++) {
+		if (x86_contiguous(x86, arrays[i])) continue;
+		for (unsigned int w = x86->syms[arrays[i]->symbol].width; w;) {
+			unsigned int rest = run % w;
+			run = w;
+			w = rest;
+		}
+	}
+	unsigned int strides[3];
+	int stepped = 1;
+	for (unsigned int i = 0; i < arrays_count; i++) {
+		x86_symbol_t *sym = &x86->syms[arrays[i]->symbol];
+		if (x86_contiguous(x86, arrays[i])) strides[i] = run * esiz;
+		else if (sym->width == run)         strides[i] = sym->block;
+		else                                stepped = 0;
+	}
+
+	/* the first element of the run, the address of every array, then the divisor and the dividend or the value */
+	int has_value = !e->l.is_var || !e->r.is_var;
+	unsigned int regs[6] = {0}, regs_count = 0, needed = 1 + arrays_count + (e->type == DOIL_VDIV ? 1 + !e->l.is_var : has_value);
+	for (unsigned int i = 0; i < sizeof(candidates) / sizeof(candidates[0]) && regs_count < needed; i++) {
+		if (e->value.type == X86_REG && e->value.reg == candidates[i]) continue;
+		regs[regs_count++] = candidates[i];
+		x86_emit(x86, X86_PUSH, x86_reg(candidates[i], DOIL_QWORD), (x86_operand_t){0});
+	}
+	unsigned int index = regs[0], *addresses = &regs[1], extra = 1 + arrays_count, divisor = regs[extra], dividend = regs[extra + 1];
+	if (e->type == DOIL_VDIV && has_value) {
+		unsigned int reg = e->l.is_var ? divisor : dividend;
+		x86_move(x86, x86_reg(reg, DOIL_QWORD), e->value);
+		if (e->value.type != X86_IMM) x86_extend(x86, reg, e->datatype);
+	} else if (has_value) {
+		x86_move(x86, x86_reg(regs[extra], DOIL_QWORD), e->value);
+		e->value = x86_reg(regs[extra], DOIL_QWORD);
+	}
+	e->lhs = x86_sib(addresses[sides[0]], X86_RCX, 1, 0, e->datatype.siz);
+	e->rhs = x86_sib(addresses[sides[1]], X86_RCX, 1, 0, e->datatype.siz);
+	e->out = x86_sib(addresses[0], X86_RCX, 1, 0, e->datatype.siz);
+
+	unsigned int full = dst->length / run, rest = dst->length % run;
+	unsigned int most = (full ? run : rest) * esiz, width = march == MARCH_AVX2 && most >= 32 ? 32 : 16;
+	int vectorized = x86_elementwise_vectorized(e) && most >= 16, dirty = 0;
+	if (vectorized && has_value) {
+		x86_elementwise_broadcast(x86, e, width);
+		dirty = width == 32;
+	}
+	if (stepped) {
+		for (unsigned int i = 0; i < arrays_count; i++) {
+			x86_operand_t base = x86_sym(arrays[i]);
+			base.siz = DOIL_QWORD;
+			x86_emit(x86, X86_LEA, x86_reg(addresses[i], DOIL_QWORD), base);
+		}
+	}
+	if (!stepped || full > 1) x86_emit(x86, X86_XOR, x86_reg(index, DOIL_DWORD), x86_reg(index, DOIL_DWORD));
+	unsigned int loop = x86->labels_count;
+	for (unsigned int k = 0; k < 2; k++) {
+		/* the full runs in a loop, then what is left of the last block */
+		unsigned int elements = k ? rest : run;
+		if (!(k ? rest : full)) continue;
+		if (!k && full > 1) {
+			x86->labels_count++;
+			x86_emit(x86, X86_LABEL, (x86_operand_t){0}, x86_label(loop));
+		}
+		for (unsigned int i = 0; !stepped && i < arrays_count; i++) {
+			/* offset + index / width * block + index % width * siz */
+			x86_symbol_t *sym = &x86->syms[arrays[i]->symbol];
+			if (sym->width > 1) {
+				x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), x86_reg(index, DOIL_QWORD));
+				x86_element_offset(x86, sym, esiz);
+			} else {
+				x86_move(x86, x86_reg(X86_RCX, DOIL_QWORD), x86_reg(index, DOIL_QWORD));
+				x86_emit(x86, X86_IMUL, x86_reg(X86_RCX, DOIL_QWORD), x86_imm(sym->block));
+			}
+			x86_operand_t base = x86_sym(arrays[i]);
+			base.siz = DOIL_QWORD;
+			x86_emit(x86, X86_LEA, x86_reg(addresses[i], DOIL_QWORD), base);
+			x86_emit(x86, X86_ADD, x86_reg(addresses[i], DOIL_QWORD), x86_reg(X86_RCX, DOIL_QWORD));
+		}
+		unsigned int bytes = elements * esiz;
+		if (e->type == DOIL_VDIV) {
+			x86_emit(x86, X86_XOR, x86_reg(X86_RCX, DOIL_DWORD), x86_reg(X86_RCX, DOIL_DWORD));
+			x86_elementwise_quotients(x86, e, divisor, dividend, bytes);
+		} else {
+			unsigned int w = march == MARCH_AVX2 && bytes >= 32 ? 32 : 16;
+			unsigned int vector_bytes = vectorized ? bytes / w * w : 0;
+			if (vector_bytes != w) x86_emit(x86, X86_XOR, x86_reg(X86_RCX, DOIL_DWORD), x86_reg(X86_RCX, DOIL_DWORD));
+			if (vector_bytes) {
+				/* sse after avx, without clearing the upper halves first, is slow */
+				if (w == 16 && dirty) x86_emit_none(x86, X86_VZEROUPPER);
+				dirty = w == 32;
+				/* a single register is addressed from the start of the run */
+				x86_operand_t lhs = e->lhs, rhs = e->rhs, out = e->out;
+				if (vector_bytes == w) lhs.scale = rhs.scale = out.scale = 0;
+				x86_elementwise_vectors(x86, e, lhs, rhs, out, w, vector_bytes, vector_bytes > w);
+			}
+			if (vector_bytes == w && vector_bytes < bytes) x86_emit(x86, X86_MOV, x86_reg(X86_RCX, DOIL_DWORD), x86_imm(vector_bytes));
+			if (vector_bytes < bytes) x86_elementwise_scalars(x86, e, e->value, bytes);
+		}
+		if (k) continue;
+		for (unsigned int i = 0; stepped && i < arrays_count && (full > 1 || rest); i++) {
+			x86_emit(x86, X86_ADD, x86_reg(addresses[i], DOIL_QWORD), x86_imm(strides[i]));
+		}
+		if (full > 1 || (!stepped && rest)) x86_emit(x86, X86_ADD, x86_reg(index, DOIL_QWORD), x86_imm(run));
+		if (full > 1) {
+			x86_emit(x86, X86_CMP, x86_reg(index, DOIL_QWORD), x86_imm(full * run));
+			x86_emit(x86, X86_JB, (x86_operand_t){0}, x86_label(loop));
+		}
+	}
+	if (dirty) x86_emit_none(x86, X86_VZEROUPPER);
+	while (regs_count) x86_emit(x86, X86_POP, x86_reg(regs[--regs_count], DOIL_QWORD), (x86_operand_t){0});
+}
+
+/*
+ * dst[i] = lhs[i] op rhs[i] for every element, where either side can be a value for every element.
+ * the elements are done by as many xmm or ymm registers as they fill, then one at a time.
+ */
+void
+x86_elementwise(x86_t *x86, instruction_t *ins) {
+	identifier_t *dst = &ids[ins->vec.dst];
+	x86_elementwise_t e = x86_elementwise_sides(x86, ins);
+	if (!x86_contiguous(x86, dst) || (e.l.is_var && !x86_contiguous(x86, &ids[e.l.val.var])) || (e.r.is_var && !x86_contiguous(x86, &ids[e.r.val.var]))) {
+		x86_elementwise_runs(x86, &e, dst);
+		return;
+	}
+	unsigned int siz = dst->datatype, esiz = 1 << siz, total = dst->length * esiz;
+	e.lhs = e.l.is_var ? x86_elementwise_operand(x86, dst, e.l) : e.value;
+	e.rhs = e.r.is_var ? x86_elementwise_operand(x86, dst, e.r) : e.value;
+	e.out = x86_elementwise_operand(x86, dst, doil_variable(ins->vec.dst));
+	x86_operand_t value = e.value;
+
+	/* an array smaller than a ymm register still fills an xmm one */
+	unsigned int width = march == MARCH_AVX2 && total >= 32 ? 32 : 16;
+	unsigned int vector_bytes = x86_elementwise_vectorized(&e) ? total / width * width : 0;
+	/* a single register of elements is addressed directly, without a loop */
+	int once = vector_bytes == width;
+	x86_operand_t vlhs = e.lhs, vrhs = e.rhs, vout = e.out;
+	if (once) {
+		if (e.l.is_var) vlhs = x86_sym(&ids[e.l.val.var]);
+		if (e.r.is_var) vrhs = x86_sym(&ids[e.r.val.var]);
+		vout = x86_sym(dst);
+	}
+
+	if (vector_bytes) {
+		if (!e.l.is_var || !e.r.is_var) x86_elementwise_broadcast(x86, &e, width);
+		if (!once) {
+			x86_operand_t base = x86_sym(dst);
+			base.siz = DOIL_QWORD;
+			x86_emit(x86, X86_LEA, x86_reg(X86_RDX, DOIL_QWORD), base);
+			x86_emit(x86, X86_XOR, x86_reg(X86_RCX, DOIL_DWORD), x86_reg(X86_RCX, DOIL_DWORD));
+		}
+		x86_elementwise_vectors(x86, &e, vlhs, vrhs, vout, width, vector_bytes, !once);
+		if (width == 32) x86_emit_none(x86, X86_VZEROUPPER);
+	}
+	if (vector_bytes == total) return;
+
+	/* the remaining elements, with a value that isn't a register or a 32 bits immediate in a saved one */
+	unsigned int saved = X86_RIP;
+	if ((!e.l.is_var || !e.r.is_var) && (value.type == X86_MEM || (value.type == X86_IMM && !fits_i32(value.imm)))) {
+		saved = value.type == X86_REG && value.reg == X86_RSI ? X86_RDI : X86_RSI;
+		x86_emit(x86, X86_PUSH, x86_reg(saved, DOIL_QWORD), (x86_operand_t){0});
+		x86_move(x86, x86_reg(saved, DOIL_QWORD), value);
+		value = x86_reg(saved, DOIL_QWORD);
+	}
+	if (!vector_bytes || once) {
+		x86_operand_t base = x86_sym(dst);
+		base.siz = DOIL_QWORD;
+		x86_emit(x86, X86_LEA, x86_reg(X86_RDX, DOIL_QWORD), base);
+		if (once) x86_emit(x86, X86_MOV, x86_reg(X86_RCX, DOIL_DWORD), x86_imm(vector_bytes));
+		else      x86_emit(x86, X86_XOR, x86_reg(X86_RCX, DOIL_DWORD), x86_reg(X86_RCX, DOIL_DWORD));
+	}
+	x86_elementwise_scalars(x86, &e, value, total);
+	if (saved != X86_RIP) x86_emit(x86, X86_POP, x86_reg(saved, DOIL_QWORD), (x86_operand_t){0});
+}
+
+/*
+ * dst[i] = lhs[i] / rhs[i] one element at a time, there is no vector division. div needs rdx,
+ * so the address of dst and the operands are in registers saved around the loop.
+ */
+void
+x86_elementwise_divide(x86_t *x86, instruction_t *ins) {
+	static const unsigned int candidates[] = { X86_RSI, X86_RDI, X86_R8, X86_R9 };
+	identifier_t *dst = &ids[ins->vec.dst];
+	x86_elementwise_t e = x86_elementwise_sides(x86, ins);
+	if (!x86_contiguous(x86, dst) || (e.l.is_var && !x86_contiguous(x86, &ids[e.l.val.var])) || (e.r.is_var && !x86_contiguous(x86, &ids[e.r.val.var]))) {
+		x86_elementwise_runs(x86, &e, dst);
+		return;
+	}
+	e.lhs = e.l.is_var ? x86_elementwise_operand(x86, dst, e.l) : e.value;
+	e.rhs = e.r.is_var ? x86_elementwise_operand(x86, dst, e.r) : e.value;
+	e.out = x86_elementwise_operand(x86, dst, doil_variable(ins->vec.dst));
+
+	/* the base, the divisor and, when it is the same for every element, the dividend */
+	unsigned int regs[3] = {0}, regs_count = 0;
+	for (unsigned int i = 0; i < sizeof(candidates) / sizeof(candidates[0]) && regs_count < 3u - e.l.is_var; i++) {
+		if (e.value.type == X86_REG && e.value.reg == candidates[i]) continue;
+		regs[regs_count++] = candidates[i];
+		x86_emit(x86, X86_PUSH, x86_reg(candidates[i], DOIL_QWORD), (x86_operand_t){0});
+	}
+	unsigned int base = regs[0], divisor = regs[1], dividend = regs[2];
+	if (!e.l.is_var || !e.r.is_var) {
+		unsigned int reg = e.l.is_var ? divisor : dividend;
+		x86_move(x86, x86_reg(reg, DOIL_QWORD), e.value);
+		if (e.value.type != X86_IMM) x86_extend(x86, reg, e.datatype);
+	}
+	x86_operand_t address = x86_sym(dst);
+	address.siz = DOIL_QWORD;
+	x86_emit(x86, X86_LEA, x86_reg(base, DOIL_QWORD), address);
+	x86_emit(x86, X86_XOR, x86_reg(X86_RCX, DOIL_DWORD), x86_reg(X86_RCX, DOIL_DWORD));
+	e.lhs.reg = e.rhs.reg = e.out.reg = base;
+	x86_elementwise_quotients(x86, &e, divisor, dividend, dst->length << e.datatype.siz);
+	while (regs_count) x86_emit(x86, X86_POP, x86_reg(regs[--regs_count], DOIL_QWORD), (x86_operand_t){0});
+}
+
+/* what a function called from C gives back as it found it, besides rbp and rsp */
+static const unsigned int x86_callee_saved[] = { X86_RBX, X86_R12, X86_R13, X86_R14, X86_R15 };
+
+/* with the status in rdi */
+void
+x86_exit(x86_t *x86) {
+	if (x86->exit) {
+		/* exit doesn't return, the stack only has to be aligned for it */
+		x86_emit(x86, X86_AND, x86_reg(X86_RSP, DOIL_QWORD), x86_imm(-16));
+		x86_emit(x86, X86_CALL, (x86_operand_t){0}, x86_sym(x86->exit));
+		return;
+	}
+	x86_emit(x86, X86_MOV, x86_reg(X86_RAX, DOIL_DWORD), x86_imm(60));
+	x86_emit_none(x86, X86_SYSCALL);
+}
+
+void
+x86_frame(x86_t *x86) {
+	x86_emit(x86, X86_PUSH, x86_reg(X86_RBP, DOIL_QWORD), (x86_operand_t){0});
+	x86_emit(x86, X86_MOV, x86_reg(X86_RBP, DOIL_QWORD), x86_reg(X86_RSP, DOIL_QWORD));
+	if (x86->slots_count) {
+		x86_emit(x86, X86_SUB, x86_reg(X86_RSP, DOIL_QWORD), x86_imm(align(x86->slots_count * 8, 16)));
+	}
+}
+
+/* whether a and b are the same register or stack slot */
+#define x86_same_place(a, b) ((a).type == (b).type && (a).type != X86_IMM && (a).reg == (b).reg && ((a).type == X86_REG || (a).imm == (b).imm))
+
+/*
+ * dst[i] = src[i] for every i at once. a register or stack slot is only written once no other move
+ * reads it, and a cycle is broken by keeping one of them in rax, or in rcx when x86_move itself
+ * needs rax to write to the stack.
+ */
+void
+x86_parallel_move(x86_t *x86, x86_operand_t *dst, x86_operand_t *src, unsigned int count) {
+	unsigned char *done = calloc(count + 1, 1);
+	unsigned int left = count, temp = X86_RAX;
+	for (unsigned int i = 0; i < count; i++) {
+		if (dst[i].type == X86_MEM && (src[i].type == X86_MEM || (src[i].type == X86_IMM && !fits_i32(src[i].imm)))) temp = X86_RCX;
+	}
+	while (left) {
+		int moved = 0;
+		for (unsigned int i = 0; i < count; i++) {
+			if (done[i]) continue;
+			unsigned int j = 0;
+			while (j < count && (done[j] || j == i || !x86_same_place(src[j], dst[i]))) j++;
+			if (j < count) continue;
+			x86_move(x86, dst[i], src[i]);
+			done[i] = 1;
+			left--;
+			moved = 1;
+		}
+		if (moved) continue;
+		unsigned int i = 0;
+		while (done[i]) i++;
+		x86_move(x86, x86_reg(temp, DOIL_QWORD), dst[i]);
+		for (unsigned int j = 0; j < count; j++) {
+			if (!done[j] && x86_same_place(src[j], dst[i])) src[j] = x86_reg(temp, DOIL_QWORD);
+		}
+	}
+	free(done);
+}
+
+/* a function written in C also wants the stack aligned to 16 bytes, and only sets the bits of its type */
+void
+x86_call(x86_t *x86, instruction_t *ins) {
+	system_t *sys = &systems[ins->call.system];
+	x86_operand_t dst[DOIL_MAX_PARAMS], src[DOIL_MAX_PARAMS];
+	for (unsigned int i = 0; i < ins->call.args_count; i++) {
+		dst[i] = x86_reg(x86_arguments[i], DOIL_QWORD);
+		src[i] = x86_operand(x86, ins->call.args[i]);
+	}
+	x86_parallel_move(x86, dst, src, ins->call.args_count);
+	if (!sys->is_extern) {
+		x86_emit(x86, X86_CALL, (x86_operand_t){0}, x86_label(x86->functions[ins->call.system].label));
+	} else {
+		x86_emit(x86, X86_MOV, x86_reg(X86_RAX, DOIL_QWORD), x86_reg(X86_RSP, DOIL_QWORD));
+		x86_emit(x86, X86_AND, x86_reg(X86_RSP, DOIL_QWORD), x86_imm(-16));
+		x86_emit(x86, X86_PUSH, x86_reg(X86_RAX, DOIL_QWORD), (x86_operand_t){0});
+		x86_emit(x86, X86_PUSH, x86_reg(X86_RAX, DOIL_QWORD), (x86_operand_t){0});
+		x86_emit(x86, X86_CALL, (x86_operand_t){0}, x86_sym(&ids[sys->id]));
+		x86_emit(x86, X86_MOV, x86_reg(X86_RSP, DOIL_QWORD), x86_mem(X86_RSP, 0, DOIL_QWORD));
+		if (sys->returns) x86_extend(x86, X86_RAX, ins->call.type);
+	}
+	if (ins->call.dst != ID_NONE) x86_move(x86, x86_location(x86, ins->call.dst), x86_reg(X86_RAX, DOIL_QWORD));
+}
+
+/* a jmp, or a jcc when type is X86_JCC, to the label of a block */
+void
+x86_jump(x86_t *x86, unsigned int type, unsigned int cc, unsigned int block) {
+	x86_emit(x86, type, (x86_operand_t){0}, x86_label(x86->block_label + block))->cc = cc;
+}
+
+/* the phis of block to take their arguments for the edge from block from, all at once */
+void
+x86_phi_moves(x86_t *x86, doil_t *doil, unsigned int from, unsigned int to) {
+	block_t *blk = &doil->blocks[to];
+	unsigned int i = 0, count = 0;
+	while (blk->preds[i] != from) i++;
+	for (instruction_t *ins = blk->head->nxt; ins && ins->type == DOIL_PHI; ins = ins->nxt) count++;
+	if (!count) return;
+	x86_operand_t *dst = malloc(sizeof(x86_operand_t) * count), *src = malloc(sizeof(x86_operand_t) * count);
+	count = 0;
+	for (instruction_t *ins = blk->head->nxt; ins && ins->type == DOIL_PHI; ins = ins->nxt) {
+		dst[count] = x86_location(x86, ins->phi.dst);
+		src[count++] = x86_operand(x86, ins->phi.args[i]);
+	}
+	x86_parallel_move(x86, dst, src, count);
+	free(dst);
+	free(src);
+}
+
+/* an operand of a comparison converted to its type, in scratch when it has to be */
+x86_operand_t
+x86_comparand(x86_t *x86, doil_t *doil, reg_or_const op, doil_type_t type, unsigned int scratch) {
+	if (!op.is_reg) {
+		long long imm = doil_wrap(op.val.imm, type);
+		if (fits_i32(imm)) return x86_imm(imm);
+		x86_emit(x86, X86_MOV, x86_reg(scratch, DOIL_QWORD), x86_imm(imm));
+		return x86_reg(scratch, DOIL_QWORD);
+	}
+	if (doil_type_fits(doil->registers[op.val.reg].type, type)) return x86_location(x86, op.val.reg);
+	x86_move(x86, x86_reg(scratch, DOIL_QWORD), x86_location(x86, op.val.reg));
+	x86_extend(x86, scratch, type);
+	return x86_reg(scratch, DOIL_QWORD);
+}
+
+/* cmp the operands of a comparison, returns the condition code that holds when it is true */
+unsigned int
+x86_compare(x86_t *x86, doil_t *doil, instruction_t *ins) {
+	doil_type_t type = ins->ope.type;
+	x86_operand_t lhs = x86_comparand(x86, doil, ins->ope.lhs, type, X86_RAX);
+	x86_operand_t rhs = x86_comparand(x86, doil, ins->ope.rhs, type, X86_RCX);
+	if (lhs.type == X86_IMM || (lhs.type == X86_MEM && rhs.type == X86_MEM)) {
+		x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), lhs);
+		lhs = x86_reg(X86_RAX, DOIL_QWORD);
+	}
+	x86_emit(x86, X86_CMP, lhs, rhs);
+	switch (ins->type) {
+		case DOIL_LT: return type.is_signed ? X86_CC_L : X86_CC_B;
+		case DOIL_LE: return type.is_signed ? X86_CC_LE : X86_CC_BE;
+		case DOIL_EQ: return X86_CC_E;
+		case DOIL_NE: return X86_CC_NE;
+		default:      assert(0 && "unreachable"); return 0;
+	}
+}
+
+void
+x86_lower_instruction(x86_t *x86, doil_t *doil, instruction_t *ins) {
+	identifier_t *var;
+	instruction_t *def;
+	x86_operand_t dst, lhs, rhs;
+	unsigned int work, cc;
+	switch (ins->type) {
+		case DOIL_DEF:
+			break;
+		case DOIL_MOV:
+			x86_move(x86, x86_location(x86, ins->mov.reg), x86_operand(x86, ins->mov.val));
+			break;
+		case DOIL_GET:
+			dst = x86_location(x86, ins->get.reg);
+			work = x86_work_register(dst, (x86_operand_t){0});
+			x86_load_variable(x86, work, &ids[ins->get.var]);
+			x86_move(x86, dst, x86_reg(work, DOIL_QWORD));
+			break;
+		case DOIL_SET:
+			if (ins->set.dst.is_reg) {
+				x86_move(x86, x86_location(x86, ins->set.dst.val.reg), x86_operand(x86, ins->set.src));
+			} else {
+				var = &ids[ins->set.dst.val.var];
+				x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), x86_operand(x86, ins->set.src));
+				x86_emit(x86, X86_MOV, x86_sym(var), x86_reg(X86_RAX, var->datatype));
+			}
+			break;
+		case DOIL_ADD:
+		case DOIL_SUB:
+		case DOIL_MUL:
+			dst = x86_location(x86, ins->ope.dst);
+			lhs = x86_operand(x86, ins->ope.lhs);
+			rhs = x86_operand(x86, ins->ope.rhs);
+			if (ins->type == DOIL_MUL && rhs.type == X86_IMM && (rhs.imm == 3 || rhs.imm == 5 || rhs.imm == 9)) {
+				/* x * 3, 5 or 9 is x + x * 2, 4 or 8 */
+				work = x86_work_register(dst, (x86_operand_t){0});
+				if (lhs.type != X86_REG) {
+					x86_move(x86, x86_reg(work, DOIL_QWORD), lhs);
+					lhs = x86_reg(work, DOIL_QWORD);
+				}
+				x86_emit(x86, X86_LEA, x86_reg(work, DOIL_QWORD), x86_sib(lhs.reg, lhs.reg, rhs.imm - 1, 0, DOIL_QWORD));
+				x86_extend(x86, work, ins->ope.type);
+				x86_move(x86, dst, x86_reg(work, DOIL_QWORD));
+				break;
+			}
+			if (ins->type != DOIL_SUB && rhs.type == X86_REG && dst.type == X86_REG && rhs.reg == dst.reg) {
+				x86_operand_t tmp = lhs;
+				lhs = rhs;
+				rhs = tmp;
+			}
+			if (rhs.type == X86_IMM && !fits_i32(rhs.imm)) {
+				x86_move(x86, x86_reg(X86_RCX, DOIL_QWORD), rhs);
+				rhs = x86_reg(X86_RCX, DOIL_QWORD);
+			}
+			work = x86_work_register(dst, rhs);
+			x86_move(x86, x86_reg(work, DOIL_QWORD), lhs);
+			x86_emit(x86, ins->type == DOIL_ADD ? X86_ADD : ins->type == DOIL_SUB ? X86_SUB : X86_IMUL, x86_reg(work, DOIL_QWORD), rhs);
+			x86_extend(x86, work, ins->ope.type);
+			x86_move(x86, dst, x86_reg(work, DOIL_QWORD));
+			break;
+		case DOIL_DIV:
+			x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), x86_operand(x86, ins->ope.lhs));
+			x86_move(x86, x86_reg(X86_RCX, DOIL_QWORD), x86_operand(x86, ins->ope.rhs));
+			/* the operands are converted to the type of the division first */
+			x86_extend(x86, X86_RAX, ins->ope.type);
+			x86_extend(x86, X86_RCX, ins->ope.type);
+			if (ins->ope.type.is_signed) {
+				x86_emit_none(x86, X86_CQO);
+				x86_emit(x86, X86_IDIV, x86_reg(X86_RCX, DOIL_QWORD), (x86_operand_t){0});
+			} else {
+				x86_emit(x86, X86_XOR, x86_reg(X86_RDX, DOIL_DWORD), x86_reg(X86_RDX, DOIL_DWORD));
+				x86_emit(x86, X86_DIV, x86_reg(X86_RCX, DOIL_QWORD), (x86_operand_t){0});
+			}
+			x86_extend(x86, X86_RAX, ins->ope.type);
+			x86_move(x86, x86_location(x86, ins->ope.dst), x86_reg(X86_RAX, DOIL_QWORD));
+			break;
+		case DOIL_SHL:
+		case DOIL_SHR:
+			assert(!ins->ope.rhs.is_reg && "shifts are only made with a constant count");
+			dst = x86_location(x86, ins->ope.dst);
+			work = x86_work_register(dst, (x86_operand_t){0});
+			x86_move(x86, x86_reg(work, DOIL_QWORD), x86_operand(x86, ins->ope.lhs));
+			/* a right shift sees the operand converted to its type, a left one doesn't need to */
+			if (ins->type == DOIL_SHR && !(ins->ope.lhs.is_reg && doil_type_fits(doil->registers[ins->ope.lhs.val.reg].type, ins->ope.type))) {
+				x86_extend(x86, work, ins->ope.type);
+			}
+			x86_emit(x86, ins->type == DOIL_SHL ? X86_SHL : ins->ope.type.is_signed ? X86_SAR : X86_SHR, x86_reg(work, DOIL_QWORD), x86_imm(ins->ope.rhs.val.imm & 63));
+			x86_extend(x86, work, ins->ope.type);
+			x86_move(x86, dst, x86_reg(work, DOIL_QWORD));
+			break;
+		case DOIL_MULH:
+			x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), x86_operand(x86, ins->ope.lhs));
+			x86_move(x86, x86_reg(X86_RCX, DOIL_QWORD), x86_operand(x86, ins->ope.rhs));
+			x86_extend(x86, X86_RAX, ins->ope.type);
+			x86_extend(x86, X86_RCX, ins->ope.type);
+			x86_emit(x86, ins->ope.type.is_signed ? X86_IMUL : X86_MUL, x86_reg(X86_RCX, DOIL_QWORD), (x86_operand_t){0});
+			x86_extend(x86, X86_RDX, ins->ope.type);
+			x86_move(x86, x86_location(x86, ins->ope.dst), x86_reg(X86_RDX, DOIL_QWORD));
+			break;
+		case DOIL_CAST:
+			dst = x86_location(x86, ins->cast.dst);
+			work = x86_work_register(dst, (x86_operand_t){0});
+			x86_move(x86, x86_reg(work, DOIL_QWORD), x86_operand(x86, ins->cast.src));
+			x86_extend(x86, work, ins->cast.type);
+			x86_move(x86, dst, x86_reg(work, DOIL_QWORD));
+			break;
+		case DOIL_LOAD:
+			var = &ids[ins->elem.var];
+			dst = x86_location(x86, ins->elem.dst);
+			work = x86_work_register(dst, (x86_operand_t){0});
+			x86_load(x86, work, x86_element(x86, var, ins->elem.idx), var->is_signed);
+			x86_move(x86, dst, x86_reg(work, DOIL_QWORD));
+			break;
+		case DOIL_STORE:
+			var = &ids[ins->elem.var];
+			lhs = x86_element(x86, var, ins->elem.idx);
+			if (ins->elem.src.is_reg) {
+				x86_move(x86, x86_reg(X86_RDX, DOIL_QWORD), x86_location(x86, ins->elem.src.val.reg));
+				x86_emit(x86, X86_MOV, lhs, x86_reg(X86_RDX, var->datatype));
+			} else if (var->datatype == DOIL_QWORD && !fits_i32((long long)ins->elem.src.val.imm)) {
+				x86_emit(x86, X86_MOV, x86_reg(X86_RDX, DOIL_QWORD), x86_imm((long long)ins->elem.src.val.imm));
+				x86_emit(x86, X86_MOV, lhs, x86_reg(X86_RDX, DOIL_QWORD));
+			} else {
+				/* the constant as the assembler expects it for the width of the element */
+				x86_emit(x86, X86_MOV, lhs, x86_imm((long long)doil_wrap(ins->elem.src.val.imm, doil_variable_type(var))));
+			}
+			break;
+		case DOIL_CHECK:
+			/* idx < len as unsigned values, a negative index is out of bounds too */
+			lhs = x86_operand(x86, ins->check.idx);
+			rhs = x86_operand(x86, ins->check.len);
+			if (lhs.type != X86_REG) {
+				x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), lhs);
+				lhs = x86_reg(X86_RAX, DOIL_QWORD);
+			}
+			x86_emit(x86, X86_CMP, lhs, rhs);
+			x86_emit(x86, X86_JB, (x86_operand_t){0}, x86_imm(4));
+			x86_emit_none(x86, X86_UD2);
+			break;
+		case DOIL_LENGTH:
+			dst = x86_location(x86, ins->get.reg);
+			work = x86_work_register(dst, (x86_operand_t){0});
+			x86_emit(x86, X86_MOV, x86_reg(work, DOIL_QWORD), x86_slice_field(&ids[ins->get.var], 8));
+			x86_move(x86, dst, x86_reg(work, DOIL_QWORD));
+			break;
+		case DOIL_SLICE:
+			var = &ids[ins->slice.src];
+			assert(x86_contiguous(x86, var) && "layout_resolve keeps what is sliced out of aos and aosoa layouts");
+			lhs = x86_sym(var);
+			lhs.siz = DOIL_QWORD;
+			x86_emit(x86, X86_LEA, x86_reg(X86_RAX, DOIL_QWORD), lhs);
+			x86_emit(x86, X86_MOV, x86_slice_field(&ids[ins->slice.dst], 0), x86_reg(X86_RAX, DOIL_QWORD));
+			x86_emit(x86, X86_MOV, x86_slice_field(&ids[ins->slice.dst], 8), x86_imm(var->length));
+			break;
+		case DOIL_VADD:
+		case DOIL_VSUB:
+		case DOIL_VMUL:
+			x86_elementwise(x86, ins);
+			break;
+		case DOIL_VDIV:
+			x86_elementwise_divide(x86, ins);
+			break;
+		case DOIL_CALL:
+			x86_call(x86, ins);
+			break;
+		case DOIL_LT:
+		case DOIL_LE:
+		case DOIL_EQ:
+		case DOIL_NE:
+			if (doil_is_fused(doil, ins)) break;
+			dst = x86_location(x86, ins->ope.dst);
+			work = x86_work_register(dst, (x86_operand_t){0});
+			cc = x86_compare(x86, doil, ins);
+			x86_emit(x86, X86_SETCC, x86_reg(work, DOIL_BYTE), (x86_operand_t){0})->cc = cc;
+			x86_extend(x86, work, doil_bool);
+			x86_move(x86, dst, x86_reg(work, DOIL_QWORD));
+			break;
+		case DOIL_LABEL:
+			x86_emit(x86, X86_LABEL, (x86_operand_t){0}, x86_label(x86->block_label + ins->label.block));
+			break;
+		case DOIL_PHI:
+			/* the predecessors moved the arguments in already */
+			break;
+		case DOIL_JMP:
+			x86_phi_moves(x86, doil, ins->jmp.block, ins->jmp.target[0]);
+			x86_jump(x86, X86_JMP, 0, ins->jmp.target[0]);
+			break;
+		case DOIL_BR:
+			/* doil_split_critical_edges left no phi in the blocks a br goes to */
+			def = ins->jmp.cond.is_reg ? doil->registers[ins->jmp.cond.val.reg].def : NULL;
+			cc = X86_CC_NE;
+			if (doil_is_fused(doil, def)) {
+				cc = x86_compare(x86, doil, def);
+			} else {
+				lhs = x86_operand(x86, ins->jmp.cond);
+				if (lhs.type == X86_IMM) {
+					x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), lhs);
+					lhs = x86_reg(X86_RAX, DOIL_QWORD);
+				}
+				x86_emit(x86, X86_CMP, lhs, x86_imm(0));
+			}
+			x86_jump(x86, X86_JCC, cc, ins->jmp.target[0]);
+			x86_jump(x86, X86_JMP, 0, ins->jmp.target[1]);
+			break;
+		case DOIL_RET:
+			if (doil->system) {
+				if (!ins->ret.src.unused) x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), x86_operand(x86, ins->ret.src));
+				if (x86->slots_count) {
+					x86_emit(x86, X86_MOV, x86_reg(X86_RSP, DOIL_QWORD), x86_reg(X86_RBP, DOIL_QWORD));
+					x86_emit(x86, X86_POP, x86_reg(X86_RBP, DOIL_QWORD), (x86_operand_t){0});
+				}
+				x86_emit_none(x86, X86_RET);
+			} else if (output == OUTPUT_JIT) {
+				/* the logic was called by jit_run, it goes back to it instead of exiting */
+				if (ins->ret.src.unused) x86_emit(x86, X86_XOR, x86_reg(X86_RAX, DOIL_DWORD), x86_reg(X86_RAX, DOIL_DWORD));
+				else                     x86_move(x86, x86_reg(X86_RAX, DOIL_QWORD), x86_operand(x86, ins->ret.src));
+				x86_emit(x86, X86_MOV, x86_reg(X86_RSP, DOIL_QWORD), x86_reg(X86_RBP, DOIL_QWORD));
+				x86_emit(x86, X86_POP, x86_reg(X86_RBP, DOIL_QWORD), (x86_operand_t){0});
+				for (unsigned int i = sizeof(x86_callee_saved) / sizeof(x86_callee_saved[0]); i--;) {
+					x86_emit(x86, X86_POP, x86_reg(x86_callee_saved[i], DOIL_QWORD), (x86_operand_t){0});
+				}
+				x86_emit_none(x86, X86_RET);
+			} else if (ins->ret.src.unused) {
+				x86_emit(x86, X86_XOR, x86_reg(X86_RDI, DOIL_DWORD), x86_reg(X86_RDI, DOIL_DWORD));
+				x86_exit(x86);
+			} else {
+				x86_move(x86, x86_reg(X86_RDI, DOIL_QWORD), x86_operand(x86, ins->ret.src));
+				x86_exit(x86);
+			}
+			break;
+		default:
+			fprintf(stderr, "ERROR: doil instruction '%s' can't be lowered to x86_64\n", instruction_type_str[ins->type]);
+			exit(1);
+	}
+}
+
+/* the entry of a system for C, which saves what the SysV ABI wants saved and extends the arguments */
+void
+x86_sysv_wrapper(x86_t *x86, unsigned int index) {
+	system_t *sys = &systems[index];
+	x86_function_t *fn = &x86->functions[index];
+	unsigned int pushed[sizeof(x86_callee_saved) / sizeof(x86_callee_saved[0])], pushed_count = 0;
+	fn->wrapper = x86_emit(x86, X86_FUNCTION, (x86_operand_t){0}, x86_sym(&ids[sys->id]));
+	for (unsigned int i = 0; i < sizeof(x86_callee_saved) / sizeof(x86_callee_saved[0]); i++) {
+		if (!(fn->clobbers & x86_bit(x86_callee_saved[i]))) continue;
+		x86_emit(x86, X86_PUSH, x86_reg(x86_callee_saved[i], DOIL_QWORD), (x86_operand_t){0});
+		pushed[pushed_count++] = x86_callee_saved[i];
+	}
+	for (unsigned int i = 0; i < sys->params_count; i++) x86_extend(x86, x86_arguments[i], doil_variable_type(&ids[sys->params[i]]));
+	x86_emit(x86, X86_CALL, (x86_operand_t){0}, x86_label(fn->label));
+	while (pushed_count) x86_emit(x86, X86_POP, x86_reg(pushed[--pushed_count], DOIL_QWORD), (x86_operand_t){0});
+	x86_emit_none(x86, X86_RET);
+}
+
+/*
+ * a system takes its arguments in rdi, rsi, rdx, rcx, r8 and r9, extended to 64 bits from their type,
+ * and returns in rax. it saves no register, its callers don't keep anything in the ones it changes,
+ * and it only has a frame when some of its values live on the stack.
+ */
+void
+x86_lower_system(x86_t *x86, unsigned int index) {
+	system_t *sys = &systems[index];
+	doil_t *doil = &sys->doil;
+	x86_function_t *fn = &x86->functions[index];
+	x86_operand_t dst[DOIL_MAX_PARAMS], src[DOIL_MAX_PARAMS];
+	unsigned int count = 0;
+	fn->label = x86->labels_count++;
+	doil_split_critical_edges(doil);
+	x86_allocate(x86, doil);
+	x86->block_label = x86->labels_count;
+	x86->labels_count += doil->blocks_count;
+	fn->body = x86_emit(x86, X86_LABEL, (x86_operand_t){0}, x86_label(fn->label));
+	if (x86->slots_count) x86_frame(x86);
+	/* nothing jumps back to the first block, the arguments are taken right after the label */
+	instruction_t *ins = doil->hins->nxt;
+	for (; ins && ins->type == DOIL_ARG; ins = ins->nxt) {
+		dst[count] = x86_location(x86, ins->arg.dst);
+		src[count++] = x86_reg(x86_arguments[ins->arg.idx], DOIL_QWORD);
+	}
+	x86_parallel_move(x86, dst, src, count);
+	for (; ins; ins = ins->nxt) x86_lower_instruction(x86, doil, ins);
+
+	fn->clobbers = X86_SCRATCH;
+	for (unsigned int i = 0; i < sys->params_count; i++) fn->clobbers |= x86_bit(x86_arguments[i]);
+	for (unsigned int i = 0; i < doil->registers_count; i++) {
+		if (x86->locs[i].in_reg) fn->clobbers |= x86_bit(x86->locs[i].reg);
+	}
+	for (ins = doil->hins; ins; ins = ins->nxt) {
+		if (ins->type == DOIL_CALL) fn->clobbers |= x86_call_clobbers(x86, ins);
+	}
+	if (output == OUTPUT_ASM || output == OUTPUT_OBJ) x86_sysv_wrapper(x86, index);
+}
+
+/*
+ * the logic goes before the systems, _start is where .text starts. with --jit it is called from C,
+ * so it saves what the SysV ABI wants saved before its frame and returns instead of exiting.
+ */
+void
+x86_lower(x86_t *x86, doil_t *doil) {
+	x86_instruction_t *systems_tail = x86->ins;
+	doil_split_critical_edges(doil);
+	x86_allocate(x86, doil);
+	x86->block_label = x86->labels_count;
+	x86->labels_count += doil->blocks_count;
+	x86_emit(x86, X86_FUNCTION, (x86_operand_t){0}, (x86_operand_t){0});
+	if (output == OUTPUT_JIT) {
+		for (unsigned int i = 0; i < sizeof(x86_callee_saved) / sizeof(x86_callee_saved[0]); i++) {
+			x86_emit(x86, X86_PUSH, x86_reg(x86_callee_saved[i], DOIL_QWORD), (x86_operand_t){0});
+		}
+	}
+	x86_frame(x86);
+	/* every path ends with a ret, doil_lex added one where the logic falls off its end */
+	for (instruction_t *ins = doil->hins; ins; ins = ins->nxt) x86_lower_instruction(x86, doil, ins);
+	if (systems_tail) {
+		x86_instruction_t *logic = systems_tail->nxt;
+		systems_tail->nxt = NULL;
+		x86->ins->nxt = x86->hins;
+		x86->hins = logic;
+		x86->ins = systems_tail;
+	}
+}
+
+int
+x86_same_operand(x86_operand_t a, x86_operand_t b) {
+	return a.type == b.type && a.siz == b.siz && a.reg == b.reg && a.imm == b.imm && a.var == b.var &&
+	       a.scale == b.scale && (!a.scale || a.index == b.index);
+}
+
+/* a second extension of a register from the same width changes nothing */
+int
+x86_is_reextension(x86_instruction_t *prv, x86_instruction_t *ins) {
+	int extension = ins->type == X86_MOVSX || ins->type == X86_MOVZX || (ins->type == X86_MOV && ins->dst.siz == DOIL_DWORD);
+	return extension && prv->type == ins->type && ins->src.type == X86_REG && ins->src.reg == ins->dst.reg &&
+	       x86_same_operand(prv->dst, ins->dst) && prv->src.siz == ins->src.siz;
+}
+
+/* whether one of the labels right after ins is label */
+int
+x86_labels_after(x86_instruction_t *ins, x86_operand_t label) {
+	for (ins = ins->nxt; ins && ins->type == X86_LABEL; ins = ins->nxt) {
+		if (ins->src.imm == label.imm) return 1;
+	}
+	return 0;
+}
+
+/*
+ * clean up the seams between lowered doil instructions: moves back to where a value just came from,
+ * loads of what was just stored, extensions that were already done and jumps to the next block.
+ */
+void
+x86_peephole(x86_t *x86) {
+	x86_instruction_t *prv = NULL;
+	for (x86_instruction_t *ins = x86->hins; ins; ins = ins->nxt) {
+		int drop = 0;
+		if (ins->type == X86_JCC && ins->nxt && ins->nxt->type == X86_JMP && x86_labels_after(ins->nxt, ins->src)) {
+			/* jcc over a jmp is the opposite jcc to where the jmp goes */
+			ins->cc ^= 1;
+			ins->src = ins->nxt->src;
+			ins->nxt = ins->nxt->nxt;
+		}
+		if ((ins->type == X86_JMP || ins->type == X86_JCC) && x86_labels_after(ins, ins->src)) {
+			drop = 1;
+		} else if (ins->type == X86_MOV && ins->dst.siz == DOIL_QWORD && x86_same_operand(ins->dst, ins->src)) {
+			drop = 1;
+		} else if (prv && prv->type == X86_MOV && ins->type == X86_MOV) {
+			/* a 32 bits move to a register also clears its upper half, it isn't a plain copy */
+			if (x86_same_operand(prv->dst, ins->src) && x86_same_operand(prv->src, ins->dst) &&
+			    !(ins->dst.type == X86_REG && ins->dst.siz == DOIL_DWORD)) {
+				drop = 1;
+			} else if (prv->dst.type == X86_MEM && prv->src.type == X86_REG && prv->dst.siz == DOIL_QWORD &&
+			           x86_same_operand(prv->dst, ins->src) && ins->dst.type == X86_REG) {
+				ins->src = prv->src;
+				drop = ins->src.reg == ins->dst.reg;
+			}
+		} else if (prv && x86_is_reextension(prv, ins)) {
+			drop = 1;
+		}
+		if (!drop) {
+			prv = ins;
+			continue;
+		}
+		if (prv) prv->nxt = ins->nxt;
+		else     x86->hins = ins->nxt;
+	}
+	x86->ins = prv;
+}
+
+void
+x86_print_operand(FILE *f, x86_operand_t op) {
+	switch (op.type) {
+		case X86_REG:
+			fprintf(f, "%%%s", x86_register_str[op.reg][op.siz]);
+			break;
+		case X86_IMM:
+			fprintf(f, "$%lld", op.imm);
+			break;
+		case X86_MEM:
+			if (op.reg == X86_RIP) {
+				fprintf(f, "%.*s", op.var->siz, op.var->str);
+				if (op.imm) fprintf(f, "%+lld", op.imm);
+			} else if (op.imm) {
+				fprintf(f, "%lld", op.imm);
+			}
+			if (op.scale) {
+				fprintf(f, "(%%%s,%%%s,%u)", x86_register_str[op.reg][DOIL_QWORD], x86_register_str[op.index][DOIL_QWORD], op.scale);
+			} else {
+				fprintf(f, "(%%%s)", x86_register_str[op.reg][DOIL_QWORD]);
+			}
+			break;
+		case X86_XMM:
+			fprintf(f, "%%xmm%u", op.reg);
+			break;
+		case X86_YMM:
+			fprintf(f, "%%ymm%u", op.reg);
+			break;
+		case X86_LABEL_OPERAND:
+			fprintf(f, ".L%lld", op.imm);
+			break;
+		default:
+			assert(0 && "unreachable");
+	}
+}
+
+/* the ymm forms have a v in front, and the arithmetic ones a second source which is dst as well */
+void
+x86_print_vector(FILE *f, x86_instruction_t *ins) {
+	static const char element_str[] = { 'b', 'w', 'd', 'q' };
+	int vex = ins->dst.type == X86_YMM || ins->src.type == X86_YMM;
+	int arithmetic = ins->type == X86_PADD || ins->type == X86_PSUB || ins->type == X86_PMULL;
+	fprintf(f, "\t%s%s", vex && ins->type != X86_VPBROADCASTQ ? "v" : "", x86_instruction_str[ins->type]);
+	if (arithmetic) fputc(element_str[ins->dst.siz], f);
+	if (ins->src.type != X86_NONE) {
+		fputc(' ', f);
+		x86_print_operand(f, ins->src);
+		fputc(',', f);
+		if (vex && arithmetic) {
+			fputc(' ', f);
+			x86_print_operand(f, ins->dst);
+			fputc(',', f);
+		}
+		fputc(' ', f);
+		x86_print_operand(f, ins->dst);
+	}
+	fputc('\n', f);
+}
+
+int
+x86_symbol_compare(const void *a, const void *b) {
+	const x86_symbol_t *lhs = *(x86_symbol_t *const *)a, *rhs = *(x86_symbol_t *const *)b;
+	return (lhs->offset > rhs->offset) - (lhs->offset < rhs->offset);
+}
+
+void
+x86_print_layout(x86_t *x86) {
+	static const char *const layout_str[] = { "aos", "soa", "aosoa" };
+	x86_symbol_t **sorted = malloc(sizeof(x86_symbol_t *) * (x86->syms_count + 1));
+	for (unsigned int i = 0; i < x86->syms_count; i++) sorted[i] = &x86->syms[i];
+	qsort(sorted, x86->syms_count, sizeof(x86_symbol_t *), x86_symbol_compare);
+	printf("; .bss: %u bytes, aligned to %u\n", x86->bss_siz, x86->bss_align);
+	printf(";   offset   size   line  accesses  layout  symbol\n");
+	for (unsigned int i = 0; i < x86->syms_count; i++) {
+		x86_symbol_t *sym = sorted[i];
+		identifier_t *var = sym->var;
+		printf("; %8u %6u %6u %9u  %-6s  %.*s\n", sym->offset, x86_variable_size(var), sym->offset / X86_CACHE_LINE,
+		       x86_heat(var), var->layout ? layout_str[layouts[var->layout - 1].type] : "-", var->siz, var->str);
+	}
+	free(sorted);
+}
+
+void
+x86_print(FILE *f, x86_t *x86) {
+	static const char *const directive_str[] = { "byte", "short", "long", "quad" };
+	fprintf(f, "\t.text\n");
+	x86->ins = x86->hins;
+	while (x86->ins) {
+		x86_instruction_t *ins = x86->ins;
+		if (ins->type == X86_LABEL) {
+			fprintf(f, ".L%lld:\n", ins->src.imm);
+			x86->ins = x86->ins->nxt;
+			continue;
+		}
+		if (ins->type == X86_FUNCTION) {
+			if (ins->src.var) fprintf(f, "\t.globl %.*s\n%.*s:\n", ins->src.var->siz, ins->src.var->str, ins->src.var->siz, ins->src.var->str);
+			else              fprintf(f, "\t.globl _start\n_start:\n");
+			x86->ins = x86->ins->nxt;
+			continue;
+		}
+		if (ins->type == X86_CALL) {
+			if (ins->src.type == X86_LABEL_OPERAND) fprintf(f, "\tcall .L%lld\n", ins->src.imm);
+			else                                    fprintf(f, "\tcall %.*s\n", ins->src.var->siz, ins->src.var->str);
+			x86->ins = x86->ins->nxt;
+			continue;
+		}
+		if (ins->type == X86_JB) {
+			if (ins->src.type == X86_LABEL_OPERAND) fprintf(f, "\tjb .L%lld\n", ins->src.imm);
+			else                                    fprintf(f, "\tjb .%+lld\n", ins->src.imm);
+			x86->ins = x86->ins->nxt;
+			continue;
+		}
+		if (ins->type == X86_JMP || ins->type == X86_JCC || ins->type == X86_SETCC) {
+			fprintf(f, "\t%s%s ", x86_instruction_str[ins->type], ins->type == X86_JMP ? "" : x86_cc_str[ins->cc]);
+			x86_print_operand(f, ins->type == X86_SETCC ? ins->dst : ins->src);
+			fputc('\n', f);
+			x86->ins = x86->ins->nxt;
+			continue;
+		}
+		if (ins->type >= X86_MOVDQU) {
+			x86_print_vector(f, ins);
+			x86->ins = x86->ins->nxt;
+			continue;
+		}
+		fprintf(f, "\t%s", x86_instruction_str[ins->type]);
+		if (ins->type == X86_MOVZX || ins->type == X86_MOVSX) {
+			fprintf(f, "%c%c", x86_suffix_str[ins->src.siz], x86_suffix_str[ins->dst.siz]);
+		} else if (ins->dst.type != X86_NONE) {
+			fputc(x86_suffix_str[ins->dst.siz], f);
+		}
+		if (ins->src.type != X86_NONE) {
+			fputc(' ', f);
+			x86_print_operand(f, ins->src);
+			fputc(',', f);
+		}
+		if (ins->dst.type != X86_NONE) {
+			fputc(' ', f);
+			x86_print_operand(f, ins->dst);
+		}
+		fputc('\n', f);
+		x86->ins = x86->ins->nxt;
+	}
+	/*
+	 * the symbols are printed in the order of their offsets, with the holes x86_layout_data left.
+	 * the elements of arrays in a layout are interleaved, so .bss only gets labels in between.
+	 */
+	x86_symbol_t **sorted = malloc(sizeof(x86_symbol_t *) * (x86->syms_count + 1));
+	for (unsigned int section = X86_DATA; section <= X86_BSS; section++) {
+		unsigned int count = 0, offset = 0;
+		for (unsigned int i = 0; i < x86->syms_count; i++) {
+			if (x86->syms[i].section == section) sorted[count++] = &x86->syms[i];
+		}
+		if (!count) continue;
+		qsort(sorted, count, sizeof(x86_symbol_t *), x86_symbol_compare);
+		fprintf(f, "\t.%s\n", section == X86_DATA ? "data" : "bss");
+		fprintf(f, "\t.balign %u\n", section == X86_DATA ? 8 : x86->bss_align);
+		for (unsigned int i = 0; i < count; i++) {
+			x86_symbol_t *sym = sorted[i];
+			if (sym->offset > offset) fprintf(f, "\t.zero %u\n", sym->offset - offset);
+			fprintf(f, "%.*s:\n", sym->var->siz, sym->var->str);
+			if (section == X86_DATA) {
+				fprintf(f, "\t.%s %llu\n", directive_str[sym->var->datatype], sym->value);
+				offset = sym->offset + (1 << sym->var->datatype);
+			} else {
+				offset = sym->offset;
+			}
+		}
+		if (section == X86_BSS && x86->bss_siz > offset) fprintf(f, "\t.zero %u\n", x86->bss_siz - offset);
+	}
+	free(sorted);
+	/* the stack isn't executable */
+	fprintf(f, "\t.section .note.GNU-stack,\"\",@progbits\n");
+}
+
+void
+x86_code(x86_t *x86, unsigned long long val, unsigned int siz) {
+	if (x86->code_siz + siz > x86->code_cap) {
+		x86->code_cap = x86->code_cap ? x86->code_cap * 2 : 256;
+		x86->code = realloc(x86->code, x86->code_cap);
+	}
+	for (unsigned int i = 0; i < siz; i++) x86->code[x86->code_siz++] = val >> (i * 8);
+}
+
+void x86_encode_modrm(x86_t *x86, x86_operand_t reg, x86_operand_t rm);
+
+/* [66] [rex] opcode modrm [sib] [disp], reg is the modrm.reg field (a register or an opcode extension) */
+void
+x86_encode_rm(x86_t *x86, unsigned int siz, unsigned int opcode, x86_operand_t reg, x86_operand_t rm) {
+	unsigned int rex = 0;
+	if (siz == DOIL_WORD) x86_code(x86, 0x66, 1);
+	if (siz == DOIL_QWORD) rex |= 0x48;
+	if (reg.reg & 8) rex |= 0x44;
+	if (rm.reg != X86_RIP && (rm.reg & 8)) rex |= 0x41;
+	if (rm.type == X86_MEM && rm.scale && (rm.index & 8)) rex |= 0x42;
+	/* spl, bpl, sil and dil are only reachable with a rex prefix */
+	if (reg.type == X86_REG && reg.siz == DOIL_BYTE && reg.reg >= X86_RSP && reg.reg <= X86_RDI) rex |= 0x40;
+	if (rm.type == X86_REG && rm.siz == DOIL_BYTE && rm.reg >= X86_RSP && rm.reg <= X86_RDI) rex |= 0x40;
+	if (rex) x86_code(x86, rex, 1);
+	if (opcode > 0xff) x86_code(x86, opcode >> 8, 1);
+	x86_code(x86, opcode & 0xff, 1);
+	x86_encode_modrm(x86, reg, rm);
+}
+
+/* legacy sse: prefix [rex] 0f opcode modrm [sib] [disp] */
+void
+x86_encode_sse(x86_t *x86, unsigned int prefix, unsigned int opcode, x86_operand_t reg, x86_operand_t rm, int w) {
+	unsigned int rex = w ? 0x48 : 0;
+	if (reg.reg & 8) rex |= 0x44;
+	if (rm.reg != X86_RIP && (rm.reg & 8)) rex |= 0x41;
+	if (rm.type == X86_MEM && rm.scale && (rm.index & 8)) rex |= 0x42;
+	x86_code(x86, prefix, 1);
+	if (rex) x86_code(x86, rex, 1);
+	for (int shift = opcode > 0xffff ? 16 : 8; shift >= 0; shift -= 8) x86_code(x86, opcode >> shift, 1);
+	x86_encode_modrm(x86, reg, rm);
+}
+
+/*
+ * vex: the two bytes form when the map is 0f and nothing needs the x, b or w bits.
+ * map 1 is 0f and 2 is 0f38, pp 1 is 66 and 2 is f3, v is the second source register.
+ */
+void
+x86_encode_vex(x86_t *x86, unsigned int map, unsigned int pp, unsigned int v, unsigned int opcode, x86_operand_t reg, x86_operand_t rm) {
+	unsigned int r = !(reg.reg & 8), x = !(rm.type == X86_MEM && rm.scale && (rm.index & 8)), b = !(rm.reg != X86_RIP && (rm.reg & 8));
+	unsigned int l = reg.type == X86_YMM || rm.type == X86_YMM;
+	if (map == 1 && x && b) {
+		x86_code(x86, 0xc5, 1);
+		x86_code(x86, r << 7 | (~v & 15) << 3 | l << 2 | pp, 1);
+	} else {
+		x86_code(x86, 0xc4, 1);
+		x86_code(x86, r << 7 | x << 6 | b << 5 | map, 1);
+		x86_code(x86, (~v & 15) << 3 | l << 2 | pp, 1);
+	}
+	x86_code(x86, opcode, 1);
+	x86_encode_modrm(x86, reg, rm);
+}
+
+/* a rip relative displacement to a symbol, the addend is completed once the whole instruction is encoded */
+void
+x86_relocate(x86_t *x86, unsigned int symbol, long long addend) {
+	if (x86->rels_count >= x86->rels_cap) {
+		x86->rels_cap = x86->rels_cap ? x86->rels_cap * 2 : 16;
+		x86->rels = realloc(x86->rels, sizeof(x86_relocation_t) * x86->rels_cap);
+	}
+	x86->rels[x86->rels_count++] = (x86_relocation_t){ x86->code_siz, symbol, addend };
+	x86_code(x86, 0, 4);
+}
+
+void
+x86_encode_modrm(x86_t *x86, x86_operand_t reg, x86_operand_t rm) {
+	unsigned int modrm = (reg.reg & 7) << 3;
+	if (rm.type != X86_MEM) {
+		x86_code(x86, 0xc0 | modrm | (rm.reg & 7), 1);
+	} else if (rm.reg == X86_RIP) {
+		x86_code(x86, 0x05 | modrm, 1);
+		x86_relocate(x86, rm.var->symbol, rm.imm);
+	} else {
+		unsigned int mod = rm.imm == 0 && (rm.reg & 7) != X86_RBP ? 0x00 : fits_i8(rm.imm) ? 0x40 : 0x80;
+		if (rm.scale) {
+			/* rm 100 and a sib byte, scale is a power of two */
+			x86_code(x86, mod | modrm | 0x04, 1);
+			x86_code(x86, __builtin_ctz(rm.scale) << 6 | (rm.index & 7) << 3 | (rm.reg & 7), 1);
+		} else {
+			x86_code(x86, mod | modrm | (rm.reg & 7), 1);
+			if ((rm.reg & 7) == X86_RSP) x86_code(x86, 0x24, 1);
+		}
+		if (mod == 0x40) x86_code(x86, rm.imm, 1);
+		if (mod == 0x80) x86_code(x86, rm.imm, 4);
+	}
+}
+
+#define x86_ext(n) x86_reg((n), DOIL_QWORD)
+
+void
+x86_encode_alu(x86_t *x86, x86_instruction_t *ins, unsigned int ext) {
+	unsigned int siz = ins->dst.siz, byte = siz == DOIL_BYTE;
+	if (ins->src.type == X86_IMM && ins->dst.type == X86_REG && ins->dst.reg == X86_RAX && (byte || !fits_i8(ins->src.imm))) {
+		/* the short form for the accumulator, which is what assemblers pick */
+		if (siz == DOIL_WORD) x86_code(x86, 0x66, 1);
+		if (siz == DOIL_QWORD) x86_code(x86, 0x48, 1);
+		x86_code(x86, (ext << 3) | (byte ? 4 : 5), 1);
+		x86_code(x86, ins->src.imm, byte ? 1 : siz == DOIL_WORD ? 2 : 4);
+	} else if (ins->src.type == X86_IMM) {
+		if (byte) {
+			x86_encode_rm(x86, siz, 0x80, x86_ext(ext), ins->dst);
+			x86_code(x86, ins->src.imm, 1);
+		} else if (fits_i8(ins->src.imm)) {
+			x86_encode_rm(x86, siz, 0x83, x86_ext(ext), ins->dst);
+			x86_code(x86, ins->src.imm, 1);
+		} else {
+			x86_encode_rm(x86, siz, 0x81, x86_ext(ext), ins->dst);
+			x86_code(x86, ins->src.imm, siz == DOIL_WORD ? 2 : 4);
+		}
+	} else if (ins->src.type == X86_REG) {
+		x86_encode_rm(x86, siz, (ext << 3) | !byte, ins->src, ins->dst);
+	} else {
+		x86_encode_rm(x86, siz, (ext << 3) | 2 | !byte, ins->dst, ins->src);
+	}
+}
+
+void
+x86_encode_instruction(x86_t *x86, x86_instruction_t *ins) {
+	unsigned int siz = ins->dst.siz, byte = siz == DOIL_BYTE;
+	switch (ins->type) {
+		case X86_MOV:
+			if (ins->src.type == X86_IMM) {
+				if (ins->dst.type == X86_REG && (siz != DOIL_QWORD || !fits_i32(ins->src.imm))) {
+					if (siz == DOIL_WORD) x86_code(x86, 0x66, 1);
+					if (siz == DOIL_QWORD || (ins->dst.reg & 8) || (byte && ins->dst.reg >= X86_RSP))
+						x86_code(x86, 0x40 | (siz == DOIL_QWORD) << 3 | (ins->dst.reg & 8) >> 3, 1);
+					x86_code(x86, (byte ? 0xb0 : 0xb8) | (ins->dst.reg & 7), 1);
+					x86_code(x86, ins->src.imm, 1 << siz);
+				} else {
+					x86_encode_rm(x86, siz, byte ? 0xc6 : 0xc7, x86_ext(0), ins->dst);
+					x86_code(x86, ins->src.imm, siz == DOIL_QWORD ? 4 : 1 << siz);
+				}
+			} else if (ins->src.type == X86_REG) {
+				x86_encode_rm(x86, siz, byte ? 0x88 : 0x89, ins->src, ins->dst);
+			} else {
+				x86_encode_rm(x86, siz, byte ? 0x8a : 0x8b, ins->dst, ins->src);
+			}
+			break;
+		case X86_MOVZX:
+			x86_encode_rm(x86, siz, ins->src.siz == DOIL_BYTE ? 0x0fb6 : 0x0fb7, ins->dst, ins->src);
+			break;
+		case X86_MOVSX:
+			x86_encode_rm(x86, siz, ins->src.siz == DOIL_BYTE ? 0x0fbe : ins->src.siz == DOIL_WORD ? 0x0fbf : 0x63, ins->dst, ins->src);
+			break;
+		case X86_ADD:
+			x86_encode_alu(x86, ins, 0);
+			break;
+		case X86_SUB:
+			x86_encode_alu(x86, ins, 5);
+			break;
+		case X86_XOR:
+			x86_encode_alu(x86, ins, 6);
+			break;
+		case X86_AND:
+			x86_encode_alu(x86, ins, 4);
+			break;
+		case X86_CMP:
+			x86_encode_alu(x86, ins, 7);
+			break;
+		case X86_JB:
+			/* the displacement to a label is filled in by x86_encode */
+			if (ins->src.type != X86_LABEL_OPERAND) {
+				x86_code(x86, 0x72, 1);
+				x86_code(x86, ins->src.imm - 2, 1);
+			} else if (ins->far) {
+				x86_code(x86, 0x820f, 2);
+				x86_code(x86, 0, 4);
+			} else {
+				x86_code(x86, 0x72, 1);
+				x86_code(x86, 0, 1);
+			}
+			break;
+		case X86_JMP:
+			/* the displacement is filled in by x86_encode */
+			if (ins->far) {
+				x86_code(x86, 0xe9, 1);
+				x86_code(x86, 0, 4);
+			} else {
+				x86_code(x86, 0xeb, 1);
+				x86_code(x86, 0, 1);
+			}
+			break;
+		case X86_JCC:
+			if (ins->far) {
+				x86_code(x86, (0x80 | ins->cc) << 8 | 0x0f, 2);
+				x86_code(x86, 0, 4);
+			} else {
+				x86_code(x86, 0x70 | ins->cc, 1);
+				x86_code(x86, 0, 1);
+			}
+			break;
+		case X86_SETCC:
+			x86_encode_rm(x86, DOIL_BYTE, 0x0f90 | ins->cc, x86_ext(0), ins->dst);
+			break;
+		case X86_LABEL:
+		case X86_FUNCTION:
+			break;
+		case X86_CALL:
+			/* the displacement to a label is filled in by x86_encode, to a symbol by the linker */
+			x86_code(x86, 0xe8, 1);
+			if (ins->src.type == X86_LABEL_OPERAND) x86_code(x86, 0, 4);
+			else                                    x86_relocate(x86, ins->src.var->symbol, 0);
+			break;
+		case X86_RET:
+			x86_code(x86, 0xc3, 1);
 			break;
-		case AST_SUB:
-			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_SUB);
+		case X86_POP:
+			if (ins->dst.reg & 8) x86_code(x86, 0x41, 1);
+			x86_code(x86, 0x58 | (ins->dst.reg & 7), 1);
 			break;
-		case AST_MUL:
-			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_MUL);
+		case X86_MOVDQU:
+			if (ins->dst.type == X86_MEM) {
+				if (ins->src.type == X86_YMM) x86_encode_vex(x86, 1, 2, 0, 0x7f, ins->src, ins->dst);
+				else                          x86_encode_sse(x86, 0xf3, 0x0f7f, ins->src, ins->dst, 0);
+			} else {
+				if (ins->dst.type == X86_YMM) x86_encode_vex(x86, 1, 2, 0, 0x6f, ins->dst, ins->src);
+				else                          x86_encode_sse(x86, 0xf3, 0x0f6f, ins->dst, ins->src, 0);
+			}
 			break;
-		case AST_DIV:
-			register_index = dato_expression_operator_to_doil(doil, exp, DOIL_DIV);
+		case X86_MOVQ:
+			x86_encode_sse(x86, 0x66, 0x0f6e, ins->dst, ins->src, 1);
 			break;
-		case AST_ASSIGN:
-			register_index = dato_assignment_to_doil(doil, exp, 1);
+		case X86_PUNPCKLQDQ:
+			x86_encode_sse(x86, 0x66, 0x0f6c, ins->dst, ins->src, 0);
 			break;
-		case AST_IDENTIFIER:
-			var = get_identifier(ID_VARIABLE, exp->tkn->str, exp->tkn->siz);
-			if (!var) {
-				fprintf(stderr, "ERROR: '%.*s' is not a variable\n", exp->tkn->siz, exp->tkn->str);
-				exit(1);
+		case X86_VPBROADCASTQ:
+			x86_encode_vex(x86, 2, 1, 0, 0x59, ins->dst, ins->src);
+			break;
+		case X86_PADD:
+		case X86_PSUB:
+		case X86_PMULL: {
+			static const unsigned char padd[] = { 0xfc, 0xfd, 0xfe, 0xd4 }, psub[] = { 0xf8, 0xf9, 0xfa, 0xfb };
+			unsigned int element = ins->dst.siz;
+			int sse4_1 = ins->type == X86_PMULL && element == DOIL_DWORD;
+			unsigned int opcode = ins->type == X86_PADD ? padd[element] : ins->type == X86_PSUB ? psub[element] : sse4_1 ? 0x40 : 0xd5;
+			if (ins->dst.type == X86_YMM) x86_encode_vex(x86, sse4_1 ? 2 : 1, 1, ins->dst.reg, opcode, ins->dst, ins->src);
+			else                          x86_encode_sse(x86, 0x66, (sse4_1 ? 0x0f3800 : 0x0f00) | opcode, ins->dst, ins->src, 0);
+			break;
+		}
+		case X86_VZEROUPPER:
+			x86_code(x86, 0x77f8c5, 3);
+			break;
+		case X86_UD2:
+			x86_code(x86, 0x0b0f, 2);
+			break;
+		case X86_LEA:
+			x86_encode_rm(x86, siz, 0x8d, ins->dst, ins->src);
+			break;
+		case X86_SHL:
+		case X86_SHR:
+		case X86_SAR:
+			/* shifts by one have their own opcode, which is what assemblers pick */
+			x86_encode_rm(x86, siz, ins->src.imm == 1 ? (byte ? 0xd0 : 0xd1) : (byte ? 0xc0 : 0xc1), x86_ext(ins->type == X86_SHL ? 4 : ins->type == X86_SHR ? 5 : 7), ins->dst);
+			if (ins->src.imm != 1) x86_code(x86, ins->src.imm, 1);
+			break;
+		case X86_MUL:
+			x86_encode_rm(x86, siz, byte ? 0xf6 : 0xf7, x86_ext(4), ins->dst);
+			break;
+		case X86_IMUL:
+			if (ins->src.type == X86_NONE) {
+				/* rdx:rax = rax * dst */
+				x86_encode_rm(x86, siz, byte ? 0xf6 : 0xf7, x86_ext(5), ins->dst);
+			} else if (ins->src.type == X86_IMM) {
+				x86_encode_rm(x86, siz, fits_i8(ins->src.imm) ? 0x6b : 0x69, ins->dst, ins->dst);
+				x86_code(x86, ins->src.imm, fits_i8(ins->src.imm) ? 1 : 4);
+			} else {
+				x86_encode_rm(x86, siz, 0x0faf, ins->dst, ins->src);
 			}
-			var->use_amount++;
-			ins = doil_make_instruction(doil, DOIL_GET);
-			ins->get.src = string(exp->tkn->str, exp->tkn->siz);
-			ins->get.reg = doil_get_register(doil);
-			register_index = ins->get.reg;
-			doil->registers[register_index].val = ins->get.src;
 			break;
-		case AST_INTEGER:
-			ins = doil_make_instruction(doil, DOIL_MOV);
-			ins->mov.reg = doil_get_register(doil);
-			ins->mov.val = string(exp->tkn->str, exp->tkn->siz);;
-			register_index = ins->mov.reg;
-			doil->registers[register_index].val = ins->mov.val;
+		case X86_DIV:
+			x86_encode_rm(x86, siz, byte ? 0xf6 : 0xf7, x86_ext(6), ins->dst);
+			break;
+		case X86_IDIV:
+			x86_encode_rm(x86, siz, byte ? 0xf6 : 0xf7, x86_ext(7), ins->dst);
+			break;
+		case X86_CQO:
+			x86_code(x86, 0x9948, 2);
+			break;
+		case X86_PUSH:
+			if (ins->dst.reg & 8) x86_code(x86, 0x41, 1);
+			x86_code(x86, 0x50 | (ins->dst.reg & 7), 1);
+			break;
+		case X86_SYSCALL:
+			x86_code(x86, 0x050f, 2);
 			break;
 		default:
-			fprintf(stderr, "ERROR: '%s' is not a valid expression\n", ast_type_str[exp->type]);
-			exit(1);
+			assert(0 && "unreachable");
 	}
-	return register_index;
 }
 
-unsigned int
-dato_assignment_to_doil(doil_t *doil, ast_t *asg, int return_register) {
-	ast_t *id  = asg->hbranch;
-	ast_t *val = asg->hbranch->nxt;
-
-	identifier_t *var = NULL;
-	reg_or_const dst = {0}, src = {0};
-	if (id->type == AST_IDENTIFIER) {
-		var = get_identifier(ID_VARIABLE, id->tkn->str, id->tkn->siz);
-		if (!var) {
-			fprintf(stderr, "ERROR: trying to assign to '%.*s', but '%.*s' isn't a variable\n", id->tkn->siz, id->tkn->str,id->tkn->siz, id->tkn->str);
-			exit(1);
+/*
+ * jumps to labels start short, the ones whose label ends up too far become long and everything
+ * is encoded again, until nothing grows anymore
+ */
+void
+x86_encode(x86_t *x86) {
+	unsigned int *labels = malloc(sizeof(unsigned int) * (x86->labels_count + 1));
+	for (int grown = 1; grown;) {
+		grown = 0;
+		x86->code_siz = 0;
+		x86->rels_count = 0;
+		for (x86->ins = x86->hins; x86->ins; x86->ins = x86->ins->nxt) {
+			unsigned int rels_count = x86->rels_count;
+			if (x86->ins->type == X86_LABEL) labels[x86->ins->src.imm] = x86->code_siz;
+			x86_encode_instruction(x86, x86->ins);
+			x86->ins->end = x86->code_siz;
+			/* rip relative displacements are relative to the end of the instruction */
+			for (unsigned int i = rels_count; i < x86->rels_count; i++) {
+				x86->rels[i].addend -= x86->code_siz - x86->rels[i].offset;
+			}
 		}
-		var->set_amount++;
-		dst.val.cst = string(id->tkn->str, id->tkn->siz);
-	} else {
-		dst.val.reg = dato_expression_to_doil(doil, id);
-		dst.is_reg = 1;
-		doil_clear_register(doil, dst.val.reg);
-	}
-
-	if (val->type == AST_INTEGER) {
-		src.val.cst = string(val->tkn->str, val->tkn->siz);
-		if (var && var->set_amount == 1) {
-			var->first_value = src.val.cst;
+		for (x86_instruction_t *ins = x86->hins; ins; ins = ins->nxt) {
+			if (ins->src.type != X86_LABEL_OPERAND) continue;
+			long long displacement = (long long)labels[ins->src.imm] - ins->end;
+			if (ins->type == X86_CALL) {
+				memcpy(x86->code + ins->end - 4, &(int){ displacement }, 4);
+				continue;
+			}
+			if (ins->type != X86_JB && ins->type != X86_JMP && ins->type != X86_JCC) continue;
+			if (!ins->far && !fits_i8(displacement)) {
+				ins->far = 1;
+				grown = 1;
+			}
+			if (ins->far) memcpy(x86->code + ins->end - 4, &(int){ displacement }, 4);
+			else          x86->code[ins->end - 1] = displacement;
 		}
-	} else {
-		src.val.reg = dato_expression_to_doil(doil, val);
-		src.is_reg = 1;
-		if (!return_register) doil_clear_register(doil, src.val.reg);
 	}
-	instruction_t *ins = doil_make_instruction(doil, DOIL_SET);
-	ins->set.dst = dst;
-	ins->set.src = src;
-
-	return src.val.reg;
+	free(labels);
 }
 
 void
-dato_return_to_doil(doil_t *doil, ast_t *ret) {
-	ast_t *val = ret->branch;
-	instruction_t *ins;
+x86_clean_up(x86_t *x86) {
+	arena_free(&x86->arena);
+	free(x86->syms);
+	free(x86->code);
+	free(x86->rels);
+	free(x86->locs);
+	free(x86->functions);
+}
 
-	if (!val) {
-		ins = doil_make_instruction(doil, DOIL_RET);
-		ins->ret.src.unused = 1;
-		return;
-	}
+/* ELF64 */
+#define ELF_BASE 0x400000
+#define ELF_PAGE 0x1000
 
-	reg_or_const src = {0};
-	if (val->type == AST_INTEGER) {
-		src.val.cst = string(val->tkn->str, val->tkn->siz);
-	} else {
-		src.val.reg = dato_expression_to_doil(doil, val);
-		src.is_reg = 1;
-		doil_clear_register(doil, src.val.reg);
-	}
-	ins = doil_make_instruction(doil, DOIL_RET);;
-	ins->ret.src = src;
+void
+elf_pad(FILE *f, unsigned long long offset) {
+	while ((unsigned long long)ftell(f) < offset) fputc(0, f);
 }
 
-doil_t
-doil_lex(ast_t *root) {
-	doil_t doil = {0};
-	root->branch = root->hbranch;
-	while (root->branch) {
-		switch (root->branch->type) {
-			case AST_ADD:
-			case AST_SUB:
-			case AST_MUL:
-			case AST_DIV:
-			case AST_IDENTIFIER:
-			case AST_INTEGER:
-				fprintf(stderr, "WARNING: statement with no effect\n");
-				break;
-			case AST_VARDEF: 
-				dato_variable_definition_to_doil(&doil, root->branch);
-				break;
-			case AST_ASSIGN: 
-				dato_assignment_to_doil(&doil, root->branch, 0);
-				break;
-			case AST_RETURN: 
-				dato_return_to_doil(&doil, root->branch);
-				break;
-			default:
-				fprintf(stderr, "ERROR: '%s' is not a valid operation\n", ast_type_str[root->branch->type]);
-				exit(1);
-		}
-		root->branch = root->branch->nxt;
+unsigned char *
+elf_data(x86_t *x86) {
+	unsigned char *data = calloc(x86->data_siz + 1, 1);
+	for (unsigned int i = 0; i < x86->syms_count; i++) {
+		x86_symbol_t *sym = &x86->syms[i];
+		if (sym->section != X86_DATA) continue;
+		for (unsigned int j = 0; j < 1u << sym->var->datatype; j++) data[sym->offset + j] = sym->value >> (j * 8);
 	}
-	free_ast(root);
-	return doil;
+	return data;
 }
 
+/* fill in the rip relative displacements once it's known where the code and the data will be */
 void
-print_doil(doil_t doil) {
-	doil.ins = doil.hins;
-	while (doil.ins) {
-		switch (doil.ins->type) {
-			case DOIL_ADD:
-			case DOIL_SUB:
-			case DOIL_MUL:
-			case DOIL_DIV:
-				printf("%s ", instruction_type_str[doil.ins->type]);
-				if (doil.ins->ope.lhs.is_reg) {
-					printf("r%u ", doil.ins->ope.lhs.val.reg);
-				} else {
-					printf("%.*s ", doil.ins->ope.lhs.val.cst.siz, doil.ins->ope.lhs.val.cst.buf);
-				}
-				if (doil.ins->ope.rhs.is_reg) {
-					printf("r%u ", doil.ins->ope.rhs.val.reg);
-				} else {
-					printf("%.*s ", doil.ins->ope.rhs.val.cst.siz, doil.ins->ope.rhs.val.cst.buf);
-				}
-				printf("r%u\n", doil.ins->ope.dst);
-				break;
-			case DOIL_DEF:
-				printf("def %.*s %s\n", doil.ins->def.name.siz, doil.ins->def.name.buf, doil_datatype_str[doil.ins->def.type]);
-				break;
-			case DOIL_MOV:
-				printf("mov r%u %.*s\n", doil.ins->mov.reg, doil.ins->mov.val.siz, doil.ins->mov.val.buf);
-				break;
-			case DOIL_SET:
-				if (doil.ins->set.dst.is_reg) {
-					printf("set r%u", doil.ins->set.dst.val.reg);
-				} else {
-					printf("set %.*s", doil.ins->set.dst.val.cst.siz, doil.ins->set.dst.val.cst.buf);
-				}
-				if (doil.ins->set.src.is_reg) {
-					printf(" r%u\n", doil.ins->set.src.val.reg);
-				} else {
-						printf(" %.*s\n", doil.ins->set.src.val.cst.siz, doil.ins->set.src.val.cst.buf);
-				}
-				break;
-			case DOIL_GET:
-				printf("get %.*s r%u\n", doil.ins->get.src.siz, doil.ins->get.src.buf, doil.ins->get.reg);
-				break;
-			case DOIL_RET:
-				printf("ret");
-				if (!doil.ins->ret.src.unused) {
-					if (doil.ins->ret.src.is_reg) {
-						printf(" r%u\n", doil.ins->ret.src.val.reg);
-					} else {
-						printf(" %.*s\n", doil.ins->ret.src.val.cst.siz, doil.ins->ret.src.val.cst.buf);
-					}
-				} else {
-					putchar('\n');
-				}
-				break;
-			default:
-				fprintf(stderr, "ERROR: not a valid instruction %d\n", doil.hins->type);
-				exit(1);
+elf_relocate(x86_t *x86, unsigned long long text_addr, unsigned long long data_addr) {
+	unsigned long long bss_addr = data_addr + align(x86->data_siz, x86->bss_align);
+	for (unsigned int i = 0; i < x86->rels_count; i++) {
+		x86_relocation_t *rel = &x86->rels[i];
+		x86_symbol_t *sym = &x86->syms[rel->symbol];
+		if (sym->section == X86_EXTERN) {
+			fprintf(stderr, "ERROR: the system '%.*s' is written in C, link an object made with --obj instead\n", sym->var->siz, sym->var->str);
+			exit(1);
 		}
-		doil.ins = doil.ins->nxt;
+		long long s = (sym->section == X86_DATA ? data_addr : bss_addr) + sym->offset;
+		long long p = text_addr + rel->offset;
+		unsigned int val = s + rel->addend - p;
+		memcpy(x86->code + rel->offset, &val, 4);
 	}
 }
 
-#define doil_remove_instruction() do {\
-	if (prv) {\
-		prv->nxt = ins->nxt;\
-	} else {\
-		doil->hins = ins->nxt;\
-	}\
-	delete = 1;\
-} while(0)
-
-static char **bufs;
-static unsigned int bufs_cap;
-static unsigned int bufs_count;
-
-char *
-make_buffer(unsigned int buf_size) {
-	if (bufs_count >= bufs_cap) {
-		bufs_cap = bufs_cap ? bufs_cap * 2 :1;
-		bufs = bufs ? realloc(bufs, sizeof(char *) * bufs_cap) : malloc(sizeof(char *));
+FILE *
+elf_open(char *path) {
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		fprintf(stderr, "ERROR: could not open file %s: %s\n", path, strerror(errno));
+		exit(1);
 	}
-	bufs[bufs_count] = malloc(buf_size);
-	memset(bufs[bufs_count], 0, buf_size);
-	return bufs[bufs_count++];
+	return f;
 }
 
-string_t
-doil_perform_operation(doil_t *doil, instruction_t *ins, unsigned int operator) {
-	unsigned int lhs = strtoul(ins->ope.lhs.val.cst.buf, NULL, 10);
-	unsigned int rhs = strtoul(ins->ope.rhs.val.cst.buf, NULL, 10);
-	unsigned int reg = ins->ope.dst;
-	string_t val;
-	ins->type = DOIL_MOV;
-	ins->mov.reg = reg;
-	char *buf = make_buffer(INTEGER_STRING_MAX);
-	switch (operator) {
-		case DOIL_ADD:
-			snprintf(buf, INTEGER_STRING_MAX, "%u", lhs + rhs);
-			val = string(buf, INTEGER_STRING_MAX);
-			break;
-		case DOIL_SUB:
-			snprintf(buf, INTEGER_STRING_MAX, "%u", lhs - rhs);
-			val = string(buf, INTEGER_STRING_MAX);
-			break;
-		case DOIL_MUL:
-			snprintf(buf, INTEGER_STRING_MAX, "%u", lhs * rhs);
-			val = string(buf, INTEGER_STRING_MAX);
-			break;
-		case DOIL_DIV:
-			if (!rhs) {
-				fprintf(stderr, "WARNING: trying to divide by zero\n");
-				exit(1);
-			}
-			snprintf(buf, INTEGER_STRING_MAX, "%u", lhs / rhs);
-			val = string(buf, INTEGER_STRING_MAX);
-			break;
-		default:
-			assert(0 && "unreachable");
-			break;
-	}
-	doil->registers[reg].val = val;
-	return val;
+void
+elf_write_executable(x86_t *x86, char *path) {
+	Elf64_Ehdr ehdr = {0};
+	Elf64_Phdr phdr[2] = {0};
+	unsigned long long text_off  = sizeof(ehdr) + sizeof(phdr);
+	unsigned long long text_addr = ELF_BASE + text_off;
+	unsigned long long data_off  = align(text_off + x86->code_siz, ELF_PAGE);
+	unsigned long long data_addr = ELF_BASE + data_off;
+	unsigned long long bss_addr  = data_addr + align(x86->data_siz, x86->bss_align);
+	elf_relocate(x86, text_addr, data_addr);
+
+	memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+	ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+	ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+	ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+	ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+	ehdr.e_type = ET_EXEC;
+	ehdr.e_machine = EM_X86_64;
+	ehdr.e_version = EV_CURRENT;
+	ehdr.e_entry = text_addr;
+	ehdr.e_phoff = sizeof(ehdr);
+	ehdr.e_ehsize = sizeof(ehdr);
+	ehdr.e_phentsize = sizeof(Elf64_Phdr);
+	ehdr.e_phnum = 2;
+
+	phdr[0].p_type = PT_LOAD;
+	phdr[0].p_flags = PF_R | PF_X;
+	phdr[0].p_offset = 0;
+	phdr[0].p_vaddr = phdr[0].p_paddr = ELF_BASE;
+	phdr[0].p_filesz = phdr[0].p_memsz = text_off + x86->code_siz;
+	phdr[0].p_align = ELF_PAGE;
+
+	phdr[1].p_type = PT_LOAD;
+	phdr[1].p_flags = PF_R | PF_W;
+	phdr[1].p_offset = data_off;
+	phdr[1].p_vaddr = phdr[1].p_paddr = data_addr;
+	phdr[1].p_filesz = x86->data_siz;
+	phdr[1].p_memsz = bss_addr - data_addr + x86->bss_siz;
+	phdr[1].p_align = ELF_PAGE;
+
+	unsigned char *data = elf_data(x86);
+	FILE *f = elf_open(path);
+	fwrite(&ehdr, sizeof(ehdr), 1, f);
+	fwrite(phdr, sizeof(phdr), 1, f);
+	fwrite(x86->code, 1, x86->code_siz, f);
+	elf_pad(f, data_off);
+	fwrite(data, 1, x86->data_siz, f);
+	fclose(f);
+	free(data);
+	chmod(path, 0755);
 }
 
 void
-doil_register_to_constant(doil_t *doil, reg_or_const *src) {
-	if (!src->is_reg) return;
-	string_t reg_val = string(doil->registers[src->val.reg].val.buf, doil->registers[src->val.reg].val.siz);
-	identifier_t *var = get_identifier(ID_VARIABLE, reg_val.buf, reg_val.siz);
-	if (var) return;
-	src->is_reg = 0;
-	src->val.cst = reg_val;
-	doil->optimized++;
+elf_symbol(Elf64_Sym *sym, string_t *strtab, char *str, unsigned int siz) {
+	sym->st_name = strtab->siz;
+	string_cat(strtab, string(str, siz));
+	string_cat(strtab, string("\0", 1));
 }
 
-int
-doil_optimize(doil_t *doil) {
-	doil->optimized = 0;
-	int delete = 0;
-	identifier_t *var;
-	instruction_t *ins;
-	instruction_t *prv = NULL;
-	doil->ins = doil->hins;
-	memset(doil->registers, 0, doil->registers_count * sizeof(reg_t));
-	string_t reg_val;
-	while (doil->ins) {
-		ins = doil->ins;
-		switch(ins->type) {
-			case DOIL_DEF:
-				var = get_identifier(ID_VARIABLE, ins->def.name.buf, ins->def.name.siz);
-				if (var->use_amount > 0) break;
-				doil_remove_instruction();
-				doil->optimized++;
-				break;
-			case DOIL_ADD:
-			case DOIL_SUB:
-			case DOIL_MUL:
-			case DOIL_DIV:
-				doil_register_to_constant(doil, &ins->ope.lhs);
-				doil_register_to_constant(doil, &ins->ope.rhs);
-				if (ins->ope.rhs.is_reg || ins->ope.lhs.is_reg) break;
-				ins->mov.val = doil_perform_operation(doil, ins, ins->type);
-				doil->optimized++;
-				break;
-			case DOIL_RET:
-				doil_register_to_constant(doil, &ins->ret.src);
-				break;
-			case DOIL_MOV:
-				doil->registers[ins->mov.reg].val = ins->mov.val;
-				var = get_identifier(ID_VARIABLE, ins->mov.val.buf, ins->mov.val.siz);
-				if (!var) {
-					doil_remove_instruction();
-					doil->optimized++;
-				}
-				break;
-			case DOIL_GET:
-				reg_val = doil->registers[ins->get.reg].val;
-				var = get_identifier(ID_VARIABLE, ins->get.src.buf, ins->get.src.siz);
-				if (reg_val.buf && strncmp(reg_val.buf, ins->get.src.buf, max(reg_val.siz, ins->get.src.siz)) == 0) {
-					var->use_amount--;
-					doil_remove_instruction();
-					doil->optimized++;
-				} else if (var->set_amount != 1) {
-					if (var->set_amount == 0)
-						fprintf(stderr, "WARNING: using variable '%.*s', but the variable isn't initalized\n", ins->get.src.siz, ins->get.src.buf);
-					doil->registers[ins->get.reg].val = ins->get.src;
-				} else {
-					ins->type = DOIL_MOV;
-					ins->mov.reg = ins->get.reg;
-					var->use_amount--;
-					ins->mov.val = var->first_value;
-					doil->registers[ins->mov.reg].val = ins->mov.val;
-					doil->optimized++;
-				}
-				break;
-			case DOIL_SET:
-				if (!ins->set.dst.is_reg) {
-					var = get_identifier(ID_VARIABLE, ins->set.dst.val.cst.buf, ins->set.dst.val.cst.siz);
-					if (!var || var->use_amount > 0) {
-						if (ins->set.src.is_reg) doil->registers[ins->set.src.val.reg].val = ins->set.dst.val.cst;
-						break;
-					}
-					doil_remove_instruction();
-					doil->optimized++;
-				} else {
-					if (!ins->set.src.is_reg) 
-						doil->registers[ins->set.dst.val.reg].val = ins->set.src.val.cst;
-					else 
-						doil->registers[ins->set.dst.val.reg].val = doil->registers[ins->set.src.val.reg].val;
-				}
-				break;
-			default:
-				break;
-		}
-		doil->ins = doil->ins->nxt;
-		if (delete) {
-			delete = 0;
-			free(ins);
-		} else {
-			prv = ins;
-		}
+/* the code of the logic and of each system ends where the code of the next system starts */
+unsigned int
+elf_code_end(x86_t *x86, unsigned int system) {
+	for (; system < systems_count; system++) {
+		if (!systems[system].is_extern) return x86->functions[system].body->end;
 	}
-	return doil->optimized > 0;
+	return x86->code_siz;
 }
 
 void
-doil_clean_up(doil_t doil) {
-	while (doil.hins) {
-		doil.ins = doil.hins;
-		doil.hins = doil.hins->nxt;
-		free(doil.ins);
+elf_write_object(x86_t *x86, char *path) {
+	enum {
+		SEC_NULL,
+		SEC_TEXT,
+		SEC_DATA,
+		SEC_BSS,
+		SEC_NOTE, /* an empty .note.GNU-stack, the stack isn't executable */
+		SEC_RELA,
+		SEC_SYMTAB,
+		SEC_STRTAB,
+		SEC_SHSTRTAB,
+		SEC_COUNT,
+	};
+	static const char shstrtab[] = "\0.text\0.data\0.bss\0.note.GNU-stack\0.rela.text\0.symtab\0.strtab\0.shstrtab";
+	static const unsigned int shname[] = { 0, 1, 7, 13, 18, 34, 45, 53, 61 };
+	Elf64_Ehdr ehdr = {0};
+	Elf64_Shdr shdr[SEC_COUNT] = {0};
+
+	/*
+	 * local symbols: null, then every variable; global symbols: _start, the entries of the systems for C,
+	 * then the systems written in C, which are left undefined
+	 */
+	Elf64_Sym *syms = calloc(x86->syms_count + systems_count + 2, sizeof(Elf64_Sym));
+	unsigned int *index = malloc(sizeof(unsigned int) * (x86->syms_count + 1)); /* of each x86 symbol in syms */
+	unsigned int syms_count = 1;
+	string_t strtab = {0};
+	string_cat(&strtab, string("\0", 1));
+	for (unsigned int i = 0; i < x86->syms_count; i++) {
+		x86_symbol_t *sym = &x86->syms[i];
+		if (sym->section == X86_EXTERN) continue;
+		index[i] = syms_count;
+		elf_symbol(&syms[syms_count++], &strtab, sym->var->str, sym->var->siz);
+		syms[index[i]].st_info = ELF64_ST_INFO(STB_LOCAL, STT_OBJECT);
+		syms[index[i]].st_shndx = sym->section == X86_DATA ? SEC_DATA : SEC_BSS;
+		syms[index[i]].st_value = sym->offset;
+		syms[index[i]].st_size = x86_variable_size(sym->var);
 	}
-	free(doil.registers);
-	identifier_t *id;
-	for (unsigned int i = 0; i < ids_cap; i++) {
-		while (ids[i]) {
-			id = ids[i];
-			ids[i] = ids[i]->nxt;
-			free(id);
-		}
+	unsigned int locals = syms_count;
+	Elf64_Sym *entry = &syms[syms_count++];
+	elf_symbol(entry, &strtab, "_start", 6);
+	entry->st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+	entry->st_shndx = SEC_TEXT;
+	entry->st_size = elf_code_end(x86, 0);
+	for (unsigned int i = 0; i < systems_count; i++) {
+		if (systems[i].is_extern) continue;
+		identifier_t *var = &ids[systems[i].id];
+		entry = &syms[syms_count++];
+		elf_symbol(entry, &strtab, var->str, var->siz);
+		entry->st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+		entry->st_shndx = SEC_TEXT;
+		entry->st_value = x86->functions[i].wrapper->end;
+		entry->st_size = elf_code_end(x86, i + 1) - entry->st_value;
+	}
+	for (unsigned int i = 0; i < x86->syms_count; i++) {
+		x86_symbol_t *sym = &x86->syms[i];
+		if (sym->section != X86_EXTERN) continue;
+		index[i] = syms_count;
+		elf_symbol(&syms[syms_count], &strtab, sym->var->str, sym->var->siz);
+		syms[syms_count++].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
 	}
-	free(ids);
-	for (unsigned int i = 0; i < bufs_count; i++) free(bufs[i]);
-	free(bufs);
-	src -= f_siz;
-	free(src);
-}
 
-/* generate doil code from dato code */
-doil_t
-front_end(void) {
-	ast_t *root = parse();
-	doil_t doil = doil_lex(root);
-	while (doil_optimize(&doil));
-	print_doil(doil);
-	return doil;
+	Elf64_Rela *rels = calloc(x86->rels_count + 1, sizeof(Elf64_Rela));
+	for (unsigned int i = 0; i < x86->rels_count; i++) {
+		unsigned int type = x86->syms[x86->rels[i].symbol].section == X86_EXTERN ? R_X86_64_PLT32 : R_X86_64_PC32;
+		rels[i].r_offset = x86->rels[i].offset;
+		rels[i].r_info = ELF64_R_INFO(index[x86->rels[i].symbol], type);
+		rels[i].r_addend = x86->rels[i].addend;
+	}
+
+	unsigned long long off = sizeof(ehdr);
+	shdr[SEC_TEXT].sh_type = SHT_PROGBITS;
+	shdr[SEC_TEXT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+	shdr[SEC_TEXT].sh_offset = off = align(off, 16);
+	shdr[SEC_TEXT].sh_size = x86->code_siz;
+	shdr[SEC_TEXT].sh_addralign = 16;
+	off += x86->code_siz;
+	shdr[SEC_DATA].sh_type = SHT_PROGBITS;
+	shdr[SEC_DATA].sh_flags = SHF_ALLOC | SHF_WRITE;
+	shdr[SEC_DATA].sh_offset = off = align(off, 8);
+	shdr[SEC_DATA].sh_size = x86->data_siz;
+	shdr[SEC_DATA].sh_addralign = 8;
+	off += x86->data_siz;
+	shdr[SEC_BSS].sh_type = SHT_NOBITS;
+	shdr[SEC_BSS].sh_flags = SHF_ALLOC | SHF_WRITE;
+	shdr[SEC_BSS].sh_offset = off;
+	shdr[SEC_BSS].sh_size = x86->bss_siz;
+	shdr[SEC_BSS].sh_addralign = x86->bss_align;
+	shdr[SEC_NOTE].sh_type = SHT_PROGBITS;
+	shdr[SEC_NOTE].sh_offset = off;
+	shdr[SEC_NOTE].sh_addralign = 1;
+	shdr[SEC_RELA].sh_type = SHT_RELA;
+	shdr[SEC_RELA].sh_flags = SHF_INFO_LINK;
+	shdr[SEC_RELA].sh_offset = off = align(off, 8);
+	shdr[SEC_RELA].sh_size = x86->rels_count * sizeof(Elf64_Rela);
+	shdr[SEC_RELA].sh_link = SEC_SYMTAB;
+	shdr[SEC_RELA].sh_info = SEC_TEXT;
+	shdr[SEC_RELA].sh_addralign = 8;
+	shdr[SEC_RELA].sh_entsize = sizeof(Elf64_Rela);
+	off += shdr[SEC_RELA].sh_size;
+	shdr[SEC_SYMTAB].sh_type = SHT_SYMTAB;
+	shdr[SEC_SYMTAB].sh_offset = off;
+	shdr[SEC_SYMTAB].sh_size = syms_count * sizeof(Elf64_Sym);
+	shdr[SEC_SYMTAB].sh_link = SEC_STRTAB;
+	shdr[SEC_SYMTAB].sh_info = locals;
+	shdr[SEC_SYMTAB].sh_addralign = 8;
+	shdr[SEC_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+	off += shdr[SEC_SYMTAB].sh_size;
+	shdr[SEC_STRTAB].sh_type = SHT_STRTAB;
+	shdr[SEC_STRTAB].sh_offset = off;
+	shdr[SEC_STRTAB].sh_size = strtab.siz;
+	shdr[SEC_STRTAB].sh_addralign = 1;
+	off += strtab.siz;
+	shdr[SEC_SHSTRTAB].sh_type = SHT_STRTAB;
+	shdr[SEC_SHSTRTAB].sh_offset = off;
+	shdr[SEC_SHSTRTAB].sh_size = sizeof(shstrtab);
+	shdr[SEC_SHSTRTAB].sh_addralign = 1;
+	off += sizeof(shstrtab);
+	for (unsigned int i = 0; i < SEC_COUNT; i++) shdr[i].sh_name = shname[i];
+
+	memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+	ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+	ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+	ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+	ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+	ehdr.e_type = ET_REL;
+	ehdr.e_machine = EM_X86_64;
+	ehdr.e_version = EV_CURRENT;
+	ehdr.e_shoff = align(off, 8);
+	ehdr.e_ehsize = sizeof(ehdr);
+	ehdr.e_shentsize = sizeof(Elf64_Shdr);
+	ehdr.e_shnum = SEC_COUNT;
+	ehdr.e_shstrndx = SEC_SHSTRTAB;
+
+	unsigned char *data = elf_data(x86);
+	FILE *f = elf_open(path);
+	fwrite(&ehdr, sizeof(ehdr), 1, f);
+	elf_pad(f, shdr[SEC_TEXT].sh_offset);
+	fwrite(x86->code, 1, x86->code_siz, f);
+	elf_pad(f, shdr[SEC_DATA].sh_offset);
+	fwrite(data, 1, x86->data_siz, f);
+	elf_pad(f, shdr[SEC_RELA].sh_offset);
+	fwrite(rels, sizeof(Elf64_Rela), x86->rels_count, f);
+	fwrite(syms, sizeof(Elf64_Sym), syms_count, f);
+	fwrite(strtab.buf, 1, strtab.siz, f);
+	fwrite(shstrtab, 1, sizeof(shstrtab), f);
+	elf_pad(f, ehdr.e_shoff);
+	fwrite(shdr, sizeof(shdr), 1, f);
+	fclose(f);
+	free(data);
+	free(rels);
+	free(syms);
+	free(index);
+	free(strtab.buf);
 }
 
+/* JIT */
+
+/* perf finds the names of the code in anonymous pages in /tmp/perf-<pid>.map, one "start size name" a line */
 void
-linux_x86_64(doil_t doil) {
-	(void)doil;
-	assert(0 && "not implemented");
+jit_perf_map(x86_t *x86, unsigned char *code) {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/perf-%d.map", getpid());
+	FILE *f = elf_open(path);
+	fprintf(f, "%llx %x _start\n", (unsigned long long)code, elf_code_end(x86, 0));
+	for (unsigned int i = 0; i < systems_count; i++) {
+		if (systems[i].is_extern) continue;
+		identifier_t *var = &ids[systems[i].id];
+		unsigned int start = x86->functions[i].body->end;
+		fprintf(f, "%llx %x %.*s\n", (unsigned long long)(code + start), elf_code_end(x86, i + 1) - start, var->siz, var->str);
+	}
+	fclose(f);
 }
 
-/* generate an executable from doil code */
-void
-back_end(doil_t doil) {
+/*
+ * the code and the data are laid out in one mapping the way elf_write_executable lays them out in
+ * the file, the code pages are made executable once the displacements are filled in and the logic
+ * is called like a C function
+ */
+int
+jit_run(x86_t *x86) {
+	unsigned long long data_off = align(x86->code_siz, ELF_PAGE);
+	unsigned long long size = data_off + align(x86->data_siz, x86->bss_align) + x86->bss_siz;
+	unsigned char *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		fprintf(stderr, "ERROR: could not map %llu bytes for the code: %s\n", size, strerror(errno));
+		exit(1);
+	}
+	elf_relocate(x86, (unsigned long long)mem, (unsigned long long)mem + data_off);
+	memcpy(mem, x86->code, x86->code_siz);
+	unsigned char *data = elf_data(x86);
+	memcpy(mem + data_off, data, x86->data_siz);
+	free(data);
+	if (mprotect(mem, data_off, PROT_READ | PROT_EXEC) < 0) {
+		fprintf(stderr, "ERROR: could not make the code executable: %s\n", strerror(errno));
+		exit(1);
+	}
+	jit_perf_map(x86, mem);
+	unsigned long long (*logic)(void) = (unsigned long long (*)(void))mem;
+	stats_phase(PHASE_RUN);
+	int status = logic() & 0xff;
+	stats_phase(PHASE_BACK_END);
+	munmap(mem, size);
+	return status;
+}
+
+int
+linux_x86_64(doil_t *doil) {
+	x86_t x86 = {0};
+	int status = 0;
+	x86_layout_data(&x86, doil);
+	if (layout_report) x86_print_layout(&x86);
+	x86_extern_symbols(&x86);
+	x86.functions = calloc(systems_count + 1, sizeof(x86_function_t));
+	for (unsigned int i = 0; i < systems_count; i++) {
+		if (!systems[i].is_extern) x86_lower_system(&x86, i);
+	}
+	x86_lower(&x86, doil);
+	x86_peephole(&x86);
+	if (output == OUTPUT_ASM) {
+		FILE *f = fopen(output_path, "w");
+		if (!f) {
+			fprintf(stderr, "ERROR: could not open file %s: %s\n", output_path, strerror(errno));
+			exit(1);
+		}
+		x86_print(f, &x86);
+		fclose(f);
+	} else {
+		x86_encode(&x86);
+		if (output == OUTPUT_EXE)      elf_write_executable(&x86, output_path);
+		else if (output == OUTPUT_OBJ) elf_write_object(&x86, output_path);
+		else                           status = jit_run(&x86);
+	}
+	x86_clean_up(&x86);
+	return status;
+}
+
+/* generate an executable from doil code, or run it with --jit */
+int
+back_end(doil_t *doil) {
 #if defined(__linux__) && defined(__x86_64__)
-	linux_x86_64(doil);
+	return linux_x86_64(doil);
 #else
 	fprintf(stderr, "ERROR: dato only supports linux x86_64 operating systems\n");
 	exit(1);
 #endif
 }
 
+/* one json object, the phases in the order they run */
+void
+print_stats(doil_t *doil) {
+	FILE *f = stats_path ? fopen(stats_path, "w") : stderr;
+	if (!f) {
+		fprintf(stderr, "ERROR: could not open file %s: %s\n", stats_path, strerror(errno));
+		exit(1);
+	}
+	unsigned long long ns = 0, peak = 0;
+	unsigned int passes = doil->optimize_passes, iterations = doil->optimize_iterations;
+	for (unsigned int i = 0; i < systems_count; i++) {
+		passes += systems[i].doil.optimize_passes;
+		iterations += systems[i].doil.optimize_iterations;
+	}
+	fprintf(f, "{\"phases\": [");
+	for (unsigned int i = 0; i < PHASE_COUNT; i++) {
+		phase_t *phase = &stats.phases[i];
+		fprintf(f, "%s{\"name\": \"%s\", \"ns\": %llu, \"peak_bytes\": %llu, \"allocated_bytes\": %llu}",
+		        i ? ", " : "", phase_str[i], phase->ns, phase->peak, phase->allocated);
+		ns += phase->ns;
+		if (phase->peak > peak) peak = phase->peak;
+	}
+	fprintf(f, "], \"ns\": %llu, \"peak_bytes\": %llu, \"allocated_bytes\": %llu, \"allocations\": %llu, \"arena_blocks\": %u, ",
+	        ns, peak, stats.allocated, stats.allocations, stats.arena_blocks);
+	fprintf(f, "\"tokens\": %u, \"statements\": %u, \"ast_nodes\": %u, \"identifiers\": %u, ",
+	        stats.tokens, stats.statements, stats.ast_nodes, ids_count);
+	fprintf(f, "\"doil_instructions\": {\"before\": %u, \"after\": %u}, \"optimize_passes\": %u, \"optimize_iterations\": %u, ",
+	        stats.doil_before, stats.doil_after, passes, iterations);
+	print_ids_stats(f);
+	fprintf(f, "}\n");
+	if (stats_path) fclose(f);
+}
+
 int
 main(int argc, char **argv) {
-	get_source(argc, argv);
+	get_arguments(argc, argv);
+	stats_phase(PHASE_SOURCE);
+	get_source();
 	doil_t doil = front_end();
+	int status = 0;
+	stats_phase(PHASE_BACK_END);
+	if (output == OUTPUT_RUN) status = run_program(&doil);
+	else                      status = back_end(&doil);
+	stats_phase(PHASE_NONE);
+	if (stats_report) print_stats(&doil);
 	doil_clean_up(doil);
-	//back_end(doil);
-	return 0;
+	return status;
 }
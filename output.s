@@ -0,0 +1,10 @@
+	.text
+	.globl _start
+_start:
+	pushq %rbp
+	movq %rsp, %rbp
+.L0:
+	movq $12, %rdi
+	movl $60, %eax
+	syscall
+	.section .note.GNU-stack,"",@progbits